@@ -24,59 +24,279 @@
 //
 
 #include <Arduino.h>
-#include <limits.h>
 
 #include <SPI.h>
 
 #include "EPD.h"
 
 // delays - more consistent naming
-#define Delay_ms(ms) delay(ms)
-#define Delay_us(us) delayMicroseconds(us)
+#define Delay_ms(ms) this->bus->delay_ms(ms)
+#define Delay_us(us) this->bus->delay_us(us)
+
+// telemetry counters
+#if EPD_TELEMETRY
+#define Telemetry(statement) statement
+#else
+#define Telemetry(statement)
+#endif
 
 // inline arrays
 #define ARRAY(type, ...) ((type[]){__VA_ARGS__})
 #define CU8(...) (ARRAY(const uint8_t, __VA_ARGS__))
 
-static void SPI_put(uint8_t c);
-static void SPI_put_wait(uint8_t c, int busy_pin);
-static void SPI_send(uint8_t cs_pin, const uint8_t *buffer, uint16_t length);
+// COG settings of each panel size, as in the Pervasive Displays driver
+static const struct
+{
+	uint16_t stage_time; // milliseconds
+	bool filler;
+	uint8_t channel_select[9];
+	uint8_t gate_source[2];
+} panels[] = {
+	{480, false, {0x72, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0f, 0xff, 0x00}, {0x72, 0x03}}, // EPD_1_44
+	{480, true, {0x72, 0x00, 0x00, 0x00, 0x00, 0x01, 0xff, 0xe0, 0x00}, {0x72, 0x03}},	// EPD_2_0
+	{630, true, {0x72, 0x00, 0x00, 0x00, 0x7f, 0xff, 0xfe, 0x00, 0x00}, {0x72, 0x00}},	// EPD_2_7
+};
+
+// pixel encodings for each stage, indexed by [stage][image byte]
+// even pixels are sent in reverse order, so their bit pairs are already swapped
+static const uint8_t even_pixels[4][256] = {
+	{ // EPD_compensate
+		0xff, 0xbf, 0xff, 0xbf, 0xef, 0xaf, 0xef, 0xaf, 0xff, 0xbf, 0xff, 0xbf, 0xef, 0xaf, 0xef, 0xaf,
+		0xfb, 0xbb, 0xfb, 0xbb, 0xeb, 0xab, 0xeb, 0xab, 0xfb, 0xbb, 0xfb, 0xbb, 0xeb, 0xab, 0xeb, 0xab,
+		0xff, 0xbf, 0xff, 0xbf, 0xef, 0xaf, 0xef, 0xaf, 0xff, 0xbf, 0xff, 0xbf, 0xef, 0xaf, 0xef, 0xaf,
+		0xfb, 0xbb, 0xfb, 0xbb, 0xeb, 0xab, 0xeb, 0xab, 0xfb, 0xbb, 0xfb, 0xbb, 0xeb, 0xab, 0xeb, 0xab,
+		0xfe, 0xbe, 0xfe, 0xbe, 0xee, 0xae, 0xee, 0xae, 0xfe, 0xbe, 0xfe, 0xbe, 0xee, 0xae, 0xee, 0xae,
+		0xfa, 0xba, 0xfa, 0xba, 0xea, 0xaa, 0xea, 0xaa, 0xfa, 0xba, 0xfa, 0xba, 0xea, 0xaa, 0xea, 0xaa,
+		0xfe, 0xbe, 0xfe, 0xbe, 0xee, 0xae, 0xee, 0xae, 0xfe, 0xbe, 0xfe, 0xbe, 0xee, 0xae, 0xee, 0xae,
+		0xfa, 0xba, 0xfa, 0xba, 0xea, 0xaa, 0xea, 0xaa, 0xfa, 0xba, 0xfa, 0xba, 0xea, 0xaa, 0xea, 0xaa,
+		0xff, 0xbf, 0xff, 0xbf, 0xef, 0xaf, 0xef, 0xaf, 0xff, 0xbf, 0xff, 0xbf, 0xef, 0xaf, 0xef, 0xaf,
+		0xfb, 0xbb, 0xfb, 0xbb, 0xeb, 0xab, 0xeb, 0xab, 0xfb, 0xbb, 0xfb, 0xbb, 0xeb, 0xab, 0xeb, 0xab,
+		0xff, 0xbf, 0xff, 0xbf, 0xef, 0xaf, 0xef, 0xaf, 0xff, 0xbf, 0xff, 0xbf, 0xef, 0xaf, 0xef, 0xaf,
+		0xfb, 0xbb, 0xfb, 0xbb, 0xeb, 0xab, 0xeb, 0xab, 0xfb, 0xbb, 0xfb, 0xbb, 0xeb, 0xab, 0xeb, 0xab,
+		0xfe, 0xbe, 0xfe, 0xbe, 0xee, 0xae, 0xee, 0xae, 0xfe, 0xbe, 0xfe, 0xbe, 0xee, 0xae, 0xee, 0xae,
+		0xfa, 0xba, 0xfa, 0xba, 0xea, 0xaa, 0xea, 0xaa, 0xfa, 0xba, 0xfa, 0xba, 0xea, 0xaa, 0xea, 0xaa,
+		0xfe, 0xbe, 0xfe, 0xbe, 0xee, 0xae, 0xee, 0xae, 0xfe, 0xbe, 0xfe, 0xbe, 0xee, 0xae, 0xee, 0xae,
+		0xfa, 0xba, 0xfa, 0xba, 0xea, 0xaa, 0xea, 0xaa, 0xfa, 0xba, 0xfa, 0xba, 0xea, 0xaa, 0xea, 0xaa,
+	},
+	{ // EPD_white
+		0xaa, 0x6a, 0xaa, 0x6a, 0x9a, 0x5a, 0x9a, 0x5a, 0xaa, 0x6a, 0xaa, 0x6a, 0x9a, 0x5a, 0x9a, 0x5a,
+		0xa6, 0x66, 0xa6, 0x66, 0x96, 0x56, 0x96, 0x56, 0xa6, 0x66, 0xa6, 0x66, 0x96, 0x56, 0x96, 0x56,
+		0xaa, 0x6a, 0xaa, 0x6a, 0x9a, 0x5a, 0x9a, 0x5a, 0xaa, 0x6a, 0xaa, 0x6a, 0x9a, 0x5a, 0x9a, 0x5a,
+		0xa6, 0x66, 0xa6, 0x66, 0x96, 0x56, 0x96, 0x56, 0xa6, 0x66, 0xa6, 0x66, 0x96, 0x56, 0x96, 0x56,
+		0xa9, 0x69, 0xa9, 0x69, 0x99, 0x59, 0x99, 0x59, 0xa9, 0x69, 0xa9, 0x69, 0x99, 0x59, 0x99, 0x59,
+		0xa5, 0x65, 0xa5, 0x65, 0x95, 0x55, 0x95, 0x55, 0xa5, 0x65, 0xa5, 0x65, 0x95, 0x55, 0x95, 0x55,
+		0xa9, 0x69, 0xa9, 0x69, 0x99, 0x59, 0x99, 0x59, 0xa9, 0x69, 0xa9, 0x69, 0x99, 0x59, 0x99, 0x59,
+		0xa5, 0x65, 0xa5, 0x65, 0x95, 0x55, 0x95, 0x55, 0xa5, 0x65, 0xa5, 0x65, 0x95, 0x55, 0x95, 0x55,
+		0xaa, 0x6a, 0xaa, 0x6a, 0x9a, 0x5a, 0x9a, 0x5a, 0xaa, 0x6a, 0xaa, 0x6a, 0x9a, 0x5a, 0x9a, 0x5a,
+		0xa6, 0x66, 0xa6, 0x66, 0x96, 0x56, 0x96, 0x56, 0xa6, 0x66, 0xa6, 0x66, 0x96, 0x56, 0x96, 0x56,
+		0xaa, 0x6a, 0xaa, 0x6a, 0x9a, 0x5a, 0x9a, 0x5a, 0xaa, 0x6a, 0xaa, 0x6a, 0x9a, 0x5a, 0x9a, 0x5a,
+		0xa6, 0x66, 0xa6, 0x66, 0x96, 0x56, 0x96, 0x56, 0xa6, 0x66, 0xa6, 0x66, 0x96, 0x56, 0x96, 0x56,
+		0xa9, 0x69, 0xa9, 0x69, 0x99, 0x59, 0x99, 0x59, 0xa9, 0x69, 0xa9, 0x69, 0x99, 0x59, 0x99, 0x59,
+		0xa5, 0x65, 0xa5, 0x65, 0x95, 0x55, 0x95, 0x55, 0xa5, 0x65, 0xa5, 0x65, 0x95, 0x55, 0x95, 0x55,
+		0xa9, 0x69, 0xa9, 0x69, 0x99, 0x59, 0x99, 0x59, 0xa9, 0x69, 0xa9, 0x69, 0x99, 0x59, 0x99, 0x59,
+		0xa5, 0x65, 0xa5, 0x65, 0x95, 0x55, 0x95, 0x55, 0xa5, 0x65, 0xa5, 0x65, 0x95, 0x55, 0x95, 0x55,
+	},
+	{ // EPD_inverse
+		0xff, 0x7f, 0xff, 0x7f, 0xdf, 0x5f, 0xdf, 0x5f, 0xff, 0x7f, 0xff, 0x7f, 0xdf, 0x5f, 0xdf, 0x5f,
+		0xf7, 0x77, 0xf7, 0x77, 0xd7, 0x57, 0xd7, 0x57, 0xf7, 0x77, 0xf7, 0x77, 0xd7, 0x57, 0xd7, 0x57,
+		0xff, 0x7f, 0xff, 0x7f, 0xdf, 0x5f, 0xdf, 0x5f, 0xff, 0x7f, 0xff, 0x7f, 0xdf, 0x5f, 0xdf, 0x5f,
+		0xf7, 0x77, 0xf7, 0x77, 0xd7, 0x57, 0xd7, 0x57, 0xf7, 0x77, 0xf7, 0x77, 0xd7, 0x57, 0xd7, 0x57,
+		0xfd, 0x7d, 0xfd, 0x7d, 0xdd, 0x5d, 0xdd, 0x5d, 0xfd, 0x7d, 0xfd, 0x7d, 0xdd, 0x5d, 0xdd, 0x5d,
+		0xf5, 0x75, 0xf5, 0x75, 0xd5, 0x55, 0xd5, 0x55, 0xf5, 0x75, 0xf5, 0x75, 0xd5, 0x55, 0xd5, 0x55,
+		0xfd, 0x7d, 0xfd, 0x7d, 0xdd, 0x5d, 0xdd, 0x5d, 0xfd, 0x7d, 0xfd, 0x7d, 0xdd, 0x5d, 0xdd, 0x5d,
+		0xf5, 0x75, 0xf5, 0x75, 0xd5, 0x55, 0xd5, 0x55, 0xf5, 0x75, 0xf5, 0x75, 0xd5, 0x55, 0xd5, 0x55,
+		0xff, 0x7f, 0xff, 0x7f, 0xdf, 0x5f, 0xdf, 0x5f, 0xff, 0x7f, 0xff, 0x7f, 0xdf, 0x5f, 0xdf, 0x5f,
+		0xf7, 0x77, 0xf7, 0x77, 0xd7, 0x57, 0xd7, 0x57, 0xf7, 0x77, 0xf7, 0x77, 0xd7, 0x57, 0xd7, 0x57,
+		0xff, 0x7f, 0xff, 0x7f, 0xdf, 0x5f, 0xdf, 0x5f, 0xff, 0x7f, 0xff, 0x7f, 0xdf, 0x5f, 0xdf, 0x5f,
+		0xf7, 0x77, 0xf7, 0x77, 0xd7, 0x57, 0xd7, 0x57, 0xf7, 0x77, 0xf7, 0x77, 0xd7, 0x57, 0xd7, 0x57,
+		0xfd, 0x7d, 0xfd, 0x7d, 0xdd, 0x5d, 0xdd, 0x5d, 0xfd, 0x7d, 0xfd, 0x7d, 0xdd, 0x5d, 0xdd, 0x5d,
+		0xf5, 0x75, 0xf5, 0x75, 0xd5, 0x55, 0xd5, 0x55, 0xf5, 0x75, 0xf5, 0x75, 0xd5, 0x55, 0xd5, 0x55,
+		0xfd, 0x7d, 0xfd, 0x7d, 0xdd, 0x5d, 0xdd, 0x5d, 0xfd, 0x7d, 0xfd, 0x7d, 0xdd, 0x5d, 0xdd, 0x5d,
+		0xf5, 0x75, 0xf5, 0x75, 0xd5, 0x55, 0xd5, 0x55, 0xf5, 0x75, 0xf5, 0x75, 0xd5, 0x55, 0xd5, 0x55,
+	},
+	{ // EPD_normal
+		0xaa, 0xea, 0xaa, 0xea, 0xba, 0xfa, 0xba, 0xfa, 0xaa, 0xea, 0xaa, 0xea, 0xba, 0xfa, 0xba, 0xfa,
+		0xae, 0xee, 0xae, 0xee, 0xbe, 0xfe, 0xbe, 0xfe, 0xae, 0xee, 0xae, 0xee, 0xbe, 0xfe, 0xbe, 0xfe,
+		0xaa, 0xea, 0xaa, 0xea, 0xba, 0xfa, 0xba, 0xfa, 0xaa, 0xea, 0xaa, 0xea, 0xba, 0xfa, 0xba, 0xfa,
+		0xae, 0xee, 0xae, 0xee, 0xbe, 0xfe, 0xbe, 0xfe, 0xae, 0xee, 0xae, 0xee, 0xbe, 0xfe, 0xbe, 0xfe,
+		0xab, 0xeb, 0xab, 0xeb, 0xbb, 0xfb, 0xbb, 0xfb, 0xab, 0xeb, 0xab, 0xeb, 0xbb, 0xfb, 0xbb, 0xfb,
+		0xaf, 0xef, 0xaf, 0xef, 0xbf, 0xff, 0xbf, 0xff, 0xaf, 0xef, 0xaf, 0xef, 0xbf, 0xff, 0xbf, 0xff,
+		0xab, 0xeb, 0xab, 0xeb, 0xbb, 0xfb, 0xbb, 0xfb, 0xab, 0xeb, 0xab, 0xeb, 0xbb, 0xfb, 0xbb, 0xfb,
+		0xaf, 0xef, 0xaf, 0xef, 0xbf, 0xff, 0xbf, 0xff, 0xaf, 0xef, 0xaf, 0xef, 0xbf, 0xff, 0xbf, 0xff,
+		0xaa, 0xea, 0xaa, 0xea, 0xba, 0xfa, 0xba, 0xfa, 0xaa, 0xea, 0xaa, 0xea, 0xba, 0xfa, 0xba, 0xfa,
+		0xae, 0xee, 0xae, 0xee, 0xbe, 0xfe, 0xbe, 0xfe, 0xae, 0xee, 0xae, 0xee, 0xbe, 0xfe, 0xbe, 0xfe,
+		0xaa, 0xea, 0xaa, 0xea, 0xba, 0xfa, 0xba, 0xfa, 0xaa, 0xea, 0xaa, 0xea, 0xba, 0xfa, 0xba, 0xfa,
+		0xae, 0xee, 0xae, 0xee, 0xbe, 0xfe, 0xbe, 0xfe, 0xae, 0xee, 0xae, 0xee, 0xbe, 0xfe, 0xbe, 0xfe,
+		0xab, 0xeb, 0xab, 0xeb, 0xbb, 0xfb, 0xbb, 0xfb, 0xab, 0xeb, 0xab, 0xeb, 0xbb, 0xfb, 0xbb, 0xfb,
+		0xaf, 0xef, 0xaf, 0xef, 0xbf, 0xff, 0xbf, 0xff, 0xaf, 0xef, 0xaf, 0xef, 0xbf, 0xff, 0xbf, 0xff,
+		0xab, 0xeb, 0xab, 0xeb, 0xbb, 0xfb, 0xbb, 0xfb, 0xab, 0xeb, 0xab, 0xeb, 0xbb, 0xfb, 0xbb, 0xfb,
+		0xaf, 0xef, 0xaf, 0xef, 0xbf, 0xff, 0xbf, 0xff, 0xaf, 0xef, 0xaf, 0xef, 0xbf, 0xff, 0xbf, 0xff,
+	},
+};
+
+// odd pixels
+static const uint8_t odd_pixels[4][256] = {
+	{ // EPD_compensate
+		0xff, 0xff, 0xfe, 0xfe, 0xff, 0xff, 0xfe, 0xfe, 0xfb, 0xfb, 0xfa, 0xfa, 0xfb, 0xfb, 0xfa, 0xfa,
+		0xff, 0xff, 0xfe, 0xfe, 0xff, 0xff, 0xfe, 0xfe, 0xfb, 0xfb, 0xfa, 0xfa, 0xfb, 0xfb, 0xfa, 0xfa,
+		0xef, 0xef, 0xee, 0xee, 0xef, 0xef, 0xee, 0xee, 0xeb, 0xeb, 0xea, 0xea, 0xeb, 0xeb, 0xea, 0xea,
+		0xef, 0xef, 0xee, 0xee, 0xef, 0xef, 0xee, 0xee, 0xeb, 0xeb, 0xea, 0xea, 0xeb, 0xeb, 0xea, 0xea,
+		0xff, 0xff, 0xfe, 0xfe, 0xff, 0xff, 0xfe, 0xfe, 0xfb, 0xfb, 0xfa, 0xfa, 0xfb, 0xfb, 0xfa, 0xfa,
+		0xff, 0xff, 0xfe, 0xfe, 0xff, 0xff, 0xfe, 0xfe, 0xfb, 0xfb, 0xfa, 0xfa, 0xfb, 0xfb, 0xfa, 0xfa,
+		0xef, 0xef, 0xee, 0xee, 0xef, 0xef, 0xee, 0xee, 0xeb, 0xeb, 0xea, 0xea, 0xeb, 0xeb, 0xea, 0xea,
+		0xef, 0xef, 0xee, 0xee, 0xef, 0xef, 0xee, 0xee, 0xeb, 0xeb, 0xea, 0xea, 0xeb, 0xeb, 0xea, 0xea,
+		0xbf, 0xbf, 0xbe, 0xbe, 0xbf, 0xbf, 0xbe, 0xbe, 0xbb, 0xbb, 0xba, 0xba, 0xbb, 0xbb, 0xba, 0xba,
+		0xbf, 0xbf, 0xbe, 0xbe, 0xbf, 0xbf, 0xbe, 0xbe, 0xbb, 0xbb, 0xba, 0xba, 0xbb, 0xbb, 0xba, 0xba,
+		0xaf, 0xaf, 0xae, 0xae, 0xaf, 0xaf, 0xae, 0xae, 0xab, 0xab, 0xaa, 0xaa, 0xab, 0xab, 0xaa, 0xaa,
+		0xaf, 0xaf, 0xae, 0xae, 0xaf, 0xaf, 0xae, 0xae, 0xab, 0xab, 0xaa, 0xaa, 0xab, 0xab, 0xaa, 0xaa,
+		0xbf, 0xbf, 0xbe, 0xbe, 0xbf, 0xbf, 0xbe, 0xbe, 0xbb, 0xbb, 0xba, 0xba, 0xbb, 0xbb, 0xba, 0xba,
+		0xbf, 0xbf, 0xbe, 0xbe, 0xbf, 0xbf, 0xbe, 0xbe, 0xbb, 0xbb, 0xba, 0xba, 0xbb, 0xbb, 0xba, 0xba,
+		0xaf, 0xaf, 0xae, 0xae, 0xaf, 0xaf, 0xae, 0xae, 0xab, 0xab, 0xaa, 0xaa, 0xab, 0xab, 0xaa, 0xaa,
+		0xaf, 0xaf, 0xae, 0xae, 0xaf, 0xaf, 0xae, 0xae, 0xab, 0xab, 0xaa, 0xaa, 0xab, 0xab, 0xaa, 0xaa,
+	},
+	{ // EPD_white
+		0xaa, 0xaa, 0xa9, 0xa9, 0xaa, 0xaa, 0xa9, 0xa9, 0xa6, 0xa6, 0xa5, 0xa5, 0xa6, 0xa6, 0xa5, 0xa5,
+		0xaa, 0xaa, 0xa9, 0xa9, 0xaa, 0xaa, 0xa9, 0xa9, 0xa6, 0xa6, 0xa5, 0xa5, 0xa6, 0xa6, 0xa5, 0xa5,
+		0x9a, 0x9a, 0x99, 0x99, 0x9a, 0x9a, 0x99, 0x99, 0x96, 0x96, 0x95, 0x95, 0x96, 0x96, 0x95, 0x95,
+		0x9a, 0x9a, 0x99, 0x99, 0x9a, 0x9a, 0x99, 0x99, 0x96, 0x96, 0x95, 0x95, 0x96, 0x96, 0x95, 0x95,
+		0xaa, 0xaa, 0xa9, 0xa9, 0xaa, 0xaa, 0xa9, 0xa9, 0xa6, 0xa6, 0xa5, 0xa5, 0xa6, 0xa6, 0xa5, 0xa5,
+		0xaa, 0xaa, 0xa9, 0xa9, 0xaa, 0xaa, 0xa9, 0xa9, 0xa6, 0xa6, 0xa5, 0xa5, 0xa6, 0xa6, 0xa5, 0xa5,
+		0x9a, 0x9a, 0x99, 0x99, 0x9a, 0x9a, 0x99, 0x99, 0x96, 0x96, 0x95, 0x95, 0x96, 0x96, 0x95, 0x95,
+		0x9a, 0x9a, 0x99, 0x99, 0x9a, 0x9a, 0x99, 0x99, 0x96, 0x96, 0x95, 0x95, 0x96, 0x96, 0x95, 0x95,
+		0x6a, 0x6a, 0x69, 0x69, 0x6a, 0x6a, 0x69, 0x69, 0x66, 0x66, 0x65, 0x65, 0x66, 0x66, 0x65, 0x65,
+		0x6a, 0x6a, 0x69, 0x69, 0x6a, 0x6a, 0x69, 0x69, 0x66, 0x66, 0x65, 0x65, 0x66, 0x66, 0x65, 0x65,
+		0x5a, 0x5a, 0x59, 0x59, 0x5a, 0x5a, 0x59, 0x59, 0x56, 0x56, 0x55, 0x55, 0x56, 0x56, 0x55, 0x55,
+		0x5a, 0x5a, 0x59, 0x59, 0x5a, 0x5a, 0x59, 0x59, 0x56, 0x56, 0x55, 0x55, 0x56, 0x56, 0x55, 0x55,
+		0x6a, 0x6a, 0x69, 0x69, 0x6a, 0x6a, 0x69, 0x69, 0x66, 0x66, 0x65, 0x65, 0x66, 0x66, 0x65, 0x65,
+		0x6a, 0x6a, 0x69, 0x69, 0x6a, 0x6a, 0x69, 0x69, 0x66, 0x66, 0x65, 0x65, 0x66, 0x66, 0x65, 0x65,
+		0x5a, 0x5a, 0x59, 0x59, 0x5a, 0x5a, 0x59, 0x59, 0x56, 0x56, 0x55, 0x55, 0x56, 0x56, 0x55, 0x55,
+		0x5a, 0x5a, 0x59, 0x59, 0x5a, 0x5a, 0x59, 0x59, 0x56, 0x56, 0x55, 0x55, 0x56, 0x56, 0x55, 0x55,
+	},
+	{ // EPD_inverse
+		0xff, 0xff, 0xfd, 0xfd, 0xff, 0xff, 0xfd, 0xfd, 0xf7, 0xf7, 0xf5, 0xf5, 0xf7, 0xf7, 0xf5, 0xf5,
+		0xff, 0xff, 0xfd, 0xfd, 0xff, 0xff, 0xfd, 0xfd, 0xf7, 0xf7, 0xf5, 0xf5, 0xf7, 0xf7, 0xf5, 0xf5,
+		0xdf, 0xdf, 0xdd, 0xdd, 0xdf, 0xdf, 0xdd, 0xdd, 0xd7, 0xd7, 0xd5, 0xd5, 0xd7, 0xd7, 0xd5, 0xd5,
+		0xdf, 0xdf, 0xdd, 0xdd, 0xdf, 0xdf, 0xdd, 0xdd, 0xd7, 0xd7, 0xd5, 0xd5, 0xd7, 0xd7, 0xd5, 0xd5,
+		0xff, 0xff, 0xfd, 0xfd, 0xff, 0xff, 0xfd, 0xfd, 0xf7, 0xf7, 0xf5, 0xf5, 0xf7, 0xf7, 0xf5, 0xf5,
+		0xff, 0xff, 0xfd, 0xfd, 0xff, 0xff, 0xfd, 0xfd, 0xf7, 0xf7, 0xf5, 0xf5, 0xf7, 0xf7, 0xf5, 0xf5,
+		0xdf, 0xdf, 0xdd, 0xdd, 0xdf, 0xdf, 0xdd, 0xdd, 0xd7, 0xd7, 0xd5, 0xd5, 0xd7, 0xd7, 0xd5, 0xd5,
+		0xdf, 0xdf, 0xdd, 0xdd, 0xdf, 0xdf, 0xdd, 0xdd, 0xd7, 0xd7, 0xd5, 0xd5, 0xd7, 0xd7, 0xd5, 0xd5,
+		0x7f, 0x7f, 0x7d, 0x7d, 0x7f, 0x7f, 0x7d, 0x7d, 0x77, 0x77, 0x75, 0x75, 0x77, 0x77, 0x75, 0x75,
+		0x7f, 0x7f, 0x7d, 0x7d, 0x7f, 0x7f, 0x7d, 0x7d, 0x77, 0x77, 0x75, 0x75, 0x77, 0x77, 0x75, 0x75,
+		0x5f, 0x5f, 0x5d, 0x5d, 0x5f, 0x5f, 0x5d, 0x5d, 0x57, 0x57, 0x55, 0x55, 0x57, 0x57, 0x55, 0x55,
+		0x5f, 0x5f, 0x5d, 0x5d, 0x5f, 0x5f, 0x5d, 0x5d, 0x57, 0x57, 0x55, 0x55, 0x57, 0x57, 0x55, 0x55,
+		0x7f, 0x7f, 0x7d, 0x7d, 0x7f, 0x7f, 0x7d, 0x7d, 0x77, 0x77, 0x75, 0x75, 0x77, 0x77, 0x75, 0x75,
+		0x7f, 0x7f, 0x7d, 0x7d, 0x7f, 0x7f, 0x7d, 0x7d, 0x77, 0x77, 0x75, 0x75, 0x77, 0x77, 0x75, 0x75,
+		0x5f, 0x5f, 0x5d, 0x5d, 0x5f, 0x5f, 0x5d, 0x5d, 0x57, 0x57, 0x55, 0x55, 0x57, 0x57, 0x55, 0x55,
+		0x5f, 0x5f, 0x5d, 0x5d, 0x5f, 0x5f, 0x5d, 0x5d, 0x57, 0x57, 0x55, 0x55, 0x57, 0x57, 0x55, 0x55,
+	},
+	{ // EPD_normal
+		0xaa, 0xaa, 0xab, 0xab, 0xaa, 0xaa, 0xab, 0xab, 0xae, 0xae, 0xaf, 0xaf, 0xae, 0xae, 0xaf, 0xaf,
+		0xaa, 0xaa, 0xab, 0xab, 0xaa, 0xaa, 0xab, 0xab, 0xae, 0xae, 0xaf, 0xaf, 0xae, 0xae, 0xaf, 0xaf,
+		0xba, 0xba, 0xbb, 0xbb, 0xba, 0xba, 0xbb, 0xbb, 0xbe, 0xbe, 0xbf, 0xbf, 0xbe, 0xbe, 0xbf, 0xbf,
+		0xba, 0xba, 0xbb, 0xbb, 0xba, 0xba, 0xbb, 0xbb, 0xbe, 0xbe, 0xbf, 0xbf, 0xbe, 0xbe, 0xbf, 0xbf,
+		0xaa, 0xaa, 0xab, 0xab, 0xaa, 0xaa, 0xab, 0xab, 0xae, 0xae, 0xaf, 0xaf, 0xae, 0xae, 0xaf, 0xaf,
+		0xaa, 0xaa, 0xab, 0xab, 0xaa, 0xaa, 0xab, 0xab, 0xae, 0xae, 0xaf, 0xaf, 0xae, 0xae, 0xaf, 0xaf,
+		0xba, 0xba, 0xbb, 0xbb, 0xba, 0xba, 0xbb, 0xbb, 0xbe, 0xbe, 0xbf, 0xbf, 0xbe, 0xbe, 0xbf, 0xbf,
+		0xba, 0xba, 0xbb, 0xbb, 0xba, 0xba, 0xbb, 0xbb, 0xbe, 0xbe, 0xbf, 0xbf, 0xbe, 0xbe, 0xbf, 0xbf,
+		0xea, 0xea, 0xeb, 0xeb, 0xea, 0xea, 0xeb, 0xeb, 0xee, 0xee, 0xef, 0xef, 0xee, 0xee, 0xef, 0xef,
+		0xea, 0xea, 0xeb, 0xeb, 0xea, 0xea, 0xeb, 0xeb, 0xee, 0xee, 0xef, 0xef, 0xee, 0xee, 0xef, 0xef,
+		0xfa, 0xfa, 0xfb, 0xfb, 0xfa, 0xfa, 0xfb, 0xfb, 0xfe, 0xfe, 0xff, 0xff, 0xfe, 0xfe, 0xff, 0xff,
+		0xfa, 0xfa, 0xfb, 0xfb, 0xfa, 0xfa, 0xfb, 0xfb, 0xfe, 0xfe, 0xff, 0xff, 0xfe, 0xfe, 0xff, 0xff,
+		0xea, 0xea, 0xeb, 0xeb, 0xea, 0xea, 0xeb, 0xeb, 0xee, 0xee, 0xef, 0xef, 0xee, 0xee, 0xef, 0xef,
+		0xea, 0xea, 0xeb, 0xeb, 0xea, 0xea, 0xeb, 0xeb, 0xee, 0xee, 0xef, 0xef, 0xee, 0xee, 0xef, 0xef,
+		0xfa, 0xfa, 0xfb, 0xfb, 0xfa, 0xfa, 0xfb, 0xfb, 0xfe, 0xfe, 0xff, 0xff, 0xfe, 0xfe, 0xff, 0xff,
+		0xfa, 0xfa, 0xfb, 0xfb, 0xfa, 0xfa, 0xfb, 0xfb, 0xfe, 0xfe, 0xff, 0xff, 0xfe, 0xfe, 0xff, 0xff,
+	},
+};
+
+EPD::EPD(EPD_size size,
+		 uint8_t panel_on_pin,
+		 uint8_t border_pin,
+		 uint8_t discharge_pin,
+		 uint8_t reset_pin,
+		 uint8_t busy_pin,
+		 uint8_t chip_select_pin,
+		 SPIClass &SPI_driver) : EPD(size,
+									 panel_on_pin,
+									 border_pin,
+									 discharge_pin,
+									 reset_pin,
+									 busy_pin,
+									 chip_select_pin,
+									 *new EPD_ArduinoBus(SPI_driver))
+{
+	this->own_bus = true;
+}
 
-EPD::EPD(uint16_t width,
-		 uint16_t height,
+EPD::EPD(EPD_size size,
 		 uint8_t panel_on_pin,
 		 uint8_t border_pin,
 		 uint8_t discharge_pin,
 		 uint8_t reset_pin,
 		 uint8_t busy_pin,
 		 uint8_t chip_select_pin,
-		 SPIClass &SPI_driver) : panel_on_pin(panel_on_pin),
-								 border_pin(border_pin),
-								 discharge_pin(discharge_pin),
-								 reset_pin(reset_pin),
-								 busy_pin(busy_pin),
-								 cs_pin(chip_select_pin),
-								 SPI(SPI_driver)
-{
-	this->stage_time = 630; // milliseconds
-	this->lines_per_display = height;
-	this->dots_per_line = width;
-	this->bytes_per_line = width / 8;
-	this->bytes_per_scan = height / 4;
-	this->filler = true;
-	static uint8_t cs[] = {0x72, 0x00, 0x00, 0x00, 0x7f, 0xff, 0xfe, 0x00, 0x00};
-	static uint8_t gs[] = {0x72, 0x00};
-	this->channel_select = cs;
-	this->channel_select_length = sizeof(cs);
-	this->gate_source = gs;
-	this->gate_source_length = sizeof(gs);
+		 EPD_Bus &bus) : panel_on_pin(panel_on_pin),
+						 border_pin(border_pin),
+						 discharge_pin(discharge_pin),
+						 reset_pin(reset_pin),
+						 busy_pin(busy_pin),
+						 cs_pin(chip_select_pin),
+						 bus(&bus),
+						 own_bus(false)
+{
+	this->stage_time = panels[size].stage_time;
+	this->lines_per_display = EPD_HEIGHT(size);
+	this->dots_per_line = EPD_WIDTH(size);
+	this->bytes_per_line = this->dots_per_line / 8;
+	this->bytes_per_scan = this->lines_per_display / 4;
+	this->bytes_per_image = EPD_IMAGE_BYTES(size);
+	this->filler = panels[size].filler;
+	this->channel_select = panels[size].channel_select;
+	this->channel_select_length = sizeof(panels[size].channel_select);
+	this->gate_source = panels[size].gate_source;
+	this->gate_source_length = sizeof(panels[size].gate_source);
 	this->factored_stage_time = this->stage_time;
-
-	uint16_t bytes = ((width + 7) / 8) * height;
-	if ((buffer = (uint8_t *)malloc(bytes)))
+	this->line_time = 0;
+	this->full_refresh_interval = 0;
+	this->partial_count = 0;
+	this->policy = 0;
+
+	this->panel_thermometer = 0;
+
+	memset(&this->telemetry, 0, sizeof(this->telemetry));
+	this->refresh_start = 0;
+
+	this->task = 0;
+	this->lock = 0;
+	this->powered = false;
+	this->driving = false;
+	this->session = false;
+	this->session_start = 0;
+	this->session_timeout = EPD_SESSION_TIMEOUT;
+	this->pending = 0;
+	this->snapshot = 0;
+	this->pending_valid = false;
+	this->pending_first = 0;
+	this->pending_last = 0;
+	this->busy = false;
+	this->last_refresh = EPD_skip;
+	this->done_callback = 0;
+	this->done_context = 0;
+
+	if ((buffer = (uint8_t *)malloc(this->bytes_per_image)))
 	{
-		memset(buffer, 0, bytes);
+		memset(buffer, 0, this->bytes_per_image);
 	}
+
+	// header + even pixels + scan + odd pixels + filler
+	this->line_length = 1 + 2 * this->bytes_per_line + this->bytes_per_scan + (this->filler ? 1 : 0);
+	this->line_buffer = (uint8_t *)malloc(this->line_length);
+	this->line_data = (uint8_t *)malloc(this->bytes_per_line);
+
+	memset(this->line_cache, 0, sizeof(this->line_cache));
+	this->line_valid = 0;
+	this->use_cache = false;
 }
 
 EPD::~EPD(void)
@@ -85,27 +305,53 @@ EPD::~EPD(void)
 	{
 		free(buffer);
 	}
+
+	if (line_buffer)
+	{
+		free(line_buffer);
+	}
+	free(line_data);
+
+	this->setLineCache(false);
+
+	if (task)
+	{
+		vTaskDelete(task);
+		vSemaphoreDelete(lock);
+		free(pending);
+		free(snapshot);
+		task = 0;
+		lock = 0;
+	}
+
+	// a session may still hold the panel on
+	if (powered)
+	{
+		this->power_off_cog();
+	}
+
+	if (own_bus)
+	{
+		delete bus;
+	}
 }
 
 void EPD::begin()
 {
-	pinMode(this->busy_pin, INPUT);
-	pinMode(this->reset_pin, OUTPUT);
-	pinMode(this->panel_on_pin, OUTPUT);
-	pinMode(this->discharge_pin, OUTPUT);
-	pinMode(this->border_pin, OUTPUT);
-	pinMode(this->cs_pin, OUTPUT);
-
-	digitalWrite(this->reset_pin, LOW);
-	digitalWrite(this->panel_on_pin, LOW);
-	digitalWrite(this->discharge_pin, LOW);
-	digitalWrite(this->border_pin, LOW);
-	digitalWrite(this->cs_pin, LOW);
-
-	SPI.begin();
-	SPI.setBitOrder(MSBFIRST);
-	SPI.setDataMode(SPI_MODE0);
-	SPI.setClockDivider(SPI_CLOCK_DIV4);
+	this->bus->pin_mode(this->busy_pin, INPUT);
+	this->bus->pin_mode(this->reset_pin, OUTPUT);
+	this->bus->pin_mode(this->panel_on_pin, OUTPUT);
+	this->bus->pin_mode(this->discharge_pin, OUTPUT);
+	this->bus->pin_mode(this->border_pin, OUTPUT);
+	this->bus->pin_mode(this->cs_pin, OUTPUT);
+
+	this->bus->pin_write(this->reset_pin, LOW);
+	this->bus->pin_write(this->panel_on_pin, LOW);
+	this->bus->pin_write(this->discharge_pin, LOW);
+	this->bus->pin_write(this->border_pin, LOW);
+	this->bus->pin_write(this->cs_pin, LOW);
+
+	this->bus->begin();
 }
 
 void EPD::setFactor(int16_t temperature)
@@ -113,450 +359,1086 @@ void EPD::setFactor(int16_t temperature)
 	this->factored_stage_time = this->stage_time * this->temperature_to_factor_10x(temperature) / 10;
 }
 
+void EPD::setThermometer(thermometer *thermometer)
+{
+	this->panel_thermometer = thermometer;
+}
+
+void EPD::beginRefresh(uint32_t timeout_ms)
+{
+	this->lock_state();
+	this->session = true;
+	this->session_start = this->bus->time_us();
+	this->session_timeout = timeout_ms;
+	this->unlock_state();
+}
+
+void EPD::endRefresh()
+{
+	this->close_session(true);
+}
+
 void EPD::clear()
+{
+	this->last_refresh = EPD_clear;
+	this->cog_on();
+	this->clear_stages();
+	this->cog_off();
+
+	if (this->policy)
+	{
+		this->policy->done(EPD_clear, 0, this->lines_per_display - 1, this->factored_stage_time * 10 / this->stage_time, time(0));
+	}
+}
+
+void EPD::update(const uint8_t *image)
+{
+	this->refresh(image, EPD_full, 0, this->lines_per_display - 1);
+	memcpy(buffer, image, this->bytes_per_image);
+}
+
+void EPD::updateRegion(const uint8_t *image, uint16_t first_line, uint16_t last_line)
+{
+	uint16_t first;
+	uint16_t last;
+
+	// nothing visible changed
+	if (!this->changed_lines(image, first_line, last_line, first, last))
+	{
+		this->last_refresh = EPD_skip;
+		return;
+	}
+
+	refresh_action action = this->choose_refresh(first, last);
+	this->refresh(image, action, first, last);
+
+	// a full refresh or clear cycle takes the whole image
+	if (EPD_partial != action)
+	{
+		memcpy(buffer, image, this->bytes_per_image);
+		return;
+	}
+
+	uint32_t offset = (uint32_t)first * this->bytes_per_line;
+	memcpy(&buffer[offset], &image[offset], (uint32_t)(last - first + 1) * this->bytes_per_line);
+}
+
+void EPD::updateStream(const line_source &previous, const line_source &next, uint16_t first_line, uint16_t last_line)
+{
+	if (last_line >= this->lines_per_display)
+	{
+		last_line = this->lines_per_display - 1;
+	}
+	if (first_line > last_line || 0 == this->line_data)
+	{
+		this->last_refresh = EPD_skip;
+		return;
+	}
+
+	this->last_refresh = EPD_partial;
+	this->cog_on();
+	this->frame_repeat(previous, EPD_compensate, first_line, last_line);
+	this->frame_repeat(previous, EPD_white, first_line, last_line);
+	this->frame_repeat(next, EPD_inverse, first_line, last_line);
+	this->frame_repeat(next, EPD_normal, first_line, last_line);
+	this->cog_off();
+
+	// keep the retained image in step, the sources are read once more
+	if (this->buffer)
+	{
+		for (uint16_t line = first_line; line <= last_line; ++line)
+		{
+			uint8_t *data = &this->buffer[(uint32_t)line * this->bytes_per_line];
+			const uint8_t *source = this->source_line(next, line);
+			if (0 == source)
+			{
+				memset(data, next.fixed_value, this->bytes_per_line);
+			}
+			else if (source != data)
+			{
+				memcpy(data, source, this->bytes_per_line);
+			}
+		}
+	}
+	this->invalidate_cache();
+}
+
+void EPD::updateStream(const line_source &next, uint16_t first_line, uint16_t last_line)
+{
+	if (this->buffer)
+	{
+		this->updateStream(epd_image_source(this->buffer), next, first_line, last_line);
+		return;
+	}
+
+	// what the panel shows is not known: drive it black first as clear()
+	this->updateStream(epd_fixed_source(0xff), next, first_line, last_line);
+}
+
+uint8_t *EPD::updateSwap(uint8_t *image, uint16_t first_line, uint16_t last_line)
+{
+	uint16_t first;
+	uint16_t last;
+
+	// image replaces the whole displayed one, the caller vouches for the
+	// lines outside the range
+	this->changed_lines(image, first_line, last_line, first, last);
+	this->refresh(image, this->choose_refresh(first, last), first, last);
+
+	uint8_t *previous = this->buffer;
+	this->buffer = image;
+	return previous;
+}
+
+void EPD::setFullRefreshInterval(uint8_t count)
+{
+	this->full_refresh_interval = count;
+	this->partial_count = 0;
+}
+
+void EPD::setPolicy(EPD_Policy *policy)
+{
+	this->policy = policy;
+}
+
+void EPD::restore(const uint8_t *image, uint8_t partial_count)
+{
+	if (buffer)
+	{
+		memcpy(buffer, image, this->bytes_per_image);
+	}
+	this->invalidate_cache();
+	this->partial_count = partial_count;
+}
+
+bool EPD::setLineCache(bool enable)
+{
+	if (!enable)
+	{
+		for (uint8_t stage = 0; stage < 4; ++stage)
+		{
+			free(this->line_cache[stage]);
+			this->line_cache[stage] = 0;
+		}
+		free(this->line_valid);
+		this->line_valid = 0;
+		return true;
+	}
+
+	if (this->line_valid)
+	{
+		return true;
+	}
+
+	// one block per stage, smaller blocks are easier to find in the heap
+	bool ok = true;
+	for (uint8_t stage = 0; stage < 4; ++stage)
+	{
+		this->line_cache[stage] = (uint8_t *)malloc((uint32_t)this->lines_per_display * this->line_length);
+		ok = ok && this->line_cache[stage];
+	}
+	this->line_valid = (uint8_t *)malloc(this->lines_per_display);
+	if (!ok || 0 == this->line_valid || 0 == this->buffer)
+	{
+		this->setLineCache(false);
+		return false;
+	}
+
+	this->invalidate_cache();
+	return true;
+}
+
+const uint8_t *EPD::getImage()
+{
+	return buffer;
+}
+
+uint8_t EPD::getPartialCount()
+{
+	return this->partial_count;
+}
+
+bool EPD::beginAsync(uint8_t core, refresh_done *callback, void *context)
+{
+	if (0 != this->task)
+	{
+		return true;
+	}
+
+	this->pending = (uint8_t *)malloc(this->bytes_per_image);
+	this->snapshot = (uint8_t *)malloc(this->bytes_per_image);
+	this->lock = xSemaphoreCreateMutex();
+	this->done_callback = callback;
+	this->done_context = context;
+
+	// one above idle like loop(), so any busy task cannot starve it; the
+	// stage loops never block, so it belongs on core 1 where the watchdog
+	// does not check the idle task and WiFi does not run
+	if (0 == this->pending || 0 == this->snapshot || 0 == this->lock ||
+		pdPASS != xTaskCreatePinnedToCore(refresh_task, "epd", 4096, this, tskIDLE_PRIORITY + 1, &this->task, core))
+	{
+		if (this->lock)
+		{
+			vSemaphoreDelete(this->lock);
+		}
+		free(this->pending);
+		free(this->snapshot);
+		this->lock = 0;
+		this->pending = 0;
+		this->snapshot = 0;
+		this->task = 0;
+		return false;
+	}
+
+	return true;
+}
+
+bool EPD::updateAsync(const uint8_t *image)
+{
+	if (0 == this->task)
+	{
+		return false;
+	}
+
+
+	// a frame still waiting is simply overwritten
+	xSemaphoreTake(this->lock, portMAX_DELAY);
+	memcpy(this->pending, image, this->bytes_per_image);
+	this->pending_valid = true;
+	this->pending_first = 0;
+	this->pending_last = this->lines_per_display - 1;
+	this->busy = true;
+	xSemaphoreGive(this->lock);
+
+	xTaskNotifyGive(this->task);
+	return true;
+}
+
+uint8_t *EPD::swapAsync(uint8_t *image, uint16_t first_line, uint16_t last_line)
+{
+	if (0 == this->task)
+	{
+		return 0;
+	}
+
+	// a frame still waiting was never displayed, its lines are compared too
+	xSemaphoreTake(this->lock, portMAX_DELAY);
+	if (!this->pending_valid)
+	{
+		this->pending_first = first_line;
+		this->pending_last = last_line;
+	}
+	else
+	{
+		this->pending_first = first_line < this->pending_first ? first_line : this->pending_first;
+		this->pending_last = last_line > this->pending_last ? last_line : this->pending_last;
+	}
+	uint8_t *back = this->pending;
+	this->pending = image;
+	this->pending_valid = true;
+	this->busy = true;
+	xSemaphoreGive(this->lock);
+
+	xTaskNotifyGive(this->task);
+	return back;
+}
+
+bool EPD::isBusy()
+{
+	return this->busy;
+}
+
+refresh_action EPD::getLastRefresh()
+{
+	return this->last_refresh;
+}
+
+const epd_telemetry &EPD::getTelemetry()
+{
+	return this->telemetry;
+}
+
+void EPD::printTelemetry(Print &out)
+{
+	const epd_telemetry &t = this->telemetry;
+	out.printf("epd %lu ms (on %lu, off %lu, ready %lu, busy %lu) x%u.%u passes %u/%u/%u/%u lines %lu spi %lu B %lu tx\n",
+			   (unsigned long)t.refresh_us / 1000, (unsigned long)t.power_on_us / 1000, (unsigned long)t.power_off_us / 1000,
+			   (unsigned long)t.ready_us / 1000, (unsigned long)t.busy_us / 1000, t.factor_10x / 10, t.factor_10x % 10,
+			   t.passes[EPD_compensate], t.passes[EPD_white], t.passes[EPD_inverse], t.passes[EPD_normal],
+			   (unsigned long)t.lines, (unsigned long)t.spi_bytes, (unsigned long)t.spi_transactions);
+}
+
+// Private functions
+bool EPD::changed_lines(const uint8_t *image, uint16_t first_line, uint16_t last_line, uint16_t &first, uint16_t &last)
+{
+	if (last_line >= this->lines_per_display)
+	{
+		last_line = this->lines_per_display - 1;
+	}
+
+	// without a displayed image every line has changed
+	if (0 == buffer)
+	{
+		first = first_line;
+		last = last_line;
+		return first <= last;
+	}
+
+	// find the lines that differ from the displayed image
+	first = this->lines_per_display;
+	last = 0;
+	for (uint16_t line = first_line; line <= last_line; ++line)
+	{
+		uint32_t offset = (uint32_t)line * this->bytes_per_line;
+		if (0 != memcmp(&image[offset], &buffer[offset], this->bytes_per_line))
+		{
+			if (first > line)
+			{
+				first = line;
+			}
+			last = line;
+		}
+	}
+
+	return first <= last;
+}
+
+bool EPD::full_refresh_due()
+{
+	return 0 != this->full_refresh_interval && ++this->partial_count >= this->full_refresh_interval;
+}
+
+void EPD::drive(const uint8_t *image, uint16_t first_line, uint16_t last_line)
+{
+	this->cog_on();
+	this->drive_stages(image, first_line, last_line);
+	this->cog_off();
+}
+
+// the four stages from the displayed image to image, COG on
+void EPD::drive_stages(const uint8_t *image, uint16_t first_line, uint16_t last_line)
+{
+	// without a displayed image the lines are driven black first as clear()
+	line_source previous = buffer ? epd_image_source(buffer) : epd_fixed_source(0xff);
+	line_source next = epd_image_source(image);
+
+	// cached lines encode the displayed image, drop the ones of the new
+	// image that differ from it
+	this->invalidate_lines(image, first_line, last_line, (1 << EPD_inverse) | (1 << EPD_normal));
+
+	this->use_cache = true;
+	this->frame_repeat(previous, EPD_compensate, first_line, last_line);
+	this->frame_repeat(previous, EPD_white, first_line, last_line);
+	this->frame_repeat(next, EPD_inverse, first_line, last_line);
+	this->frame_repeat(next, EPD_normal, first_line, last_line);
+	this->use_cache = false;
+
+	this->invalidate_lines(image, first_line, last_line, (1 << EPD_compensate) | (1 << EPD_white));
+}
+
+// black then white over the whole panel, COG on
+void EPD::clear_stages()
 {
 	// clean buffer
 	if (buffer)
 	{
-		uint16_t bytes = ((dots_per_line + 7) / 8) * lines_per_display;
-		memset(buffer, 0, bytes);
+		memset(buffer, 0, this->bytes_per_image);
 	}
+	this->invalidate_cache();
 
 	// clean display
-	this->power_on_cog();
-	this->frame_fixed_repeat(0xff, EPD_compensate);
-	this->frame_fixed_repeat(0xff, EPD_white);
-	this->frame_fixed_repeat(0xaa, EPD_inverse);
-	this->frame_fixed_repeat(0xaa, EPD_normal);
-	this->power_off_cog();
+	line_source black = epd_fixed_source(0xff);
+	line_source white = epd_fixed_source(0xaa);
+	uint16_t last_line = this->lines_per_display - 1;
+
+	this->frame_repeat(black, EPD_compensate, 0, last_line);
+	this->frame_repeat(black, EPD_white, 0, last_line);
+	this->frame_repeat(white, EPD_inverse, 0, last_line);
+	this->frame_repeat(white, EPD_normal, 0, last_line);
 }
 
-void EPD::update(const uint8_t *image)
+refresh_action EPD::choose_refresh(uint16_t first, uint16_t last)
 {
-	uint16_t bytes = ((dots_per_line + 7) / 8) * lines_per_display;
+	if (first > last)
+	{
+		return EPD_skip;
+	}
 
-	this->power_on_cog();
-	this->frame_data_repeat(buffer, EPD_compensate);
-	this->frame_data_repeat(buffer, EPD_white);
-	this->frame_data_repeat(image, EPD_inverse);
-	this->frame_data_repeat(image, EPD_normal);
-	this->power_off_cog();
+	// periodic full refresh to remove ghosting
+	if (0 == this->policy)
+	{
+		return this->full_refresh_due() ? EPD_full : EPD_partial;
+	}
 
-	memcpy(buffer, image, bytes);
+	// the policy weighs partial updates by the stage time they need
+	if (this->panel_thermometer)
+	{
+		this->setFactor(this->panel_thermometer());
+	}
+	refresh_action action = this->policy->choose(first, last, this->factored_stage_time * 10 / this->stage_time, time(0));
+	if (EPD_partial == action && this->partial_count < 0xff)
+	{
+		++this->partial_count;
+	}
+	return action;
+}
+
+void EPD::refresh(const uint8_t *image, refresh_action action, uint16_t first, uint16_t last)
+{
+	uint16_t last_line = this->lines_per_display - 1;
+	this->last_refresh = action;
+
+	switch (action)
+	{
+	case EPD_partial:
+		this->drive(image, first, last);
+		break;
+
+	case EPD_full:
+		this->drive(image, 0, last_line);
+		this->partial_count = 0;
+		break;
+
+	case EPD_clear:
+		// white then the image in one power cycle
+		this->cog_on();
+		this->clear_stages();
+		this->drive_stages(image, 0, last_line);
+		this->cog_off();
+		this->partial_count = 0;
+		break;
+
+	default:
+		return;
+	}
+
+	if (this->policy)
+	{
+		this->policy->done(action, first, last, this->factored_stage_time * 10 / this->stage_time, time(0));
+	}
+}
+
+void EPD::invalidate_cache()
+{
+	if (this->line_valid)
+	{
+		memset(this->line_valid, 0, this->lines_per_display);
+	}
+}
+
+void EPD::refresh_task(void *parameter)
+{
+	EPD *epd = (EPD *)parameter;
+
+	for (;;)
+	{
+		// also woken up when an open session expires
+		ulTaskNotifyTake(pdTRUE, epd->session_wait());
+
+		for (;;)
+		{
+			xSemaphoreTake(epd->lock, portMAX_DELAY);
+			if (!epd->pending_valid)
+			{
+				xSemaphoreGive(epd->lock);
+
+				// power off after the last frame of a finished session, still
+				// busy until it is done
+				epd->close_session(false);
+
+				xSemaphoreTake(epd->lock, portMAX_DELAY);
+				if (!epd->pending_valid)
+				{
+					epd->busy = false;
+					xSemaphoreGive(epd->lock);
+					break;
+				}
+			}
+
+			// take the latest frame
+			uint8_t *image = epd->pending;
+			uint16_t first = epd->pending_first;
+			uint16_t last = epd->pending_last;
+			epd->pending = epd->snapshot;
+			epd->snapshot = image;
+			epd->pending_valid = false;
+			xSemaphoreGive(epd->lock);
+
+			// the displayed image is kept as the next free snapshot
+			epd->snapshot = epd->updateSwap(image, first, last);
+
+			if (epd->done_callback)
+			{
+				epd->done_callback(epd->done_context);
+			}
+		}
+	}
+}
+
+void EPD::lock_state()
+{
+	if (this->lock)
+	{
+		xSemaphoreTake(this->lock, portMAX_DELAY);
+	}
+}
+
+void EPD::unlock_state()
+{
+	if (this->lock)
+	{
+		xSemaphoreGive(this->lock);
+	}
+}
+
+// start of a refresh: power on unless a session kept the COG on
+void EPD::cog_on()
+{
+	// stage time for the current panel temperature
+	if (this->panel_thermometer)
+	{
+		this->setFactor(this->panel_thermometer());
+	}
+
+	Telemetry(memset(&this->telemetry, 0, sizeof(this->telemetry)));
+	Telemetry(this->telemetry.factor_10x = this->factored_stage_time * 10 / this->stage_time);
+	Telemetry(this->refresh_start = this->bus->time_us());
+
+	// wait for a power off going on in the other task
+	for (;;)
+	{
+		this->lock_state();
+		if (!this->driving)
+		{
+			break;
+		}
+		this->unlock_state();
+		this->bus->idle();
+	}
+	bool off = !this->powered;
+	this->driving = true;
+	this->unlock_state();
+
+	if (off)
+	{
+		this->power_on_cog();
+		this->lock_state();
+		this->powered = true;
+		this->unlock_state();
+
+		// let the refresh task watch the session timeout
+		if (this->session && this->task)
+		{
+			xTaskNotifyGive(this->task);
+		}
+	}
+}
+
+// end of a refresh: power off, or stop driving while the session lasts
+void EPD::cog_off()
+{
+	this->lock_state();
+	bool keep = this->session && !this->session_expired();
+	this->session = keep;
+	this->unlock_state();
+
+	if (keep)
+	{
+		this->line(0x7fffu, 0, 0x55, EPD_normal); // dummy line, no line driven
+	}
+	else
+	{
+		this->power_off_cog();
+	}
+
+	this->lock_state();
+	this->powered = keep;
+	this->driving = false;
+	this->unlock_state();
+
+	Telemetry(this->telemetry.refresh_us = this->bus->time_us() - this->refresh_start);
+}
+
+bool EPD::session_expired()
+{
+	return (this->bus->time_us() - this->session_start) / 1000 >= this->session_timeout;
+}
+
+// refresh task wait: until the session expires if it holds the COG on
+TickType_t EPD::session_wait()
+{
+	this->lock_state();
+	TickType_t wait = portMAX_DELAY;
+	if (this->session && this->powered)
+	{
+		uint32_t elapsed = (this->bus->time_us() - this->session_start) / 1000;
+		wait = elapsed < this->session_timeout ? pdMS_TO_TICKS(this->session_timeout - elapsed) + 1 : 0;
+	}
+	this->unlock_state();
+	return wait;
+}
+
+// power off if the session is over (force: ended now) and no refresh is
+// going on or queued, that one powers off at its end
+void EPD::close_session(bool force)
+{
+	this->lock_state();
+	if (force || (this->session && this->session_expired()))
+	{
+		this->session = false;
+	}
+	bool off = !this->session && this->powered && !this->driving && !this->pending_valid;
+	this->driving = this->driving || off;
+	this->unlock_state();
+
+	if (off)
+	{
+		this->power_off_cog();
+		this->lock_state();
+		this->powered = false;
+		this->driving = false;
+		this->unlock_state();
+	}
 }
 
-// Private functions
 void EPD::power_on_cog()
 {
-	SPI_put(0x00);
+	Telemetry(unsigned long power_on_start = this->bus->time_us());
+
+	// the COG is powered with CS low, keep the bus until CS is high
+	this->bus->lock();
+	this->SPI_put(0x00);
 
 	// initial state
-	digitalWrite(this->reset_pin, LOW);
-	digitalWrite(this->panel_on_pin, LOW);
-	digitalWrite(this->discharge_pin, LOW);
-	digitalWrite(this->border_pin, LOW);
-	digitalWrite(this->cs_pin, LOW);
+	this->bus->pin_write(this->reset_pin, LOW);
+	this->bus->pin_write(this->panel_on_pin, LOW);
+	this->bus->pin_write(this->discharge_pin, LOW);
+	this->bus->pin_write(this->border_pin, LOW);
+	this->bus->pin_write(this->cs_pin, LOW);
 
 	// power up sequence
-	digitalWrite(this->panel_on_pin, HIGH);
-	digitalWrite(this->cs_pin, HIGH);
-	digitalWrite(this->border_pin, HIGH);
+	this->bus->pin_write(this->panel_on_pin, HIGH);
+	this->bus->pin_write(this->cs_pin, HIGH);
+	this->bus->unlock();
+	this->bus->pin_write(this->border_pin, HIGH);
 	Delay_ms(5);
 
-	digitalWrite(this->reset_pin, LOW);
+	this->bus->pin_write(this->reset_pin, LOW);
 	Delay_ms(5);
 
-	digitalWrite(this->reset_pin, HIGH);
+	this->bus->pin_write(this->reset_pin, HIGH);
 
 	// wait for COG to become ready
-	while (HIGH == digitalRead(this->busy_pin))
+	Telemetry(unsigned long ready_start = this->bus->time_us());
+	while (HIGH == this->bus->pin_read(this->busy_pin))
 	{
-		yield();
+		this->bus->idle();
 	}
+	Telemetry(this->telemetry.ready_us = this->bus->time_us() - ready_start);
 
 	// channel select
-	SPI_send(this->cs_pin, CU8(0x70, 0x01), 2);
-	SPI_send(this->cs_pin, this->channel_select, this->channel_select_length);
+	this->SPI_send(CU8(0x70, 0x01), 2);
+	this->SPI_send(this->channel_select, this->channel_select_length);
 
 	// DC/DC frequency
-	SPI_send(this->cs_pin, CU8(0x70, 0x06), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0xff), 2);
+	this->SPI_send(CU8(0x70, 0x06), 2);
+	this->SPI_send(CU8(0x72, 0xff), 2);
 
 	// high power mode osc
-	SPI_send(this->cs_pin, CU8(0x70, 0x07), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x9d), 2);
+	this->SPI_send(CU8(0x70, 0x07), 2);
+	this->SPI_send(CU8(0x72, 0x9d), 2);
 
 	// disable ADC
-	SPI_send(this->cs_pin, CU8(0x70, 0x08), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x00), 2);
+	this->SPI_send(CU8(0x70, 0x08), 2);
+	this->SPI_send(CU8(0x72, 0x00), 2);
 
 	// Vcom level
 
-	SPI_send(this->cs_pin, CU8(0x70, 0x09), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0xd0, 0x00), 3);
+	this->SPI_send(CU8(0x70, 0x09), 2);
+	this->SPI_send(CU8(0x72, 0xd0, 0x00), 3);
 
 	// gate and source voltage levels
-	SPI_send(this->cs_pin, CU8(0x70, 0x04), 2);
-	SPI_send(this->cs_pin, this->gate_source, this->gate_source_length);
+	this->SPI_send(CU8(0x70, 0x04), 2);
+	this->SPI_send(this->gate_source, this->gate_source_length);
 
 	Delay_ms(5); //???
 
 	// driver latch on
-	SPI_send(this->cs_pin, CU8(0x70, 0x03), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x01), 2);
+	this->SPI_send(CU8(0x70, 0x03), 2);
+	this->SPI_send(CU8(0x72, 0x01), 2);
 
 	// driver latch off
-	SPI_send(this->cs_pin, CU8(0x70, 0x03), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x00), 2);
+	this->SPI_send(CU8(0x70, 0x03), 2);
+	this->SPI_send(CU8(0x72, 0x00), 2);
 
 	Delay_ms(5);
 
 	// charge pump positive voltage on
-	SPI_send(this->cs_pin, CU8(0x70, 0x05), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x01), 2);
+	this->SPI_send(CU8(0x70, 0x05), 2);
+	this->SPI_send(CU8(0x72, 0x01), 2);
 
 	// charge pump negative voltage on
-	SPI_send(this->cs_pin, CU8(0x70, 0x05), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x03), 2);
+	this->SPI_send(CU8(0x70, 0x05), 2);
+	this->SPI_send(CU8(0x72, 0x03), 2);
 
 	Delay_ms(30);
 
 	// Vcom driver on
-	SPI_send(this->cs_pin, CU8(0x70, 0x05), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x0f), 2);
+	this->SPI_send(CU8(0x70, 0x05), 2);
+	this->SPI_send(CU8(0x72, 0x0f), 2);
 
 	Delay_ms(30);
 
 	// output enable to disable
-	SPI_send(this->cs_pin, CU8(0x70, 0x02), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x24), 2);
+	this->SPI_send(CU8(0x70, 0x02), 2);
+	this->SPI_send(CU8(0x72, 0x24), 2);
+
+	Telemetry(this->telemetry.power_on_us = this->bus->time_us() - power_on_start);
 }
 
 void EPD::power_off_cog()
 {
+	Telemetry(unsigned long power_off_start = this->bus->time_us());
 
-	this->frame_fixed(0x55, EPD_normal);	  // dummy frame
+	// the cached lines are the image, not the dummy frame
+	this->use_cache = false;
+
+	line_source dummy = epd_fixed_source(0x55);
+	this->frame(dummy, EPD_normal, 0, this->lines_per_display - 1); // dummy frame
 	this->line(0x7fffu, 0, 0x55, EPD_normal); // dummy_line
 
 	Delay_ms(25);
 
-	digitalWrite(this->border_pin, LOW);
+	this->bus->pin_write(this->border_pin, LOW);
 	Delay_ms(30);
 
-	digitalWrite(this->border_pin, HIGH);
+	this->bus->pin_write(this->border_pin, HIGH);
 
 	// latch reset turn on
-	SPI_send(this->cs_pin, CU8(0x70, 0x03), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x01), 2);
+	this->SPI_send(CU8(0x70, 0x03), 2);
+	this->SPI_send(CU8(0x72, 0x01), 2);
 
 	// output enable off
-	SPI_send(this->cs_pin, CU8(0x70, 0x02), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x05), 2);
+	this->SPI_send(CU8(0x70, 0x02), 2);
+	this->SPI_send(CU8(0x72, 0x05), 2);
 
 	// Vcom power off
-	SPI_send(this->cs_pin, CU8(0x70, 0x05), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x0e), 2);
+	this->SPI_send(CU8(0x70, 0x05), 2);
+	this->SPI_send(CU8(0x72, 0x0e), 2);
 
 	// power off negative charge pump
-	SPI_send(this->cs_pin, CU8(0x70, 0x05), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x02), 2);
+	this->SPI_send(CU8(0x70, 0x05), 2);
+	this->SPI_send(CU8(0x72, 0x02), 2);
 
 	// discharge
-	SPI_send(this->cs_pin, CU8(0x70, 0x04), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x0c), 2);
+	this->SPI_send(CU8(0x70, 0x04), 2);
+	this->SPI_send(CU8(0x72, 0x0c), 2);
 
 	Delay_ms(120);
 
 	// all charge pumps off
-	SPI_send(this->cs_pin, CU8(0x70, 0x05), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x00), 2);
+	this->SPI_send(CU8(0x70, 0x05), 2);
+	this->SPI_send(CU8(0x72, 0x00), 2);
 
 	// turn of osc
-	SPI_send(this->cs_pin, CU8(0x70, 0x07), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x0d), 2);
+	this->SPI_send(CU8(0x70, 0x07), 2);
+	this->SPI_send(CU8(0x72, 0x0d), 2);
 
 	// discharge internal - 1
-	SPI_send(this->cs_pin, CU8(0x70, 0x04), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x50), 2);
+	this->SPI_send(CU8(0x70, 0x04), 2);
+	this->SPI_send(CU8(0x72, 0x50), 2);
 
 	Delay_ms(40);
 
 	// discharge internal - 2
-	SPI_send(this->cs_pin, CU8(0x70, 0x04), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0xA0), 2);
+	this->SPI_send(CU8(0x70, 0x04), 2);
+	this->SPI_send(CU8(0x72, 0xA0), 2);
 
 	Delay_ms(40);
 
 	// discharge internal - 3
-	SPI_send(this->cs_pin, CU8(0x70, 0x04), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x00), 2);
+	this->SPI_send(CU8(0x70, 0x04), 2);
+	this->SPI_send(CU8(0x72, 0x00), 2);
 
 	// turn of power and all signals
-	digitalWrite(this->reset_pin, LOW);
-	digitalWrite(this->panel_on_pin, LOW);
-	digitalWrite(this->border_pin, LOW);
-	digitalWrite(this->cs_pin, LOW);
+	this->bus->pin_write(this->reset_pin, LOW);
+	this->bus->pin_write(this->panel_on_pin, LOW);
+	this->bus->pin_write(this->border_pin, LOW);
+	this->bus->pin_write(this->cs_pin, LOW);
 
-	digitalWrite(this->discharge_pin, HIGH);
+	this->bus->pin_write(this->discharge_pin, HIGH);
 
-	SPI_put(0x00);
+	this->bus->lock();
+	this->SPI_put(0x00);
+	this->bus->unlock();
 
 	Delay_ms(150);
 
-	digitalWrite(this->discharge_pin, LOW);
+	this->bus->pin_write(this->discharge_pin, LOW);
+
+	Telemetry(this->telemetry.power_off_us = this->bus->time_us() - power_off_start);
 }
 
 uint8_t EPD::temperature_to_factor_10x(int16_t temperature)
 {
-	if (temperature <= -10)
-	{
-		return 170;
-	}
-	else if (temperature <= -5)
-	{
-		return 120;
-	}
-	else if (temperature <= 5)
+	// each point is the warmest temperature of a range of the former step
+	// table with that range factor, rising linearly towards the factor of
+	// the colder range: never below the table
+	static const struct
 	{
-		return 80;
-	}
-	else if (temperature <= 10)
-	{
-		return 40;
-	}
-	else if (temperature <= 15)
-	{
-		return 30;
-	}
-	else if (temperature <= 20)
+		int16_t temperature;
+		uint8_t factor_10x;
+	} curve[] = {{-10, 170}, {-5, 120}, {5, 80}, {10, 40}, {15, 30}, {20, 20}, {40, 10}, {41, 7}};
+	const uint8_t points = sizeof(curve) / sizeof(curve[0]);
+
+	if (temperature <= curve[0].temperature)
 	{
-		return 20;
+		return curve[0].factor_10x;
 	}
-	else if (temperature <= 40)
+
+	for (uint8_t i = 1; i < points; ++i)
 	{
-		return 10;
+		if (temperature < curve[i].temperature)
+		{
+			// rounded up
+			int16_t span = curve[i].temperature - curve[i - 1].temperature;
+			int16_t drop = curve[i - 1].factor_10x - curve[i].factor_10x;
+			return curve[i].factor_10x + (drop * (curve[i].temperature - temperature) + span - 1) / span;
+		}
 	}
-	return 7;
+
+	return curve[points - 1].factor_10x;
 }
 
-void EPD::frame_fixed(uint8_t fixed_value, stage stage)
+const uint8_t *EPD::source_line(const line_source &source, uint16_t line)
 {
-	for (uint8_t line = 0; line < this->lines_per_display; ++line)
+	if (source.image)
 	{
-		this->line(line, 0, fixed_value, stage);
+		return &source.image[(uint32_t)line * this->bytes_per_line];
 	}
-}
-
-void EPD::frame_data(const uint8_t *image, stage stage)
-{
-	for (uint8_t line = 0; line < this->lines_per_display; ++line)
+	if (source.read)
 	{
-		this->line(line, &image[line * this->bytes_per_line], 0, stage);
+		source.read(this->line_data, source.address + (uint32_t)line * this->bytes_per_line, this->bytes_per_line);
+		return this->line_data;
 	}
-}
-
-void EPD::frame_cb(uint32_t address, reader *reader, stage stage)
-{
-	static uint8_t buffer[264 / 8];
-	for (uint8_t line = 0; line < this->lines_per_display; ++line)
+	if (source.render)
 	{
-		reader(buffer, address + line * this->bytes_per_line, this->bytes_per_line);
-		this->line(line, buffer, 0, stage);
+		source.render(line, this->line_data, source.context);
+		return this->line_data;
 	}
+	return 0;
 }
 
-void EPD::frame_fixed_repeat(uint8_t fixed_value, stage stage)
+void EPD::frame(const line_source &source, stage stage, uint16_t first_line, uint16_t last_line)
 {
-	long stage_time = this->factored_stage_time;
-	do
+	for (uint16_t line = first_line; line <= last_line; ++line)
 	{
-		unsigned long t_start = millis();
-		this->frame_fixed(fixed_value, stage);
-		unsigned long t_end = millis();
-		if (t_end > t_start)
+		if (this->use_cache && this->line_valid)
 		{
-			stage_time -= t_end - t_start;
+			// encoded once per stage, later passes only move data
+			uint8_t *cached = &this->line_cache[stage][(uint32_t)line * this->line_length];
+			if (0 == (this->line_valid[line] & (1 << stage)))
+			{
+				this->encode_line(line, this->source_line(source, line), 0, stage, cached);
+				this->line_valid[line] |= 1 << stage;
+			}
+			this->send_line(cached, this->line_length);
 		}
 		else
 		{
-			stage_time -= t_start - t_end + 1 + ULONG_MAX;
+			this->line(line, this->source_line(source, line), source.fixed_value, stage);
 		}
-	} while (stage_time > 0);
+	}
 }
 
-void EPD::frame_data_repeat(const uint8_t *image, stage stage)
+void EPD::frame_repeat(const line_source &source, stage stage, uint16_t first_line, uint16_t last_line)
 {
-	long stage_time = this->factored_stage_time;
+	uint16_t lines = last_line - first_line + 1;
+
+	// each line must get as many passes as in a full frame, so the stage
+	// window shrinks with the number of lines driven
+	uint32_t window = (uint32_t)this->factored_stage_time * 1000 * lines / this->lines_per_display;
+
+	// whole passes only, so every line is driven the same time: stop when
+	// one more pass would end further past the window than stopping now
+	// ends before it
+	uint32_t start = this->bus->time_us();
+	uint32_t elapsed;
+	uint32_t pass;
 	do
 	{
-		unsigned long t_start = millis();
-		this->frame_data(image, stage);
-		unsigned long t_end = millis();
-		if (t_end > t_start)
-		{
-			stage_time -= t_end - t_start;
-		}
-		else
-		{
-			stage_time -= t_start - t_end + 1 + ULONG_MAX;
-		}
-	} while (stage_time > 0);
+		uint32_t t_start = this->bus->time_us();
+		this->frame(source, stage, first_line, last_line);
+		Telemetry(++this->telemetry.passes[stage]);
+		uint32_t t_pass = this->bus->time_us() - t_start;
+
+		// learn the cost of a line, kept across stages and refreshes
+		uint32_t line_time = t_pass / lines;
+		this->line_time = 0 == this->line_time ? line_time : (3 * this->line_time + line_time) / 4;
+
+		elapsed = this->bus->time_us() - start;
+		pass = this->line_time * lines;
+	} while (elapsed + pass / 2 < window);
 }
 
-void EPD::frame_cb_repeat(uint32_t address, reader *reader, stage stage)
+void EPD::line(uint16_t line, const uint8_t *data, uint8_t fixed_value, stage stage)
 {
-	long stage_time = this->factored_stage_time;
-	do
+	if (0 == this->line_buffer)
 	{
-		unsigned long t_start = millis();
-		this->frame_cb(address, reader, stage);
-		unsigned long t_end = millis();
-		if (t_end > t_start)
-		{
-			stage_time -= t_end - t_start;
-		}
-		else
-		{
-			stage_time -= t_start - t_end + 1 + ULONG_MAX;
-		}
-	} while (stage_time > 0);
+		return;
+	}
+
+	this->send_line(this->line_buffer, this->encode_line(line, data, fixed_value, stage, this->line_buffer));
 }
 
-void EPD::line(uint16_t line, const uint8_t *data, uint8_t fixed_value, stage stage)
+uint16_t EPD::encode_line(uint16_t line, const uint8_t *data, uint8_t fixed_value, stage stage, uint8_t *buffer)
 {
-	// charge pump voltage levels
-	SPI_send(this->cs_pin, CU8(0x70, 0x04), 2);
-	SPI_send(this->cs_pin, this->gate_source, this->gate_source_length);
-
-	// send data
-	SPI_send(this->cs_pin, CU8(0x70, 0x0a), 2);
-
-	// CS low
-	digitalWrite(this->cs_pin, LOW);
-	SPI_put_wait(0x72, this->busy_pin);
+	uint8_t *p = buffer;
+	*p++ = 0x72;
 
 	// even pixels
-	for (uint16_t b = this->bytes_per_line; b > 0; --b)
+	if (0 != data)
 	{
-		if (0 != data)
-		{
-			uint8_t pixels;
-			pixels = data[b - 1] & 0x55;
-
-			switch (stage)
-			{
-			case EPD_compensate: // B -> W, W -> B (Current Image)
-				pixels = 0xaa | (pixels ^ 0x55);
-				break;
-			case EPD_white: // B -> N, W -> W (Current Image)
-				pixels = 0x55 + (pixels ^ 0x55);
-				break;
-			case EPD_inverse: // B -> N, W -> B (New Image)
-				pixels = 0x55 | ((pixels ^ 0x55) << 1);
-				break;
-			case EPD_normal: // B -> B, W -> W (New Image)
-				pixels = 0xaa | pixels;
-				break;
-			}
-			uint8_t p1 = (pixels >> 0) & 0x03;
-			uint8_t p2 = (pixels >> 2) & 0x03;
-			uint8_t p3 = (pixels >> 4) & 0x03;
-			uint8_t p4 = (pixels >> 6) & 0x03;
-			pixels = (p1 << 6) | (p2 << 4) | (p3 << 2) | (p4 << 0);
-			SPI_put_wait(pixels, this->busy_pin);
-		}
-		else
+		const uint8_t *even = even_pixels[stage];
+		for (uint16_t b = this->bytes_per_line; b > 0; --b)
 		{
-			SPI_put_wait(fixed_value, this->busy_pin);
+			*p++ = even[data[b - 1]];
 		}
 	}
+	else
+	{
+		memset(p, fixed_value, this->bytes_per_line);
+		p += this->bytes_per_line;
+	}
 
 	// scan line
-	for (uint16_t b = 0; b < this->bytes_per_scan; ++b)
+	memset(p, 0x00, this->bytes_per_scan);
+	if (line / 4 < this->bytes_per_scan)
 	{
-		if (line / 4 == b)
-		{
-			SPI_put_wait(0xc0 >> (2 * (line & 0x03)), this->busy_pin);
-		}
-		else
-		{
-			SPI_put_wait(0x00, this->busy_pin);
-		}
+		p[line / 4] = 0xc0 >> (2 * (line & 0x03));
 	}
+	p += this->bytes_per_scan;
 
 	// odd pixels
-	for (uint16_t b = 0; b < this->bytes_per_line; ++b)
+	if (0 != data)
 	{
-		if (0 != data)
-		{
-			uint8_t pixels;
-			pixels = data[b] & 0xaa;
-
-			switch (stage)
-			{
-			case EPD_compensate: // B -> W, W -> B (Current Image)
-				pixels = 0xaa | ((pixels ^ 0xaa) >> 1);
-				break;
-			case EPD_white: // B -> N, W -> W (Current Image)
-				pixels = 0x55 + ((pixels ^ 0xaa) >> 1);
-				break;
-			case EPD_inverse: // B -> N, W -> B (New Image)
-				pixels = 0x55 | (pixels ^ 0xaa);
-				break;
-			case EPD_normal: // B -> B, W -> W (New Image)
-				pixels = 0xaa | (pixels >> 1);
-				break;
-			}
-			SPI_put_wait(pixels, this->busy_pin);
-		}
-		else
+		const uint8_t *odd = odd_pixels[stage];
+		for (uint16_t b = 0; b < this->bytes_per_line; ++b)
 		{
-			SPI_put_wait(fixed_value, this->busy_pin);
+			*p++ = odd[data[b]];
 		}
 	}
+	else
+	{
+		memset(p, fixed_value, this->bytes_per_line);
+		p += this->bytes_per_line;
+	}
 
 	if (this->filler)
 	{
-		SPI_put_wait(0x00, this->busy_pin);
+		*p++ = 0x00;
 	}
 
-	// CS high
-	digitalWrite(this->cs_pin, HIGH);
+	return p - buffer;
+}
+
+void EPD::send_line(const uint8_t *buffer, uint16_t length)
+{
+	Telemetry(++this->telemetry.lines);
+
+	// charge pump voltage levels
+	this->SPI_send(CU8(0x70, 0x04), 2);
+	this->SPI_send(this->gate_source, this->gate_source_length);
+
+	// send data
+	this->SPI_send(CU8(0x70, 0x0a), 2);
+	this->SPI_send_burst(buffer, length);
 
 	// output data to panel
-	SPI_send(this->cs_pin, CU8(0x70, 0x02), 2);
-	SPI_send(this->cs_pin, CU8(0x72, 0x2f), 2);
+	this->SPI_send(CU8(0x70, 0x02), 2);
+	this->SPI_send(CU8(0x72, 0x2f), 2);
 }
 
-// Internal functions
-static void SPI_put(uint8_t c)
+void EPD::invalidate_lines(const uint8_t *image, uint16_t first_line, uint16_t last_line, uint8_t stages)
 {
-	SPI.transfer(c);
+	if (0 == this->line_valid)
+	{
+		return;
+	}
+
+	for (uint16_t line = first_line; line <= last_line; ++line)
+	{
+		uint32_t offset = (uint32_t)line * this->bytes_per_line;
+		if (0 != memcmp(&image[offset], &buffer[offset], this->bytes_per_line))
+		{
+			this->line_valid[line] &= ~stages;
+		}
+	}
 }
 
-static void SPI_put_wait(uint8_t c, int busy_pin)
+// Internal functions
+void EPD::SPI_put(uint8_t c)
 {
+	Telemetry(++this->telemetry.spi_bytes);
+	this->bus->put(c);
+}
 
-	SPI_put(c);
-
+void EPD::SPI_wait()
+{
 	// wait for COG ready
-	while (HIGH == digitalRead(busy_pin))
+	if (HIGH != this->bus->pin_read(this->busy_pin))
+	{
+		return;
+	}
+
+	Telemetry(unsigned long start = this->bus->time_us());
+	while (HIGH == this->bus->pin_read(this->busy_pin))
 	{
+		this->bus->idle();
 	}
+	Telemetry(this->telemetry.busy_us += this->bus->time_us() - start);
 }
 
-static void SPI_send(uint8_t cs_pin, const uint8_t *buffer, uint16_t length)
+void EPD::SPI_send(const uint8_t *buffer, uint16_t length)
 {
+	Telemetry(++this->telemetry.spi_transactions);
+
 	// CS low
-	digitalWrite(cs_pin, LOW);
+	this->bus->lock();
+	this->bus->pin_write(this->cs_pin, LOW);
 
 	// send all data
 	for (uint16_t i = 0; i < length; ++i)
 	{
-		SPI_put(*buffer++);
+		this->SPI_put(*buffer++);
 	}
 
 	// CS high
-	digitalWrite(cs_pin, HIGH);
+	this->bus->pin_write(this->cs_pin, HIGH);
+	this->bus->unlock();
 	Delay_us(10);
-}
\ No newline at end of file
+}
+
+void EPD::SPI_send_burst(const uint8_t *buffer, uint16_t length)
+{
+	Telemetry(++this->telemetry.spi_transactions);
+	Telemetry(this->telemetry.spi_bytes += length);
+
+	// COG must be ready before a new data block
+	this->SPI_wait();
+
+	// CS low
+	this->bus->lock();
+	this->bus->pin_write(this->cs_pin, LOW);
+
+	// send all data in one transaction
+	this->bus->write(buffer, length);
+
+	// COG latches the block before CS goes high; the bus stays locked, with
+	// CS low the COG would take the bytes of another panel as its own
+	this->SPI_wait();
+
+	// CS high
+	this->bus->pin_write(this->cs_pin, HIGH);
+	this->bus->unlock();
+}
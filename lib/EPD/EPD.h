@@ -26,6 +26,22 @@
 #include <Arduino.h>
 #include <SPI.h>
 
+#include "EPD_bus.h"
+#include "EPD_policy.h"
+
+// supported panels
+typedef enum
+{
+	EPD_1_44, // 128 x 96
+	EPD_2_0,  // 200 x 96
+	EPD_2_7	  // 264 x 176
+} EPD_size;
+
+// geometry known at compile time, e.g. for static frame buffers
+#define EPD_WIDTH(size) (EPD_1_44 == (size) ? 128 : EPD_2_0 == (size) ? 200 : 264)
+#define EPD_HEIGHT(size) (EPD_2_7 == (size) ? 176 : 96)
+#define EPD_IMAGE_BYTES(size) (EPD_WIDTH(size) / 8 * EPD_HEIGHT(size))
+
 typedef enum
 {					// Image pixel -> Display pixel
 	EPD_compensate, // B -> W, W -> B (Current Image)
@@ -36,6 +52,74 @@ typedef enum
 
 typedef void reader(void *buffer, uint32_t address, uint16_t length);
 
+// draw one line (bytes_per_line bytes, image layout) on demand
+typedef void line_renderer(uint16_t line, uint8_t *data, void *context);
+
+// where the lines of a frame come from: a whole image (RAM or flash), a
+// reader of external memory at address + line * bytes_per_line, a
+// renderer called for each line or a fixed value for every byte
+typedef struct
+{
+	const uint8_t *image;
+	reader *read;
+	uint32_t address;
+	uint8_t fixed_value;
+	line_renderer *render;
+	void *context;
+} line_source;
+
+inline line_source epd_image_source(const uint8_t *image)
+{
+	line_source source = {image, 0, 0, 0, 0, 0};
+	return source;
+}
+
+inline line_source epd_fixed_source(uint8_t fixed_value)
+{
+	line_source source = {0, 0, 0, fixed_value, 0, 0};
+	return source;
+}
+
+inline line_source epd_reader_source(reader *read, uint32_t address)
+{
+	line_source source = {0, read, address, 0, 0, 0};
+	return source;
+}
+
+inline line_source epd_render_source(line_renderer *render, void *context)
+{
+	line_source source = {0, 0, 0, 0, render, context};
+	return source;
+}
+
+typedef void refresh_done(void *context);
+
+// longest power session, milliseconds
+#define EPD_SESSION_TIMEOUT 30000
+
+// panel temperature in degrees celsius
+typedef int16_t thermometer(void);
+
+// counters compiled in unless EPD_TELEMETRY is 0
+#ifndef EPD_TELEMETRY
+#define EPD_TELEMETRY 1
+#endif
+
+// what the last refresh cost, from power on to power off
+typedef struct
+{
+	uint16_t passes[4];		  // passes of each stage
+	uint32_t lines;			  // lines sent
+	uint32_t spi_bytes;
+	uint32_t spi_transactions; // chip select cycles
+	uint32_t busy_us;		  // waiting for BUSY before/after line data
+	uint32_t ready_us;		  // waiting for the COG after reset
+	uint32_t power_on_us;
+	uint32_t power_off_us;
+	uint32_t refresh_us;
+	uint8_t factor_10x; // stage time factor used
+} epd_telemetry;
+
 class EPD
 {
 private:
@@ -45,46 +129,131 @@ private:
 	uint8_t reset_pin;
 	uint8_t busy_pin;
 	uint8_t cs_pin;
-	SPIClass &SPI;
+	EPD_Bus *bus;
+	bool own_bus;
 
 	uint16_t stage_time;
 	uint16_t factored_stage_time;
+	uint32_t line_time; // measured, microseconds
 	uint16_t lines_per_display;
 	uint16_t dots_per_line;
 	uint16_t bytes_per_line;
 	uint16_t bytes_per_scan;
+	uint32_t bytes_per_image;
 	const uint8_t *gate_source;
 	uint16_t gate_source_length;
 	const uint8_t *channel_select;
 	uint16_t channel_select_length;
 	uint8_t *buffer;
+	uint8_t *line_buffer;
+	uint16_t line_length;
+
+	// one image line read from a reader or renderer
+	uint8_t *line_data;
+
+	// wire-ready lines of each stage, bit n of line_valid set when the
+	// line of stage n encodes the displayed image (or, while refreshing,
+	// the image being drawn)
+	uint8_t *line_cache[4];
+	uint8_t *line_valid;
+	bool use_cache; // only while the sources are the retained images
 
 	bool filler;
 
+	thermometer *panel_thermometer;
+
+	epd_telemetry telemetry;
+	unsigned long refresh_start;
+
+	// partial updates since the last full refresh
+	uint8_t full_refresh_interval;
+	uint8_t partial_count;
+
+	// chooses the refresh instead of full_refresh_interval, 0 if none
+	EPD_Policy *policy;
+	refresh_action last_refresh;
+
+	// asynchronous refresh: the caller writes the pending frame, the
+	// refresh task swaps it with the snapshot it is displaying
+	TaskHandle_t task;
+	SemaphoreHandle_t lock;
+	uint8_t *pending;
+	uint8_t *snapshot;
+	bool pending_valid;
+	uint16_t pending_first; // lines that may differ from the displayed image
+	uint16_t pending_last;
+	volatile bool busy;
+	refresh_done *done_callback;
+	void *done_context;
+
+	static void refresh_task(void *parameter);
+
+	// COG power: on from cog_on() to cog_off() of each refresh, and in
+	// between while a session is open; driving while a refresh (or a power
+	// sequence) owns it, state shared with the refresh task under lock
+	bool powered;
+	bool driving;
+	bool session;
+	unsigned long session_start;
+	uint32_t session_timeout;
+
+	void lock_state();
+	void unlock_state();
+	void cog_on();
+	void cog_off();
+	bool session_expired();
+	TickType_t session_wait();
+	void close_session(bool force);
+
+	// refresh helpers: lines of [first_line, last_line] that differ from
+	// the displayed image, periodic full refresh, four stages of a range
+	bool changed_lines(const uint8_t *image, uint16_t first_line, uint16_t last_line, uint16_t &first, uint16_t &last);
+	bool full_refresh_due();
+	void drive(const uint8_t *image, uint16_t first_line, uint16_t last_line);
+	void drive_stages(const uint8_t *image, uint16_t first_line, uint16_t last_line);
+	void clear_stages();
+
+	// refresh for the changed lines [first, last] (first > last if none)
+	// and running it, the retained image is left to the caller
+	refresh_action choose_refresh(uint16_t first, uint16_t last);
+	void refresh(const uint8_t *image, refresh_action action, uint16_t first, uint16_t last);
+
 	// turn on/off display driver
 	void power_on_cog();
 	void power_off_cog();
 
+	// line of a source, 0 for a fixed value
+	const uint8_t *source_line(const line_source &source, uint16_t line);
+
 	// single frame refresh
-	void frame_fixed(uint8_t fixed_value, stage stage);
-	void frame_data(const uint8_t *new_image, stage stage);
-	void frame_cb(uint32_t address, reader *reader, stage stage);
+	void frame(const line_source &source, stage stage, uint16_t first_line, uint16_t last_line);
 
-	// stage_time frame refresh
-	void frame_fixed_repeat(uint8_t fixed_value, stage stage);
-	void frame_data_repeat(const uint8_t *new_image, stage stage);
-	void frame_cb_repeat(uint32_t address, reader *reader, stage stage);
+	// stage_time frame refresh: the number of whole passes ending closest
+	// to the stage window, at least one
+	void frame_repeat(const line_source &source, stage stage, uint16_t first_line, uint16_t last_line);
 
 	// convert temperature to compensation factor
 	uint8_t temperature_to_factor_10x(int16_t temperature);
 
 	// single line display - very low-level
 	void line(uint16_t line, const uint8_t *data, uint8_t fixed_value, stage stage);
+	uint16_t encode_line(uint16_t line, const uint8_t *data, uint8_t fixed_value, stage stage, uint8_t *buffer);
+	void send_line(const uint8_t *buffer, uint16_t length);
+
+	// drop the cached lines of the given stages where image differs from
+	// the displayed one
+	void invalidate_lines(const uint8_t *image, uint16_t first_line, uint16_t last_line, uint8_t stages);
+	void invalidate_cache();
+
+	// bus helpers
+	void SPI_put(uint8_t c);
+	void SPI_wait();
+	void SPI_send(const uint8_t *buffer, uint16_t length);
+	void SPI_send_burst(const uint8_t *buffer, uint16_t length);
 
 public:
 	// Constructor
-	EPD(uint16_t width,
-		uint16_t height,
+	EPD(EPD_size size,
 		uint8_t panel_on_pin,
 		uint8_t border_pin,
 		uint8_t discharge_pin,
@@ -93,6 +262,16 @@ public:
 		uint8_t chip_select_pin,
 		SPIClass &SPI_driver);
 
+	// Constructor on a custom bus (shared SPI, recorder, simulator...)
+	EPD(EPD_size size,
+		uint8_t panel_on_pin,
+		uint8_t border_pin,
+		uint8_t discharge_pin,
+		uint8_t reset_pin,
+		uint8_t busy_pin,
+		uint8_t chip_select_pin,
+		EPD_Bus &bus);
+
 	~EPD(void);
 	
 	// initialize display pinout
@@ -101,11 +280,95 @@ public:
 	// set the display driver settings according to room temperature
 	void setFactor(int16_t temperature = 25);
 
+	// read the temperature before each refresh instead, the reader must not
+	// block (it may run on the refresh task)
+	void setThermometer(thermometer *thermometer);
+
+	// keep the COG powered from the next refresh until endRefresh(), so
+	// back-to-back refreshes (clear then update, several frames) share one
+	// power cycle; between them no line is driven. After timeout_ms (at
+	// most an hour) the panel is powered off at the end of the refresh
+	// going on, or right away by the refresh task if beginAsync() was called
+	void beginRefresh(uint32_t timeout_ms = EPD_SESSION_TIMEOUT);
+
+	// power off now, or after the frames queued for the refresh task
+	void endRefresh();
+
 	// clear display (anything -> white)
 	void clear();
 
 	// update the screen content with the new image
 	void update(const uint8_t *image);
+
+	// update only the lines of [first_line, last_line] that differ from the
+	// displayed image, nothing is driven if the image did not change
+	void updateRegion(const uint8_t *image, uint16_t first_line = 0, uint16_t last_line = 0xffff);
+
+	// refresh [first_line, last_line] from line sources instead of a
+	// resident image: previous is what the panel shows, next what it
+	// should show. The retained image, if any, is updated from next; the
+	// second form takes it as previous, or drives the lines black first as
+	// clear() does without one.
+	void updateStream(const line_source &previous, const line_source &next, uint16_t first_line = 0, uint16_t last_line = 0xffff);
+	void updateStream(const line_source &next, uint16_t first_line = 0, uint16_t last_line = 0xffff);
+
+	// take image as the displayed one instead of copying it and return the
+	// former one, same size, as the next frame buffer (contents undefined);
+	// only the lines of [first_line, last_line] may differ from it. Both
+	// come from malloc(): EPD owns image from then on and frees the one it
+	// holds in ~EPD, the caller owns the returned one (0 if EPD had none,
+	// every line of the range is then driven)
+	uint8_t *updateSwap(uint8_t *image, uint16_t first_line = 0, uint16_t last_line = 0xffff);
+
+	// turn every n-th partial update into a full one (0 = never)
+	void setFullRefreshInterval(uint8_t count);
+
+	// let a policy choose between skip, partial, full update and clear
+	// cycle in updateRegion() / updateSwap() (and the refresh task) from
+	// the ghosting built up, instead of the interval above; clear() and
+	// update() are accounted to it. 0 to go back to the interval
+	void setPolicy(EPD_Policy *policy);
+
+	// set what the panel shows without driving it, e.g. after a deep sleep
+	void restore(const uint8_t *image, uint8_t partial_count = 0);
+
+	// keep the encoded lines of each stage between passes and refreshes,
+	// 4 x height x line length bytes (about 79 KB for the 2.7"); false if
+	// the memory is not available, lines are then encoded on every pass
+	bool setLineCache(bool enable);
+
+	// image the panel shows, partial updates since the last full one
+	const uint8_t *getImage();
+	uint8_t getPartialCount();
+
+	// start the refresh task on the given core (1, the application core, by
+	// default), callback is called from that task after each refresh; do not
+	// mix with clear()/update() while busy
+	bool beginAsync(uint8_t core = 1, refresh_done *callback = 0, void *context = 0);
+
+	// queue a copy of image for the refresh task, a frame still waiting is
+	// replaced so only the latest one is displayed; the changed lines are
+	// found by comparing all of them
+	bool updateAsync(const uint8_t *image);
+
+	// same without the copy: image is handed over and a free buffer of the
+	// same size is returned for the next frame (0 without beginAsync()),
+	// only the lines of [first_line, last_line] may differ from the frame
+	// queued before. As for updateSwap(), both come from malloc(), the
+	// driver frees the buffers it holds in ~EPD and the caller the
+	// returned one
+	uint8_t *swapAsync(uint8_t *image, uint16_t first_line = 0, uint16_t last_line = 0xffff);
+
+	// true while a queued frame is waiting or being displayed
+	bool isBusy();
+
+	// what the last refresh did, EPD_skip if nothing changed (from the
+	// refresh task when called from its callback)
+	refresh_action getLastRefresh();
+
+	// counters of the last refresh (zero if EPD_TELEMETRY is 0)
+	const epd_telemetry &getTelemetry();
+	void printTelemetry(Print &out);
 };
 
 #endif
\ No newline at end of file
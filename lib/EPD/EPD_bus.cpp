@@ -0,0 +1,102 @@
+//
+// Arduino implementation of the EPD hardware access
+//
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#include "EPD_bus.h"
+
+EPD_ArduinoBus::EPD_ArduinoBus(SPIClass &SPI_driver) : SPI(SPI_driver)
+{
+}
+
+void EPD_ArduinoBus::begin()
+{
+	SPI.begin();
+	SPI.setBitOrder(MSBFIRST);
+	SPI.setDataMode(SPI_MODE0);
+	SPI.setClockDivider(SPI_CLOCK_DIV4);
+}
+
+void EPD_ArduinoBus::put(uint8_t c)
+{
+	SPI.transfer(c);
+}
+
+void EPD_ArduinoBus::write(const uint8_t *buffer, uint16_t length)
+{
+	SPI.writeBytes(buffer, length);
+}
+
+void EPD_ArduinoBus::pin_mode(uint8_t pin, uint8_t mode)
+{
+	pinMode(pin, mode);
+}
+
+void EPD_ArduinoBus::pin_write(uint8_t pin, uint8_t value)
+{
+	digitalWrite(pin, value);
+}
+
+int EPD_ArduinoBus::pin_read(uint8_t pin)
+{
+	return digitalRead(pin);
+}
+
+void EPD_ArduinoBus::delay_ms(uint32_t ms)
+{
+	delay(ms);
+}
+
+void EPD_ArduinoBus::delay_us(uint32_t us)
+{
+	delayMicroseconds(us);
+}
+
+unsigned long EPD_ArduinoBus::time_us()
+{
+	return micros();
+}
+
+void EPD_ArduinoBus::idle()
+{
+	yield();
+}
+
+EPD_SharedBus::EPD_SharedBus(SPIClass &SPI_driver) : EPD_ArduinoBus(SPI_driver)
+{
+	this->mutex = xSemaphoreCreateMutex();
+	this->started = false;
+}
+
+EPD_SharedBus::~EPD_SharedBus(void)
+{
+	vSemaphoreDelete(this->mutex);
+}
+
+void EPD_SharedBus::begin()
+{
+	// each panel calls it
+	this->lock();
+	if (!this->started)
+	{
+		EPD_ArduinoBus::begin();
+		this->started = true;
+	}
+	this->unlock();
+}
+
+void EPD_SharedBus::lock()
+{
+	xSemaphoreTake(this->mutex, portMAX_DELAY);
+}
+
+void EPD_SharedBus::unlock()
+{
+	xSemaphoreGive(this->mutex);
+
+	// a panel sends its lines back to back, let the one waiting for the
+	// bus take it now rather than at the next tick
+	taskYIELD();
+}
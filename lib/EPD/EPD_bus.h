@@ -0,0 +1,95 @@
+//
+// Hardware access used by the EPD driver: SPI bus, GPIO and clock.
+//
+// EPD only talks to the panel through this interface so the driver can be
+// run against another transport (shared bus, recorder, simulator) without
+// touching the COG sequences.
+//
+#ifndef EPD_BUS_H_
+#define EPD_BUS_H_
+
+#include <Arduino.h>
+#include <SPI.h>
+
+class EPD_Bus
+{
+public:
+	virtual ~EPD_Bus(void) {}
+
+	// SPI
+	virtual void begin() = 0;
+	virtual void put(uint8_t c) = 0;
+	virtual void write(const uint8_t *buffer, uint16_t length) = 0;
+
+	// GPIO
+	virtual void pin_mode(uint8_t pin, uint8_t mode) = 0;
+	virtual void pin_write(uint8_t pin, uint8_t value) = 0;
+	virtual int pin_read(uint8_t pin) = 0;
+
+	// clock
+	virtual void delay_ms(uint32_t ms) = 0;
+	virtual void delay_us(uint32_t us) = 0;
+	virtual unsigned long time_us() = 0;
+
+	// give other tasks a chance to run while spinning on BUSY
+	virtual void idle() = 0;
+
+	// around each SPI transaction, for buses shared between panels
+	virtual void lock() {}
+	virtual void unlock() {}
+};
+
+// default implementation on top of the Arduino core
+class EPD_ArduinoBus : public EPD_Bus
+{
+private:
+	SPIClass &SPI;
+
+public:
+	EPD_ArduinoBus(SPIClass &SPI_driver);
+
+	void begin();
+	void put(uint8_t c);
+	void write(const uint8_t *buffer, uint16_t length);
+
+	void pin_mode(uint8_t pin, uint8_t mode);
+	void pin_write(uint8_t pin, uint8_t value);
+	int pin_read(uint8_t pin);
+
+	void delay_ms(uint32_t ms);
+	void delay_us(uint32_t us);
+	unsigned long time_us();
+
+	void idle();
+};
+
+// one SPI bus shared by several panels with their own CS and BUSY pins:
+// pass the same instance to each EPD and refresh them from their own
+// tasks (beginAsync), their line transfers are then interleaved so the
+// stage windows of all panels run at the same time.
+//
+// The refresh tasks are the scheduler: frame_repeat() times the passes of
+// each panel against its own stage window, so a panel that gets the bus
+// less often makes fewer passes instead of a longer stage. The mutex
+// queues the tasks waiting for it in order and unlock() yields, so with
+// the tasks at the same priority the panels take the bus in turn, one
+// transfer each. BUSY is polled outside the lock except while a line
+// block latches, as CS is still low then.
+//
+// test/host/bench_epd.cpp refreshes two and three panels on one bus.
+class EPD_SharedBus : public EPD_ArduinoBus
+{
+private:
+	SemaphoreHandle_t mutex;
+	bool started;
+
+public:
+	EPD_SharedBus(SPIClass &SPI_driver);
+	~EPD_SharedBus(void);
+
+	void begin();
+	void lock();
+	void unlock();
+};
+
+#endif
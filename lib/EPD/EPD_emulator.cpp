@@ -0,0 +1,447 @@
+//
+// Emulation of the COG driven through EPD_Bus
+//
+
+#include <Arduino.h>
+
+#include "EPD_emulator.h"
+
+EPD_Emulator::EPD_Emulator(uint16_t width,
+						   uint16_t height,
+						   uint8_t chip_select_pin,
+						   uint8_t busy_pin,
+						   uint8_t panel_on_pin,
+						   uint32_t spi_hz) : width(width),
+											  height(height),
+											  cs_pin(chip_select_pin),
+											  busy_pin(busy_pin),
+											  panel_on_pin(panel_on_pin)
+{
+	this->bytes_per_line = width / 8;
+	this->bytes_per_scan = height / 4;
+	this->byte_ns = 8000000000ULL / spi_hz;
+	this->now_ns = 0;
+
+	this->selected = false;
+	this->transaction_length = 0;
+	this->reg = 0;
+	this->latched = false;
+	this->latch_ns = 0;
+
+	// header + even pixels + scan + odd pixels + filler
+	this->transaction_size = 1 + 2 * this->bytes_per_line + this->bytes_per_scan + 1;
+	this->transaction = (uint8_t *)malloc(this->transaction_size);
+	this->line_data = (uint8_t *)calloc(this->transaction_size, 1);
+	this->output = (uint8_t *)calloc(this->transaction_size, 1);
+
+	this->lines = (uint8_t *)calloc((uint32_t)height * this->transaction_size, 1);
+	this->pass_line = -1;
+	this->pass_changed = false;
+	this->stage_count = 0;
+
+	uint32_t pixels = (uint32_t)width * height;
+	uint32_t bytes = (uint32_t)this->bytes_per_line * height;
+	this->pass_us = (uint32_t *)calloc(pixels, sizeof(uint32_t));
+	this->stage_us = (uint32_t *)calloc(pixels * EPD_EMULATOR_STAGES, sizeof(uint32_t));
+	this->image = (uint8_t *)calloc(bytes, 1);
+	this->previous = (uint8_t *)calloc(bytes, 1);
+	this->driven = (uint8_t *)calloc(bytes, 1);
+}
+
+EPD_Emulator::~EPD_Emulator(void)
+{
+	free(this->transaction);
+	free(this->line_data);
+	free(this->output);
+	free(this->lines);
+	free(this->pass_us);
+	free(this->stage_us);
+	free(this->image);
+	free(this->previous);
+	free(this->driven);
+}
+
+void EPD_Emulator::begin()
+{
+}
+
+void EPD_Emulator::put(uint8_t c)
+{
+	this->now_ns += this->byte_ns;
+	this->receive(c);
+}
+
+void EPD_Emulator::write(const uint8_t *buffer, uint16_t length)
+{
+	this->now_ns += (uint64_t)this->byte_ns * length;
+	for (uint16_t i = 0; i < length; ++i)
+	{
+		this->receive(buffer[i]);
+	}
+}
+
+void EPD_Emulator::pin_mode(uint8_t, uint8_t)
+{
+}
+
+void EPD_Emulator::pin_write(uint8_t pin, uint8_t value)
+{
+	if (pin == this->cs_pin)
+	{
+		if (LOW == value)
+		{
+			this->selected = true;
+			this->transaction_length = 0;
+		}
+		else if (this->selected)
+		{
+			this->selected = false;
+			this->execute();
+		}
+	}
+	else if (pin == this->panel_on_pin)
+	{
+		if (HIGH == value)
+		{
+			this->begin_refresh();
+		}
+		else
+		{
+			this->end_refresh();
+		}
+	}
+}
+
+int EPD_Emulator::pin_read(uint8_t)
+{
+	// the emulated COG is always ready
+	return LOW;
+}
+
+void EPD_Emulator::delay_ms(uint32_t ms)
+{
+	this->now_ns += (uint64_t)ms * 1000000;
+}
+
+void EPD_Emulator::delay_us(uint32_t us)
+{
+	this->now_ns += (uint64_t)us * 1000;
+}
+
+unsigned long EPD_Emulator::time_us()
+{
+	return this->now_ns / 1000;
+}
+
+void EPD_Emulator::idle()
+{
+}
+
+const uint8_t *EPD_Emulator::getImage()
+{
+	return this->image;
+}
+
+uint8_t EPD_Emulator::stages()
+{
+	return this->stage_count;
+}
+
+uint32_t EPD_Emulator::driveTime(uint16_t x, uint16_t y, uint8_t stage)
+{
+	if (stage >= EPD_EMULATOR_STAGES)
+	{
+		return 0;
+	}
+	return this->stage_us[((uint32_t)y * this->width + x) * EPD_EMULATOR_STAGES + stage];
+}
+
+uint32_t EPD_Emulator::shortest_drive(uint16_t x, uint16_t y)
+{
+	uint32_t shortest = 0;
+	for (uint8_t s = 0; s < EPD_EMULATOR_STAGES; ++s)
+	{
+		uint32_t us = this->driveTime(x, y, s);
+		if (us && (!shortest || us < shortest))
+		{
+			shortest = us;
+		}
+	}
+	return shortest;
+}
+
+uint32_t EPD_Emulator::underDriven(uint32_t min_us)
+{
+	uint32_t count = 0;
+	for (uint16_t y = 0; y < this->height; ++y)
+	{
+		for (uint16_t x = 0; x < this->width; ++x)
+		{
+			if (this->get_bit(this->driven, x, y) && this->shortest_drive(x, y) < min_us)
+			{
+				++count;
+			}
+		}
+	}
+	return count;
+}
+
+uint32_t EPD_Emulator::ghosting(uint32_t min_us)
+{
+	uint32_t count = 0;
+	for (uint16_t y = 0; y < this->height; ++y)
+	{
+		for (uint16_t x = 0; x < this->width; ++x)
+		{
+			if (this->get_bit(this->driven, x, y) && this->shortest_drive(x, y) < min_us &&
+				this->get_bit(this->image, x, y) != this->get_bit(this->previous, x, y))
+			{
+				++count;
+			}
+		}
+	}
+	return count;
+}
+
+void EPD_Emulator::writeImage(Print &out)
+{
+	// PBM rows are padded to bytes with black set, as the canvas
+	out.printf("P4\n%u %u\n", this->width, this->height);
+	out.write(this->image, (size_t)this->bytes_per_line * this->height);
+}
+
+void EPD_Emulator::writeReport(Print &out, uint32_t min_us)
+{
+	out.printf("P5\n%u %u\n255\n", this->width, this->height);
+	for (uint16_t y = 0; y < this->height; ++y)
+	{
+		for (uint16_t x = 0; x < this->width; ++x)
+		{
+			uint32_t us = this->shortest_drive(x, y);
+			uint8_t gray = 255;
+			if (this->get_bit(this->driven, x, y) && us < min_us)
+			{
+				gray = (uint64_t)us * 255 / min_us;
+			}
+			out.write(gray);
+		}
+	}
+}
+
+// Private functions
+void EPD_Emulator::receive(uint8_t c)
+{
+	if (this->selected && this->transaction_length < this->transaction_size)
+	{
+		this->transaction[this->transaction_length++] = c;
+	}
+}
+
+void EPD_Emulator::execute()
+{
+	if (this->transaction_length < 2)
+	{
+		return;
+	}
+
+	// register index
+	if (0x70 == this->transaction[0])
+	{
+		this->reg = this->transaction[1];
+		return;
+	}
+
+	if (0x72 != this->transaction[0])
+	{
+		return;
+	}
+
+	switch (this->reg)
+	{
+	case 0x0a: // line data
+		memcpy(this->line_data, &this->transaction[1], this->transaction_length - 1);
+		break;
+
+	case 0x02: // output enable
+		this->drive_latched();
+		this->latched = 0x2f == this->transaction[1];
+		if (this->latched)
+		{
+			memcpy(this->output, this->line_data, this->transaction_size);
+			this->latch_ns = this->now_ns;
+			this->latch_line();
+		}
+		break;
+	}
+}
+
+// the latched line was driven from latch_ns until now
+void EPD_Emulator::drive_latched()
+{
+	if (!this->latched)
+	{
+		return;
+	}
+	this->latched = false;
+	uint32_t us = (this->now_ns - this->latch_ns) / 1000;
+
+	for (uint16_t y = 0; y < this->height; ++y)
+	{
+		// scan bytes: one pair per line, 11 selects it
+		uint8_t scan = this->output[this->bytes_per_line + y / 4];
+		if (0x03 != ((scan >> (6 - 2 * (y & 0x03))) & 0x03))
+		{
+			continue;
+		}
+
+		for (uint16_t x = 0; x < this->width; ++x)
+		{
+			drive_level level = this->level(x);
+			if (EPD_nothing == level)
+			{
+				continue;
+			}
+			this->pass_us[(uint32_t)y * this->width + x] += us;
+			this->set_bit(this->image, x, y, EPD_drive_black == level);
+			this->set_bit(this->driven, x, y, true);
+		}
+	}
+}
+
+// a line at or above the last one starts a pass, a line sending other
+// data than in the last pass starts a stage with the pass
+void EPD_Emulator::latch_line()
+{
+	int16_t line = this->scan_line();
+	if (line < 0)
+	{
+		return;
+	}
+	if (line <= this->pass_line)
+	{
+		this->end_pass();
+	}
+	this->pass_line = line;
+
+	uint8_t *last = &this->lines[(uint32_t)line * this->transaction_size];
+	if (0 != memcmp(last, this->output, this->transaction_size))
+	{
+		this->pass_changed = true;
+		memcpy(last, this->output, this->transaction_size);
+	}
+}
+
+// the drive of the pass goes to the stage it belongs to
+void EPD_Emulator::end_pass()
+{
+	uint32_t pixels = (uint32_t)this->width * this->height;
+	bool drove = false;
+	for (uint32_t i = 0; i < pixels && !drove; ++i)
+	{
+		drove = 0 != this->pass_us[i];
+	}
+
+	if (drove)
+	{
+		if ((this->pass_changed || 0 == this->stage_count) && this->stage_count < EPD_EMULATOR_STAGES)
+		{
+			++this->stage_count;
+		}
+		uint32_t *stage = &this->stage_us[this->stage_count - 1];
+		for (uint32_t i = 0; i < pixels; ++i)
+		{
+			stage[i * EPD_EMULATOR_STAGES] += this->pass_us[i];
+		}
+		memset(this->pass_us, 0, pixels * sizeof(uint32_t));
+	}
+
+	this->pass_line = -1;
+	this->pass_changed = false;
+}
+
+void EPD_Emulator::begin_refresh()
+{
+	uint32_t pixels = (uint32_t)this->width * this->height;
+	uint32_t bytes = (uint32_t)this->bytes_per_line * this->height;
+
+	memcpy(this->previous, this->image, bytes);
+	memset(this->driven, 0, bytes);
+	memset(this->lines, 0, (uint32_t)this->height * this->transaction_size);
+	memset(this->pass_us, 0, pixels * sizeof(uint32_t));
+	memset(this->stage_us, 0, pixels * EPD_EMULATOR_STAGES * sizeof(uint32_t));
+	this->pass_line = -1;
+	this->pass_changed = false;
+	this->stage_count = 0;
+	this->latched = false;
+}
+
+void EPD_Emulator::end_refresh()
+{
+	this->drive_latched();
+	this->end_pass();
+}
+
+// line selected by the latched scan bytes, -1 if none
+int16_t EPD_Emulator::scan_line() const
+{
+	for (uint16_t b = 0; b < this->bytes_per_scan; ++b)
+	{
+		uint8_t scan = this->output[this->bytes_per_line + b];
+		for (uint8_t pair = 0; pair < 4 && scan; ++pair)
+		{
+			if (0x03 == ((scan >> (6 - 2 * pair)) & 0x03))
+			{
+				return 4 * b + pair;
+			}
+		}
+	}
+	return -1;
+}
+
+// decode the 2-bit drive level of a pixel from the latched line, see the
+// even_pixels / odd_pixels tables of EPD
+drive_level EPD_Emulator::level(uint16_t x) const
+{
+	uint16_t b = x / 8;
+	uint8_t bit = 7 - (x & 0x07);
+	uint8_t value;
+
+	if (0 == (bit & 0x01))
+	{
+		// even pixels, bytes in reverse order, image bit 0 in the top pair
+		value = this->output[this->bytes_per_line - 1 - b] >> (6 - bit);
+	}
+	else
+	{
+		// odd pixels, image bit 7 in the top pair
+		value = this->output[this->bytes_per_line + this->bytes_per_scan + b] >> (bit - 1);
+	}
+
+	switch (value & 0x03)
+	{
+	case 0x03:
+		return EPD_drive_black;
+	case 0x02:
+		return EPD_drive_white;
+	default:
+		return EPD_nothing;
+	}
+}
+
+bool EPD_Emulator::get_bit(const uint8_t *bits, uint16_t x, uint16_t y) const
+{
+	return bits[(uint32_t)y * this->bytes_per_line + x / 8] & (0x80 >> (x & 0x07));
+}
+
+void EPD_Emulator::set_bit(uint8_t *bits, uint16_t x, uint16_t y, bool value)
+{
+	uint8_t *p = &bits[(uint32_t)y * this->bytes_per_line + x / 8];
+	if (value)
+	{
+		*p |= 0x80 >> (x & 0x07);
+	}
+	else
+	{
+		*p &= ~(0x80 >> (x & 0x07));
+	}
+}
@@ -0,0 +1,149 @@
+//
+// Emulation of the COG driven through EPD_Bus, for any of the panel sizes.
+//
+// The emulator decodes the register writes EPD sends (line data, scan
+// bytes, output enable) and integrates how long each pixel is driven
+// black or white in each stage, on a simulated clock advanced by the
+// delays and by the SPI transfer time. BUSY is never asserted.
+//
+// A stage is a run of passes over the lines sending the same data, a pass
+// sending other data starts the next one (the two black stages of clear()
+// count as one); passes driving nothing are not counted.
+//
+// A line is only driven while it is latched, so drive times are passes x
+// line time (a few milliseconds per stage), not stage times: under-drive
+// thresholds come from a run of the reference driver.
+//
+// It needs about 21 bytes per pixel (1 MB for the 2.7"), it is meant
+// for a host build with an Arduino shim, to check driver changes without
+// a panel:
+//
+//   EPD_Emulator cog(EPD_WIDTH(EPD_2_7), EPD_HEIGHT(EPD_2_7), 5, 27, 33);
+//   EPD epd(EPD_2_7, 33, 25, 26, 27, 14, 5, cog);
+//   epd.begin();
+//   epd.update(image);
+//   cog.writeImage(out);
+//   cog.writeReport(out, reference_us);
+//
+#ifndef EPD_EMULATOR_H_
+#define EPD_EMULATOR_H_
+
+#include <Arduino.h>
+
+#include "EPD_bus.h"
+
+// drive level of a pixel, as encoded on the wire
+typedef enum
+{
+	EPD_nothing,
+	EPD_drive_white = 2,
+	EPD_drive_black = 3
+} drive_level;
+
+// stages kept per pixel, later ones are added to the last
+#define EPD_EMULATOR_STAGES 4
+
+class EPD_Emulator : public EPD_Bus
+{
+private:
+	uint16_t width;
+	uint16_t height;
+	uint16_t bytes_per_line;
+	uint16_t bytes_per_scan;
+	uint8_t cs_pin;
+	uint8_t busy_pin;
+	uint8_t panel_on_pin;
+	uint32_t byte_ns;
+
+	// simulated clock
+	uint64_t now_ns;
+
+	// transaction being received while CS is low
+	bool selected;
+	uint8_t *transaction;
+	uint16_t transaction_length;
+	uint16_t transaction_size;
+	uint8_t reg;
+
+	// line data shifted in, and the one latched by the last output command
+	uint8_t *line_data;
+	uint8_t *output;
+	bool latched;
+	uint64_t latch_ns;
+
+	// data last latched for each line, line of the pass going on (-1
+	// before the first), whether it sends other data than the last pass
+	uint8_t *lines;
+	int16_t pass_line;
+	bool pass_changed;
+	uint8_t stage_count;
+
+	// per pixel: black or white drive of the pass going on and of each
+	// stage, resulting and previous image (1 bit per pixel, black set,
+	// canvas layout), driven during this refresh
+	uint32_t *pass_us;
+	uint32_t *stage_us;
+	uint8_t *image;
+	uint8_t *previous;
+	uint8_t *driven;
+
+	void receive(uint8_t c);
+	void execute();
+	void drive_latched();
+	void latch_line();
+	void end_pass();
+	void begin_refresh();
+	void end_refresh();
+
+	int16_t scan_line() const;
+	uint32_t shortest_drive(uint16_t x, uint16_t y);
+	drive_level level(uint16_t x) const;
+	bool get_bit(const uint8_t *bits, uint16_t x, uint16_t y) const;
+	void set_bit(uint8_t *bits, uint16_t x, uint16_t y, bool value);
+
+public:
+	// spi_hz is the bus clock used to account for transfer time
+	EPD_Emulator(uint16_t width,
+				 uint16_t height,
+				 uint8_t chip_select_pin,
+				 uint8_t busy_pin,
+				 uint8_t panel_on_pin,
+				 uint32_t spi_hz = 4000000);
+	~EPD_Emulator(void);
+
+	// EPD_Bus
+	void begin();
+	void put(uint8_t c);
+	void write(const uint8_t *buffer, uint16_t length);
+
+	void pin_mode(uint8_t pin, uint8_t mode);
+	void pin_write(uint8_t pin, uint8_t value);
+	int pin_read(uint8_t pin);
+
+	void delay_ms(uint32_t ms);
+	void delay_us(uint32_t us);
+	unsigned long time_us();
+
+	void idle();
+
+	// image left on the panel, in the EPD / canvas layout (black set)
+	const uint8_t *getImage();
+
+	// stages of the last refresh, and how long the pixel was driven black
+	// or white in one of them, 0 if it was not driven
+	uint8_t stages();
+	uint32_t driveTime(uint16_t x, uint16_t y, uint8_t stage);
+
+	// pixels driven for less than min_us in a stage of the last refresh,
+	// and those of them which changed color (ghosting)
+	uint32_t underDriven(uint32_t min_us);
+	uint32_t ghosting(uint32_t min_us);
+
+	// panel image as a binary PBM, drive report as a PGM: white when each
+	// stage driving the pixel lasted at least min_us, darker the shorter
+	// the shortest one
+	void writeImage(Print &out);
+	void writeReport(Print &out, uint32_t min_us);
+};
+
+#endif
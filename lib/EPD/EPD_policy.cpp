@@ -0,0 +1,114 @@
+//
+// Refresh policy
+//
+
+#include <Arduino.h>
+
+#include "EPD_policy.h"
+
+static const epd_budget default_budget = EPD_DEFAULT_BUDGET;
+
+EPD_Policy::EPD_Policy(epd_ghosting &state, uint16_t lines) : EPD_Policy(state, lines, default_budget)
+{
+}
+
+EPD_Policy::EPD_Policy(epd_ghosting &state,
+					   uint16_t lines,
+					   const epd_budget &budget) : state(state),
+												   budget(budget),
+												   lines(lines)
+{
+}
+
+void EPD_Policy::reset()
+{
+	memset(&this->state, 0, sizeof(this->state));
+}
+
+refresh_action EPD_Policy::choose(uint16_t first_line, uint16_t last_line, uint8_t factor_10x, uint32_t now)
+{
+	if (first_line > last_line)
+	{
+		return EPD_skip;
+	}
+
+	// content unknown or left too long without a clear
+	if (!this->state.known ||
+		(0 != this->budget.full_count && this->state.full_count >= this->budget.full_count) ||
+		this->older(this->state.clear_time, this->budget.clear_age, now))
+	{
+		return EPD_clear;
+	}
+
+	if (this->older(this->state.full_time, this->budget.full_age, now))
+	{
+		return EPD_full;
+	}
+
+	// one changed band over budget is enough to drive them all
+	for (uint8_t b = this->band(first_line); b <= this->band(last_line); ++b)
+	{
+		if (this->state.debt[b] + factor_10x > this->budget.full_debt)
+		{
+			return EPD_full;
+		}
+	}
+
+	return EPD_partial;
+}
+
+void EPD_Policy::done(refresh_action action, uint16_t first_line, uint16_t last_line, uint8_t factor_10x, uint32_t now)
+{
+	bool clock = now >= EPD_POLICY_CLOCK_VALID;
+
+	switch (action)
+	{
+	case EPD_clear:
+		this->state.known = true;
+		this->state.full_count = 0;
+		this->state.clear_time = clock ? now : 0;
+		this->state.full_time = this->state.clear_time;
+		memset(this->state.debt, 0, sizeof(this->state.debt));
+		break;
+
+	case EPD_full:
+		if (this->state.full_count < 0xff)
+		{
+			++this->state.full_count;
+		}
+		this->state.full_time = clock ? now : 0;
+		memset(this->state.debt, 0, sizeof(this->state.debt));
+		break;
+
+	case EPD_partial:
+		if (first_line > last_line)
+		{
+			break;
+		}
+		for (uint8_t b = this->band(first_line); b <= this->band(last_line); ++b)
+		{
+			uint16_t debt = this->state.debt[b] + factor_10x;
+			this->state.debt[b] = debt < 0xff ? debt : 0xff;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+// Private functions
+uint8_t EPD_Policy::band(uint16_t line)
+{
+	if (line >= this->lines)
+	{
+		line = this->lines - 1;
+	}
+	return (uint32_t)line * EPD_POLICY_BANDS / this->lines;
+}
+
+// true if time is known and more than age ago
+bool EPD_Policy::older(uint32_t time, uint32_t age, uint32_t now)
+{
+	return 0 != age && 0 != time && now >= EPD_POLICY_CLOCK_VALID && now - time >= age;
+}
@@ -0,0 +1,84 @@
+//
+// Refresh policy: how much ghosting the panel may show.
+//
+// Each partial update leaves some ghosting on the lines it drives, more
+// when it is cold (long stages). The policy keeps that debt per band of
+// lines, with the time of the last full update and of the last clear
+// cycle, and picks the cheapest refresh keeping within the budget:
+//
+//   skip     nothing changed
+//   partial  the changed lines only
+//   full     every line through the four stages, when a changed band is
+//            over budget or the last full update is too old
+//   clear    a clear cycle then a full update, every few full updates or
+//            when the last clear is too old, and when the panel content
+//            is unknown
+//
+// The state is plain data so it can live in RTC memory across deep sleep.
+//
+#ifndef EPD_POLICY_H_
+#define EPD_POLICY_H_
+
+#include <Arduino.h>
+
+#define EPD_POLICY_BANDS 32
+
+// below this the clock is not set (seconds since 1970), ages are ignored
+#define EPD_POLICY_CLOCK_VALID 1500000000UL
+
+typedef enum
+{
+	EPD_skip,
+	EPD_partial,
+	EPD_full,
+	EPD_clear
+} refresh_action;
+
+typedef struct
+{
+	uint8_t full_debt;	 // debt of a band forcing a full update, a partial
+						 // update costs the stage time factor (10 at 21 C)
+	uint8_t full_count;	 // full updates between clear cycles, 0 = never
+	uint32_t full_age;	 // seconds between full updates, 0 = never
+	uint32_t clear_age;	 // seconds between clear cycles, 0 = never
+} epd_budget;
+
+// about 8 partial updates at room temperature, one at 0 C
+#define EPD_DEFAULT_BUDGET {80, 8, 6 * 3600UL, 24 * 3600UL}
+
+typedef struct
+{
+	bool known;			 // false until the first clear cycle
+	uint8_t full_count;	 // full updates since the last clear cycle
+	uint32_t full_time;	 // seconds since 1970, 0 if unknown
+	uint32_t clear_time; // seconds since 1970, 0 if unknown
+	uint8_t debt[EPD_POLICY_BANDS];
+} epd_ghosting;
+
+class EPD_Policy
+{
+private:
+	epd_ghosting &state;
+	epd_budget budget;
+	uint16_t lines;
+
+	uint8_t band(uint16_t line);
+	bool older(uint32_t time, uint32_t age, uint32_t now);
+
+public:
+	EPD_Policy(epd_ghosting &state, uint16_t lines);
+	EPD_Policy(epd_ghosting &state, uint16_t lines, const epd_budget &budget);
+
+	// panel content unknown (first start, lost image): clear next time
+	void reset();
+
+	// refresh for the changed lines [first_line, last_line], first_line >
+	// last_line if none; factor_10x is the stage time factor of the panel
+	// temperature, now the time in seconds since 1970 (0 if unknown)
+	refresh_action choose(uint16_t first_line, uint16_t last_line, uint8_t factor_10x, uint32_t now);
+
+	// account for a refresh done, whoever chose it
+	void done(refresh_action action, uint16_t first_line, uint16_t last_line, uint8_t factor_10x, uint32_t now);
+};
+
+#endif
@@ -13,10 +13,454 @@ class Frame : public GFXcanvas1
 {
 public:
   Frame(uint16_t w, uint16_t h):GFXcanvas1(w, h) {
+    ink.clear();
+    damage.clear();
   }
 
   void clear() {
-    GFXcanvas1::fillScreen(WHITE);
+    fillScreen(WHITE);
+  }
+
+  // hand the canvas over (e.g. to EPD::updateSwap) and draw into next,
+  // same size, from now on; its contents are undefined until clear()
+  uint8_t *swapBuffer(uint8_t *next) {
+    uint8_t *previous = buffer;
+    buffer = next;
+    return previous;
+  }
+
+  // drawing primitives, tracking the area they modify
+  void drawPixel(int16_t x, int16_t y, uint16_t color) {
+    GFXcanvas1::drawPixel(x, y, color);
+    touch(x, y, 1, 1, color);
+  }
+
+  // lines and rectangles are filled a row span at a time: masked edge
+  // bytes, whole 32-bit words in between
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    fillRect(x, y, 1, h, color);
+  }
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    fillRect(x, y, w, 1, color);
+  }
+
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    Area area;
+    if (toBuffer(x, y, w, h, area)) {
+      fillArea(area, color ? SET : RESET);
+      track(area, color);
+    }
+  }
+
+  // swap black and white, e.g. for highlighted banners
+  void invertRect(int16_t x, int16_t y, int16_t w, int16_t h) {
+    Area area;
+    if (toBuffer(x, y, w, h, area)) {
+      fillArea(area, INVERT);
+      ink.add(area);
+      damage.add(area);
+    }
+  }
+
+  // copy a rectangle to (dx, dy), source and destination may overlap
+  void copyRect(int16_t sx, int16_t sy, int16_t w, int16_t h, int16_t dx, int16_t dy) {
+    // clip both rectangles against the display
+    int16_t left = sx < dx ? sx : dx;
+    int16_t top = sy < dy ? sy : dy;
+    if (left < 0) {
+      sx -= left;
+      dx -= left;
+      w += left;
+    }
+    if (top < 0) {
+      sy -= top;
+      dy -= top;
+      h += top;
+    }
+    int16_t right = sx > dx ? sx : dx;
+    int16_t bottom = sy > dy ? sy : dy;
+    if (right + w > _width) {
+      w = _width - right;
+    }
+    if (bottom + h > _height) {
+      h = _height - bottom;
+    }
+    if (w <= 0 || h <= 0) {
+      return;
+    }
+
+    // rows and chunks in an order that reads each source bit before it
+    // is overwritten
+    bool up = dy > sy;
+    bool backward = dx > sx;
+    for (int16_t j = 0; j < h; ++j) {
+      int16_t row = up ? h - 1 - j : j;
+      for (int16_t i = 0; i < w; i += COPY_CHUNK) {
+        int16_t count = w - i < COPY_CHUNK ? w - i : COPY_CHUNK;
+        int16_t column = backward ? w - i - count : i;
+        if (0 == getRotation()) {
+          copyBits(sx + column, sy + row, count, dx + column, dy + row);
+        } else {
+          bool bits[COPY_CHUNK];
+          for (int16_t k = 0; k < count; ++k) {
+            bits[k] = getPixel(sx + column + k, sy + row);
+          }
+          for (int16_t k = 0; k < count; ++k) {
+            GFXcanvas1::drawPixel(dx + column + k, dy + row, bits[k]);
+          }
+        }
+      }
+    }
+
+    // the copied pixels may be black
+    touch(dx, dy, w, h, BLACK);
+  }
+
+  // w pixels of a bitmap row, leftmost in the most significant bit, drawn
+  // in color where they are set (sprites); shifted into the buffer a byte
+  // at a time unless rotated or crossing the edges
+  void drawSpan(int16_t x, int16_t y, const uint8_t *bits, int16_t w, uint16_t color) {
+    if (w <= 0) {
+      return;
+    }
+    if (0 != getRotation() || x < 0 || y < 0 || x + w > _width || y >= _height) {
+      for (int16_t i = 0; i < w; ++i) {
+        if (bits[i / 8] & (0x80 >> (i & 7))) {
+          GFXcanvas1::drawPixel(x + i, y, color);
+        }
+      }
+    } else {
+      uint16_t bytesPerRow = (WIDTH + 7) / 8;
+      uint8_t *p = getBuffer() + y * bytesPerRow + x / 8;
+      uint8_t shift = x & 7;
+      for (int16_t i = 0; i < w; i += 8, ++p) {
+        uint8_t byte = w - i < 8 ? bits[i / 8] & (0xff << (8 - (w - i))) : bits[i / 8];
+        uint16_t mask = (uint16_t)byte << 8 >> shift;
+        if (color) {
+          p[0] |= mask >> 8;
+          if (mask & 0xff) {
+            p[1] |= mask;
+          }
+        } else {
+          p[0] &= ~(mask >> 8);
+          if (mask & 0xff) {
+            p[1] &= ~mask;
+          }
+        }
+      }
+    }
+    touch(x, y, w, 1, color);
+  }
+
+  // text in the built-in font is copied a row at a time from the glyph
+  // atlas instead of pixel by pixel; other fonts, sizes and rotations, and
+  // glyphs crossing the edges, go through Adafruit GFX
+  size_t write(uint8_t c) {
+    if (gfxFont || 1 != textsize_x || 1 != textsize_y || 0 != getRotation()) {
+      return GFXcanvas1::write(c);
+    }
+
+    // same layout rules as Adafruit_GFX::write()
+    if ('\n' == c) {
+      cursor_x = 0;
+      cursor_y += 8;
+    } else if ('\r' != c) {
+      if (wrap && cursor_x + 6 > _width) {
+        cursor_x = 0;
+        cursor_y += 8;
+      }
+      drawGlyph(cursor_x, cursor_y, c, textcolor, textbgcolor);
+      cursor_x += 6;
+    }
+    return 1;
+  }
+
+  void fillScreen(uint16_t color) {
+    GFXcanvas1::fillScreen(color);
+    if (WHITE == color) {
+      // only what was drawn before goes back to white
+      damage.add(ink);
+      ink.clear();
+    } else {
+      ink.set(0, 0, WIDTH - 1, HEIGHT - 1);
+      damage.add(ink);
+    }
+  }
+
+  // modified area since the last clearDirty(), in buffer coordinates
+  // (buffer lines are display lines)
+  bool isDirty() const {
+    return !damage.empty();
+  }
+
+  int16_t dirtyFirstLine() const {
+    return damage.y0;
+  }
+
+  int16_t dirtyLastLine() const {
+    return damage.y1;
+  }
+
+  void getDirtyRect(int16_t &x, int16_t &y, int16_t &w, int16_t &h) const {
+    if (damage.empty()) {
+      x = y = w = h = 0;
+      return;
+    }
+    x = damage.x0;
+    y = damage.y0;
+    w = damage.x1 - damage.x0 + 1;
+    h = damage.y1 - damage.y0 + 1;
+  }
+
+  void clearDirty() {
+    damage.clear();
+  }
+
+  // the buffer was written behind Frame's back (e.g. loaded from flash):
+  // black pixels may be anywhere, the next clear() damages every line
+  void invalidate() {
+    ink.set(0, 0, WIDTH - 1, HEIGHT - 1);
+  }
+
+private:
+  enum RasterOp {
+    RESET,
+    SET,
+    INVERT
+  };
+
+  static const int16_t COPY_CHUNK = 64;
+
+  // inclusive rectangle in buffer coordinates
+  struct Area {
+    int16_t x0, y0, x1, y1;
+
+    void clear() {
+      x0 = y0 = INT16_MAX;
+      x1 = y1 = INT16_MIN;
+    }
+
+    bool empty() const {
+      return x0 > x1 || y0 > y1;
+    }
+
+    void set(int16_t ax0, int16_t ay0, int16_t ax1, int16_t ay1) {
+      x0 = ax0;
+      y0 = ay0;
+      x1 = ax1;
+      y1 = ay1;
+    }
+
+    void add(const Area &a) {
+      if (a.empty()) {
+        return;
+      }
+      if (empty()) {
+        *this = a;
+        return;
+      }
+      x0 = min(x0, a.x0);
+      y0 = min(y0, a.y0);
+      x1 = max(x1, a.x1);
+      y1 = max(y1, a.y1);
+    }
+
+    void intersect(const Area &a) {
+      x0 = max(x0, a.x0);
+      y0 = max(y0, a.y0);
+      x1 = min(x1, a.x1);
+      y1 = min(y1, a.y1);
+    }
+
+  private:
+    static int16_t min(int16_t a, int16_t b) { return a < b ? a : b; }
+    static int16_t max(int16_t a, int16_t b) { return a > b ? a : b; }
+  };
+
+  // built-in 5x7 font, one byte per glyph row, leftmost pixel in the most
+  // significant bit (the canvas layout), 6th column is the spacing
+  static const uint8_t (&glyphAtlas())[256][8] {
+    static uint8_t atlas[256][8];
+    static bool built = false;
+    if (!built) {
+      // the font table is private to Adafruit GFX, render it once
+      GFXcanvas1 glyph(8, 8);
+      glyph.cp437(true);
+      for (uint16_t c = 0; c < 256; ++c) {
+        glyph.fillScreen(0);
+        glyph.drawChar(0, 0, c, 1, 0, 1);
+        memcpy(atlas[c], glyph.getBuffer(), 8);
+      }
+      built = true;
+    }
+    return atlas;
+  }
+
+  void drawGlyph(int16_t x, int16_t y, uint8_t c, uint16_t color, uint16_t bg) {
+    if (x < 0 || y < 0 || x + 6 > _width || y + 8 > _height) {
+      GFXcanvas1::drawChar(x, y, c, color, bg, 1);
+      return;
+    }
+    if (!_cp437 && c >= 176) {
+      c++;
+    }
+
+    // bits to set and to clear in each row of the 6x8 cell
+    bool opaque = bg != color;
+    const uint8_t *rows = glyphAtlas()[c];
+    uint16_t bytesPerRow = (WIDTH + 7) / 8;
+    uint8_t *p = getBuffer() + y * bytesPerRow + x / 8;
+    uint8_t shift = x & 7;
+    for (uint8_t row = 0; row < 8; ++row, p += bytesPerRow) {
+      uint8_t glyph = rows[row];
+      uint8_t back = opaque ? ~glyph & 0xfc : 0;
+      uint16_t set = (uint16_t)((color ? glyph : 0) | (bg ? back : 0)) << 8 >> shift;
+      uint16_t reset = (uint16_t)((color ? 0 : glyph) | (bg ? 0 : back)) << 8 >> shift;
+      p[0] = (p[0] & ~(reset >> 8)) | (set >> 8);
+      if (shift > 2) {
+        p[1] = (p[1] & ~reset) | set;
+      }
+    }
+
+    touch(x, y, opaque ? 6 : 5, 8, color || (opaque && bg) ? BLACK : WHITE);
+  }
+
+  // bounding box of the black pixels, and area modified since clearDirty()
+  Area ink;
+  Area damage;
+
+  void touch(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    Area area;
+    if (toBuffer(x, y, w, h, area)) {
+      track(area, color);
+    }
+  }
+
+  void track(Area area, uint16_t color) {
+    if (WHITE == color) {
+      // white can only change pixels that were drawn black
+      area.intersect(ink);
+    } else {
+      ink.add(area);
+    }
+    damage.add(area);
+  }
+
+  // clip a display rectangle and rotate it into buffer coordinates, false
+  // if nothing is left
+  bool toBuffer(int16_t x, int16_t y, int16_t w, int16_t h, Area &area) const {
+    if (w < 0) {
+      x += w + 1;
+      w = -w;
+    }
+    if (h < 0) {
+      y += h + 1;
+      h = -h;
+    }
+
+    // clip in display coordinates
+    int16_t x0 = x < 0 ? 0 : x;
+    int16_t y0 = y < 0 ? 0 : y;
+    int16_t x1 = x + w - 1 >= _width ? _width - 1 : x + w - 1;
+    int16_t y1 = y + h - 1 >= _height ? _height - 1 : y + h - 1;
+    if (x0 > x1 || y0 > y1) {
+      return false;
+    }
+
+    switch (getRotation()) {
+    case 1:
+      area.set(WIDTH - 1 - y1, x0, WIDTH - 1 - y0, x1);
+      break;
+    case 2:
+      area.set(WIDTH - 1 - x1, HEIGHT - 1 - y1, WIDTH - 1 - x0, HEIGHT - 1 - y0);
+      break;
+    case 3:
+      area.set(y0, HEIGHT - 1 - x1, y1, HEIGHT - 1 - x0);
+      break;
+    default:
+      area.set(x0, y0, x1, y1);
+      break;
+    }
+    return true;
+  }
+
+  static void apply(uint8_t &byte, uint8_t mask, RasterOp op) {
+    switch (op) {
+    case RESET:
+      byte &= ~mask;
+      break;
+    case SET:
+      byte |= mask;
+      break;
+    default:
+      byte ^= mask;
+      break;
+    }
+  }
+
+  // pixels x0 to x1 of a buffer row
+  static void fillSpan(uint8_t *row, int16_t x0, int16_t x1, RasterOp op) {
+    uint8_t *p = row + x0 / 8;
+    uint8_t *last = row + x1 / 8;
+    uint8_t head = 0xff >> (x0 & 7);
+    uint8_t tail = 0xff << (7 - (x1 & 7));
+    if (p == last) {
+      apply(*p, head & tail, op);
+      return;
+    }
+
+    apply(*p++, head, op);
+    // rows are not word aligned: bytes up to the first word boundary
+    while (p < last && ((uintptr_t)p & 3)) {
+      apply(*p++, 0xff, op);
+    }
+    for (; p + 4 <= last; p += 4) {
+      uint32_t &word = *(uint32_t *)p;
+      word = RESET == op ? 0 : SET == op ? 0xffffffff : ~word;
+    }
+    while (p < last) {
+      apply(*p++, 0xff, op);
+    }
+    apply(*last, tail, op);
+  }
+
+  void fillArea(const Area &area, RasterOp op) {
+    uint16_t bytesPerRow = (WIDTH + 7) / 8;
+    uint8_t *row = getBuffer() + area.y0 * bytesPerRow;
+    for (int16_t y = area.y0; y <= area.y1; ++y, row += bytesPerRow) {
+      fillSpan(row, area.x0, area.x1, op);
+    }
+  }
+
+  // count pixels (at most COPY_CHUNK) of a row to another place, without
+  // rotation, both inside the buffer
+  void copyBits(int16_t sx, int16_t sy, int16_t count, int16_t dx, int16_t dy) {
+    uint16_t bytesPerRow = (WIDTH + 7) / 8;
+    const uint8_t *source = getBuffer() + sy * bytesPerRow;
+    uint8_t *target = getBuffer() + dy * bytesPerRow;
+
+    // source bits aligned on byte 0
+    uint8_t bits[COPY_CHUNK / 8];
+    uint8_t shift = sx & 7;
+    int16_t bytes = (count + 7) / 8;
+    for (int16_t i = 0; i < bytes; ++i) {
+      int16_t index = sx / 8 + i;
+      uint8_t next = index + 1 < bytesPerRow ? source[index + 1] : 0;
+      bits[i] = shift ? (source[index] << shift) | (next >> (8 - shift)) : source[index];
+    }
+
+    // merged into the target, one or two bytes for each source byte
+    shift = dx & 7;
+    for (int16_t i = 0; i < bytes; ++i) {
+      int16_t left = count - i * 8;
+      uint8_t mask = left >= 8 ? 0xff : 0xff << (8 - left);
+      uint8_t *p = target + (dx + i * 8) / 8;
+      p[0] = (p[0] & ~(mask >> shift)) | ((bits[i] & mask) >> shift);
+      if (shift && (uint8_t)(mask << (8 - shift))) {
+        p[1] = (p[1] & ~(mask << (8 - shift))) | ((bits[i] & mask) << (8 - shift));
+      }
+    }
   }
 };
 
@@ -0,0 +1,196 @@
+//
+// Weather icons decoder
+//
+
+#include <Arduino.h>
+
+#include "Icons.h"
+
+typedef enum
+{
+	ICON_RAW, // rows padded to bytes
+	ICON_RUNS // 4-bit runs, see tools/iconpack.py
+} icon_format;
+
+typedef struct
+{
+	uint8_t width;
+	uint8_t height;
+	uint8_t format;
+	uint16_t offset; // in icon_data
+} icon_entry;
+
+#include "icon_data.h"
+
+// position in the runs of an icon
+typedef struct
+{
+	const uint8_t *data;
+	uint16_t nibble;
+	bool black;
+	bool next_black;
+	uint8_t left; // pixels left in the current run
+} run_reader;
+
+static void next_run(run_reader &runs)
+{
+	uint8_t nibble = runs.data[runs.nibble / 2];
+	nibble = runs.nibble & 1 ? nibble & 0x0f : nibble >> 4;
+	++runs.nibble;
+
+	// a full run is continued by the next one in the same color
+	runs.black = runs.next_black;
+	runs.next_black = 15 == nibble ? runs.black : !runs.black;
+	runs.left = nibble;
+}
+
+// set pixels x to x + count - 1 of a row
+static void set_bits(uint8_t *row, uint8_t x, uint8_t count)
+{
+	while (count)
+	{
+		uint8_t shift = x & 7;
+		uint8_t n = 8 - shift < count ? 8 - shift : count;
+		row[x / 8] |= (uint8_t)(0xff << (8 - n)) >> shift;
+		x += n;
+		count -= n;
+	}
+}
+
+// next row of the runs, white pixels cleared
+static void decode_row(run_reader &runs, uint8_t *row, uint8_t width)
+{
+	memset(row, 0, (width + 7) / 8);
+	for (uint8_t x = 0; x < width;)
+	{
+		while (0 == runs.left)
+		{
+			next_run(runs);
+		}
+		uint8_t n = runs.left < width - x ? runs.left : width - x;
+		if (runs.black)
+		{
+			set_bits(row, x, n);
+		}
+		x += n;
+		runs.left -= n;
+	}
+}
+
+bool icon_size(icon id, uint8_t &width, uint8_t &height)
+{
+	if (id >= ICON_COUNT)
+	{
+		return false;
+	}
+	width = icon_index[id].width;
+	height = icon_index[id].height;
+	return true;
+}
+
+void icon_draw(Frame &frame, icon id, int16_t x, int16_t y, uint16_t color)
+{
+	if (id >= ICON_COUNT)
+	{
+		return;
+	}
+	const icon_entry &entry = icon_index[id];
+	const uint8_t *data = &icon_data[entry.offset];
+	uint8_t bytes_per_row = (entry.width + 7) / 8;
+
+	if (ICON_RAW == entry.format)
+	{
+		for (uint8_t row = 0; row < entry.height; ++row, data += bytes_per_row)
+		{
+			frame.drawSpan(x, y + row, data, entry.width, color);
+		}
+		return;
+	}
+
+	uint8_t bits[(ICON_MAX_WIDTH + 7) / 8];
+	run_reader runs = {data, 0, false, false, 0};
+	for (uint8_t row = 0; row < entry.height; ++row)
+	{
+		decode_row(runs, bits, entry.width);
+		frame.drawSpan(x, y + row, bits, entry.width, color);
+	}
+}
+
+icon icon_cover(wx_cover cover)
+{
+	switch (cover)
+	{
+	case WX_FEW:
+		return ICON_FEW;
+	case WX_SCT:
+		return ICON_SCT;
+	case WX_BKN:
+		return ICON_BKN;
+	case WX_OVC:
+		return ICON_OVC;
+	case WX_VV:
+		return ICON_VV;
+	case WX_NSC:
+	case WX_NCD:
+	case WX_SKC:
+	case WX_CLR:
+		return ICON_SKC;
+	default:
+		return ICON_COUNT;
+	}
+}
+
+icon icon_wind(const wx_wind &wind)
+{
+	if (WX_VRB == wind.direction || 0 == wind.speed)
+	{
+		return ICON_COUNT;
+	}
+	// eight sectors of 45 degrees, north centered on 360
+	return (icon)(ICON_WIND_N + (wind.direction + 22) / 45 % 8);
+}
+
+// true if the group holds the two letter code
+static bool has_code(const wx_text &weather, const char *code)
+{
+	for (uint16_t i = 0; i + 1 < weather.length; ++i)
+	{
+		if (weather.text[i] == code[0] && weather.text[i + 1] == code[1])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+icon icon_weather(const wx_text &weather)
+{
+	// the most significant phenomenon first
+	static const struct
+	{
+		const char *code;
+		icon id;
+	} codes[] = {
+		{"TS", ICON_TS},
+		{"SN", ICON_SN},
+		{"SG", ICON_SN},
+		{"PL", ICON_SN},
+		{"GR", ICON_SN},
+		{"GS", ICON_SN},
+		{"SH", ICON_SH},
+		{"RA", ICON_RA},
+		{"DZ", ICON_DZ},
+		{"FG", ICON_FG},
+		{"BR", ICON_FG},
+		{"HZ", ICON_FG},
+	};
+
+	for (uint8_t i = 0; i < sizeof(codes) / sizeof(codes[0]); ++i)
+	{
+		if (has_code(weather, codes[i].code))
+		{
+			return codes[i].id;
+		}
+	}
+	return ICON_COUNT;
+}
@@ -0,0 +1,30 @@
+//
+// Weather icons and flight category badges
+//
+// The icons are packed in flash by tools/iconpack.py (see tools/icons.txt)
+// and decoded a row at a time straight into the frame, nothing is
+// allocated.
+//
+#ifndef ICONS_H_
+#define ICONS_H_
+
+#include <Arduino.h>
+#include <frame.h>
+#include <METAR.h>
+
+#include "icon_list.h"
+
+// size of an icon in pixels, false if it does not exist
+bool icon_size(icon id, uint8_t &width, uint8_t &height);
+
+// draw the black pixels of an icon in color, top left corner at (x, y);
+// white pixels are left as they are
+void icon_draw(Frame &frame, icon id, int16_t x, int16_t y, uint16_t color = BLACK);
+
+// icon of a cloud layer, of the wind (arrow pointing downwind) and of a
+// weather group, ICON_COUNT if there is none
+icon icon_cover(wx_cover cover);
+icon icon_wind(const wx_wind &wind);
+icon icon_weather(const wx_text &weather);
+
+#endif
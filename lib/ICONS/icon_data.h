@@ -0,0 +1,121 @@
+//
+// Generated by tools/iconpack.py from tools/icons.txt, do not edit
+//
+// included by Icons.cpp only
+
+static const icon_entry icon_index[ICON_COUNT] = {
+	{16, 16, ICON_RUNS, 0}, // SKC, 32 bytes raw
+	{16, 16, ICON_RUNS, 26}, // FEW, 32 bytes raw
+	{16, 16, ICON_RUNS, 52}, // SCT, 32 bytes raw
+	{16, 16, ICON_RUNS, 78}, // BKN, 32 bytes raw
+	{16, 16, ICON_RUNS, 99}, // OVC, 32 bytes raw
+	{16, 16, ICON_RAW, 115}, // VV, 32 bytes raw
+	{16, 16, ICON_RUNS, 147}, // WIND_N, 32 bytes raw
+	{16, 16, ICON_RUNS, 165}, // WIND_NE, 32 bytes raw
+	{16, 16, ICON_RUNS, 181}, // WIND_E, 32 bytes raw
+	{16, 16, ICON_RUNS, 195}, // WIND_SE, 32 bytes raw
+	{16, 16, ICON_RUNS, 211}, // WIND_S, 32 bytes raw
+	{16, 16, ICON_RUNS, 229}, // WIND_SW, 32 bytes raw
+	{16, 16, ICON_RUNS, 245}, // WIND_W, 32 bytes raw
+	{16, 16, ICON_RUNS, 259}, // WIND_NW, 32 bytes raw
+	{16, 16, ICON_RAW, 275}, // RA, 32 bytes raw
+	{16, 16, ICON_RUNS, 307}, // DZ, 32 bytes raw
+	{16, 16, ICON_RUNS, 329}, // SN, 32 bytes raw
+	{16, 16, ICON_RUNS, 353}, // FG, 32 bytes raw
+	{16, 16, ICON_RUNS, 365}, // TS, 32 bytes raw
+	{16, 16, ICON_RUNS, 380}, // SH, 32 bytes raw
+	{15, 9, ICON_RAW, 403}, // VFR, 18 bytes raw
+	{19, 9, ICON_RAW, 421}, // MVFR, 27 bytes raw
+	{15, 9, ICON_RAW, 448}, // IFR, 18 bytes raw
+	{19, 9, ICON_RAW, 466}, // LIFR, 27 bytes raw
+};
+
+// 493 bytes
+static const uint8_t icon_data[] = {
+	// SKC
+	0xf8, 0x2b, 0x87, 0x26, 0x25, 0x28, 0x24, 0x1a, 0x14, 0x1a, 0x13, 0x2a, 0x22, 0x2a, 0x23, 0x1a,
+	0x14, 0x1a, 0x14, 0x28, 0x25, 0x26, 0x27, 0x8b, 0x2f, 0x80,
+
+	// FEW
+	0xf8, 0x2b, 0x87, 0x23, 0x55, 0x24, 0x64, 0x15, 0x64, 0x15, 0x63, 0x25, 0x72, 0x2a, 0x23, 0x1a,
+	0x14, 0x1a, 0x14, 0x28, 0x25, 0x26, 0x27, 0x8b, 0x2f, 0x80,
+
+	// SCT
+	0xf8, 0x2b, 0x87, 0x23, 0x55, 0x24, 0x64, 0x15, 0x64, 0x15, 0x63, 0x25, 0x72, 0x25, 0x73, 0x15,
+	0x64, 0x15, 0x64, 0x24, 0x65, 0x23, 0x57, 0x8b, 0x2f, 0x80,
+
+	// BKN
+	0xf8, 0x2b, 0x87, 0x23, 0x55, 0x24, 0x64, 0x15, 0x64, 0x15, 0x63, 0x25, 0x72, 0xe3, 0xc4, 0xc4,
+	0xc5, 0xa7, 0x8b, 0x2f, 0x80,
+
+	// OVC
+	0xf8, 0x2b, 0x87, 0xa5, 0xc4, 0xc4, 0xc3, 0xe2, 0xe3, 0xc4, 0xc4, 0xc5, 0xa7, 0x8b, 0x2f, 0x80,
+
+	// VV
+	0x00, 0x00, 0x01, 0x80, 0x0f, 0xf0, 0x18, 0x18, 0x38, 0x1c, 0x24, 0x24, 0x22, 0x44, 0x61, 0x86,
+	0x61, 0x86, 0x22, 0x44, 0x24, 0x24, 0x38, 0x1c, 0x18, 0x18, 0x0f, 0xf0, 0x01, 0x80, 0x00, 0x00,
+
+	// WIND_N
+	0xf8, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2b, 0x21, 0x21, 0x29, 0x6b, 0x4c, 0x4d,
+	0x2f, 0x80,
+
+	// WIND_NE
+	0xff, 0xfe, 0x2d, 0x3c, 0x3c, 0x38, 0x22, 0x39, 0x21, 0x3a, 0x5b, 0x4c, 0x6a, 0x6f, 0xff, 0xa0,
+
+	// WIND_E
+	0xff, 0xff, 0x91, 0xe2, 0xc3, 0xce, 0x2e, 0x33, 0xf0, 0x2f, 0x01, 0xff, 0xff, 0xe0,
+
+	// WIND_SE
+	0xff, 0xf6, 0x6a, 0x6a, 0x4c, 0x5b, 0x21, 0x3a, 0x22, 0x3e, 0x3e, 0x3e, 0x3e, 0x2f, 0xff, 0x60,
+
+	// WIND_S
+	0xf8, 0x2d, 0x4c, 0x4b, 0x69, 0x21, 0x21, 0x2b, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e,
+	0x2f, 0x80,
+
+	// WIND_SW
+	0xff, 0xfa, 0x6a, 0x6c, 0x4b, 0x5a, 0x31, 0x29, 0x32, 0x28, 0x3c, 0x3c, 0x3d, 0x2f, 0xff, 0xe0,
+
+	// WIND_W
+	0xff, 0xff, 0xe1, 0xf0, 0x2f, 0x03, 0x3e, 0x2e, 0xc3, 0xc2, 0xe1, 0xff, 0xff, 0x90,
+
+	// WIND_NW
+	0xff, 0xf6, 0x2e, 0x3e, 0x3e, 0x3e, 0x32, 0x2a, 0x31, 0x2b, 0x5c, 0x4a, 0x6a, 0x6f, 0xff, 0x60,
+
+	// RA
+	0x00, 0x00, 0x00, 0x00, 0x04, 0x10, 0x0c, 0x30, 0x0c, 0x30, 0x18, 0x60, 0x18, 0x60, 0x10, 0x40,
+	0x00, 0x80, 0x11, 0x84, 0x31, 0x8c, 0x33, 0x0c, 0x63, 0x18, 0x62, 0x18, 0x40, 0x10, 0x00, 0x00,
+
+	// DZ
+	0xff, 0x42, 0x32, 0x32, 0x42, 0x32, 0x32, 0xff, 0xf9, 0x24, 0x28, 0x24, 0x2f, 0xff, 0x92, 0x32,
+	0x32, 0x42, 0x32, 0x32, 0xff, 0x40,
+
+	// SN
+	0xf8, 0x2e, 0x2e, 0x29, 0x14, 0x24, 0x14, 0x32, 0x22, 0x36, 0x8a, 0x4c, 0x4a, 0x86, 0x32, 0x22,
+	0x34, 0x14, 0x24, 0x19, 0x2e, 0x2e, 0x2f, 0x80,
+
+	// FG
+	0xff, 0xf4, 0xb5, 0xbf, 0xfa, 0xb5, 0xbf, 0xf4, 0xe2, 0xef, 0xff, 0x40,
+
+	// TS
+	0xa1, 0xe1, 0xe2, 0xd2, 0xd3, 0xd2, 0xd8, 0x78, 0x78, 0xd2, 0xd2, 0xe1, 0xe1, 0xff, 0xfc,
+
+	// SH
+	0xfa, 0x38, 0xa5, 0xb4, 0xc4, 0xc4, 0xc4, 0xc4, 0xcf, 0xf8, 0x13, 0x13, 0x16, 0x22, 0x22, 0x26,
+	0x22, 0x22, 0x26, 0x13, 0x13, 0x1f, 0x50,
+
+	// VFR
+	0x7f, 0xfc, 0xff, 0xfe, 0xd4, 0x4e, 0xd5, 0xd6, 0xd4, 0xce, 0xd5, 0xd6, 0xed, 0xd6, 0xff, 0xfe,
+	0x7f, 0xfc,
+
+	// MVFR
+	0x7f, 0xff, 0xc0, 0xff, 0xff, 0xe0, 0xd5, 0x44, 0xe0, 0xc5, 0x5d, 0x60, 0xc5, 0x4c, 0xe0, 0xd5,
+	0x5d, 0x60, 0xd6, 0xdd, 0x60, 0xff, 0xff, 0xe0, 0x7f, 0xff, 0xc0,
+
+	// IFR
+	0x7f, 0xfc, 0xff, 0xfe, 0xc4, 0x4e, 0xed, 0xd6, 0xec, 0xce, 0xed, 0xd6, 0xc5, 0xd6, 0xff, 0xfe,
+	0x7f, 0xfc,
+
+	// LIFR
+	0x7f, 0xff, 0xc0, 0xff, 0xff, 0xe0, 0xdc, 0x44, 0xe0, 0xde, 0xdd, 0x60, 0xde, 0xcc, 0xe0, 0xde,
+	0xdd, 0x60, 0xc4, 0x5d, 0x60, 0xff, 0xff, 0xe0, 0x7f, 0xff, 0xc0,
+};
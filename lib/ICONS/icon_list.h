@@ -0,0 +1,38 @@
+//
+// Generated by tools/iconpack.py from tools/icons.txt, do not edit
+//
+#ifndef ICON_LIST_H_
+#define ICON_LIST_H_
+
+typedef enum
+{
+	ICON_SKC,
+	ICON_FEW,
+	ICON_SCT,
+	ICON_BKN,
+	ICON_OVC,
+	ICON_VV,
+	ICON_WIND_N,
+	ICON_WIND_NE,
+	ICON_WIND_E,
+	ICON_WIND_SE,
+	ICON_WIND_S,
+	ICON_WIND_SW,
+	ICON_WIND_W,
+	ICON_WIND_NW,
+	ICON_RA,
+	ICON_DZ,
+	ICON_SN,
+	ICON_FG,
+	ICON_TS,
+	ICON_SH,
+	ICON_VFR,
+	ICON_MVFR,
+	ICON_IFR,
+	ICON_LIFR,
+	ICON_COUNT
+} icon;
+
+#define ICON_MAX_WIDTH 19
+
+#endif
@@ -31,11 +31,31 @@
 
 #define LM75A_I2C_ADDR 0x49 
 #define LM75A_CMD_TEMP 0x00
+#define LM75A_CMD_CONF 0x01
+
+#define LM75A_CONF_SHUTDOWN 0x01
+
+// temperature conversion time (ms)
+#define LM75A_CONVERSION 100
+
+// filter weight of a new sample (1/n)
+#define LM75A_FILTER 4
+
+// the filter goes on across deep sleep, a wake-up adds one sample to it;
+// kept LM75A_FILTER times larger so that small steps are not lost
+#define LM75A_NO_FILTER INT32_MIN
+RTC_DATA_ATTR static int32_t filtered = LM75A_NO_FILTER;
 
 
 LM75A_Class::LM75A_Class()
 {
   Wire.begin();
+
+  converting = false;
+  sampled = false;
+  interval = 0;
+  started = 0;
+  last = 0;
 }
 
 int LM75A_Class::read()
@@ -55,4 +75,114 @@ int LM75A_Class::read()
   return (t >> 8);
 }
 
+void LM75A_Class::begin(uint32_t interval)
+{
+  this->interval = interval;
+
+  // first conversion starts now
+  shutdown(false);
+  converting = true;
+  started = millis();
+}
+
+void LM75A_Class::update()
+{
+  uint32_t now = millis();
+
+  if (converting) {
+    if (now - started < LM75A_CONVERSION) {
+      return;
+    }
+
+    int16_t t;
+    if (readRaw(t)) {
+      if (LM75A_NO_FILTER == filtered) {
+        filtered = (int32_t)t * LM75A_FILTER;
+      } else {
+        filtered += t - filtered / LM75A_FILTER;
+      }
+      sampled = true;
+      last = now;
+    }
+    converting = false;
+    shutdown(true);
+  }
+  else if (!sampled || now - last >= interval) {
+    shutdown(false);
+    converting = true;
+    started = now;
+  }
+}
+
+void LM75A_Class::wait()
+{
+  while (!sampled) {
+    if (!converting) {
+      update();
+    }
+    uint32_t elapsed = millis() - started;
+    if (elapsed < LM75A_CONVERSION) {
+      delay(LM75A_CONVERSION - elapsed);
+    }
+    update();
+
+    // sensor not answering
+    if (!sampled && !converting) {
+      return;
+    }
+  }
+}
+
+void LM75A_Class::end()
+{
+  wait();
+  if (converting) {
+    uint32_t elapsed = millis() - started;
+    if (elapsed < LM75A_CONVERSION) {
+      delay(LM75A_CONVERSION - elapsed);
+    }
+    update();
+  }
 
+  // also when the sensor did not answer the last read
+  converting = false;
+  shutdown(true);
+}
+
+int16_t LM75A_Class::temperature()
+{
+  return LM75A_NO_FILTER == filtered ? LM75A_NO_SAMPLE : filtered / LM75A_FILTER;
+}
+
+uint32_t LM75A_Class::age()
+{
+  return sampled ? millis() - last : UINT32_MAX;
+}
+
+void LM75A_Class::shutdown(bool off)
+{
+  Wire.beginTransmission(LM75A_I2C_ADDR);
+  Wire.write(LM75A_CMD_CONF);
+  Wire.write(off ? LM75A_CONF_SHUTDOWN : 0x00);
+  Wire.endTransmission();
+}
+
+bool LM75A_Class::readRaw(int16_t &tenths)
+{
+  Wire.beginTransmission(LM75A_I2C_ADDR);
+  Wire.write(LM75A_CMD_TEMP);
+  if (0 != Wire.endTransmission()) {
+    return false;
+  }
+
+  Wire.requestFrom(LM75A_I2C_ADDR, 2);
+  if (Wire.available() != 2) {
+    return false;
+  }
+
+  // 11 bits two's complement, 0.125 degree steps
+  int16_t t = (Wire.read() << 8);
+  t |= Wire.read();
+  tenths = (int32_t)(t >> 5) * 10 / 8;
+  return true;
+}
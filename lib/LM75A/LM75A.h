@@ -21,14 +21,46 @@
 
 #include <Arduino.h>
 
+#define LM75A_NO_SAMPLE INT16_MIN
+
 class LM75A_Class {
 public:
 
   LM75A_Class();
+
+  // blocking read, in degrees celsius
   int read();
 
+  // non blocking sampling: the sensor is shut down between samples, woken
+  // every interval (ms) and read by update() once its conversion is done
+  void begin(uint32_t interval = 60000);
+  void update();
+
+  // block until the first sample is available (one conversion at most)
+  void wait();
+
+  // before deep sleep: take the sample of this wake-up if there is none
+  // yet, finish a running conversion and leave the sensor shut down
+  void end();
+
+  // filtered temperature in tenths of degree, kept in RTC memory across
+  // deep sleep, LM75A_NO_SAMPLE if the sensor never answered
+  int16_t temperature();
+
+  // ms since the last sample
+  uint32_t age();
+
 private:
 
+  bool converting;
+  bool sampled;
+  uint32_t interval;
+  uint32_t started;
+  uint32_t last;
+
+  void shutdown(bool off);
+  bool readRaw(int16_t &tenths);
+
 };
 
 
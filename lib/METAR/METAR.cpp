@@ -0,0 +1,967 @@
+//
+// METAR / TAF decoder
+//
+// Tokens are read one by one from the report and matched against each
+// group format, unknown groups (recent weather, wind shear, runway state,
+// remarks...) are skipped.
+//
+
+#include <Arduino.h>
+
+#include "METAR.h"
+
+// statute mile / kilometer / feet to meter
+#define SM_TO_M 1609
+#define FT_TO_M(ft) ((uint32_t)(ft) * 3048 / 10000)
+
+// weather descriptors and phenomena, two letters each
+static const char weather_codes[] = "MIBCPRDRBLSHTSFZ"
+									"DZRASNSGICPLGRGSUP"
+									"BRFGFUVADUSAHZPY"
+									"POSQFCSSDS";
+
+typedef struct
+{
+	const char *p;
+	const char *end;
+} tokenizer;
+
+static bool is_digit(char c)
+{
+	return '0' <= c && c <= '9';
+}
+
+static bool is_upper(char c)
+{
+	return 'A' <= c && c <= 'Z';
+}
+
+static bool is_space(char c)
+{
+	return ' ' == c || '\n' == c || '\r' == c || '\t' == c;
+}
+
+// read n digits, false if any is not a digit
+static bool read_number(const char *s, uint8_t n, uint16_t &value)
+{
+	value = 0;
+	for (uint8_t i = 0; i < n; ++i)
+	{
+		if (!is_digit(s[i]))
+		{
+			return false;
+		}
+		value = value * 10 + (s[i] - '0');
+	}
+	return true;
+}
+
+static uint8_t count_digits(const char *s, const char *end)
+{
+	uint8_t n = 0;
+	while (s + n < end && is_digit(s[n]))
+	{
+		++n;
+	}
+	return n;
+}
+
+static bool next_token(tokenizer &t, wx_text &token)
+{
+	while (t.p < t.end && is_space(*t.p))
+	{
+		++t.p;
+	}
+
+	// '=' ends the report
+	if (t.p >= t.end || '=' == *t.p)
+	{
+		t.p = t.end;
+		return false;
+	}
+
+	token.text = t.p;
+	while (t.p < t.end && !is_space(*t.p) && '=' != *t.p)
+	{
+		++t.p;
+	}
+	token.length = t.p - token.text;
+	return true;
+}
+
+static bool peek_token(tokenizer t, wx_text &token)
+{
+	return next_token(t, token);
+}
+
+static bool starts_with(const wx_text &token, const char *prefix)
+{
+	uint16_t n = strlen(prefix);
+	return token.length >= n && 0 == strncmp(token.text, prefix, n);
+}
+
+static bool ends_with(const wx_text &token, const char *suffix)
+{
+	uint16_t n = strlen(suffix);
+	return token.length >= n && 0 == strncmp(token.text + token.length - n, suffix, n);
+}
+
+// grow a group text up to the end of token
+static void extend(wx_text &text, const wx_text &token)
+{
+	if (0 == text.text)
+	{
+		text.text = token.text;
+	}
+	text.length = token.text + token.length - text.text;
+}
+
+static void init_conditions(wx_conditions &conditions)
+{
+	memset(&conditions, 0, sizeof(conditions));
+	conditions.visibility = WX_UNKNOWN;
+}
+
+static void init_group(wx_group &group, wx_change change)
+{
+	memset(&group, 0, sizeof(group));
+	group.change = change;
+	init_conditions(group.conditions);
+}
+
+static bool is_station(const wx_text &token)
+{
+	if (4 != token.length || !is_upper(token.text[0]))
+	{
+		return false;
+	}
+	for (uint8_t i = 1; i < 4; ++i)
+	{
+		if (!is_upper(token.text[i]) && !is_digit(token.text[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// DDHHMMZ
+static bool parse_time(const wx_text &token, wx_time &time)
+{
+	uint16_t day, hour, minute;
+	if (7 != token.length || 'Z' != token.text[6] ||
+		!read_number(token.text, 2, day) ||
+		!read_number(token.text + 2, 2, hour) ||
+		!read_number(token.text + 4, 2, minute))
+	{
+		return false;
+	}
+	time.day = day;
+	time.hour = hour;
+	time.minute = minute;
+	return true;
+}
+
+// DDHH/DDHH
+static bool parse_period(const wx_text &token, wx_time &from, wx_time &to)
+{
+	uint16_t from_day, from_hour, to_day, to_hour;
+	if (9 != token.length || '/' != token.text[4] ||
+		!read_number(token.text, 2, from_day) ||
+		!read_number(token.text + 2, 2, from_hour) ||
+		!read_number(token.text + 5, 2, to_day) ||
+		!read_number(token.text + 7, 2, to_hour))
+	{
+		return false;
+	}
+	from.day = from_day;
+	from.hour = from_hour;
+	from.minute = 0;
+	to.day = to_day;
+	to.hour = to_hour;
+	to.minute = 0;
+	return true;
+}
+
+// dddff[Gfff]KT, VRBff, MPS and KMH converted to knots
+static bool parse_wind(const wx_text &token, wx_wind &wind)
+{
+	const char *s = token.text;
+	const char *end = token.text + token.length;
+	uint16_t direction, speed, gust = 0;
+	uint8_t n;
+
+	if (token.length < 7)
+	{
+		return false;
+	}
+
+	if (0 == strncmp(s, "VRB", 3))
+	{
+		direction = (uint16_t)WX_VRB;
+	}
+	else if (!read_number(s, 3, direction) || direction > 360)
+	{
+		return false;
+	}
+	s += 3;
+
+	n = count_digits(s, end);
+	if (n < 2 || n > 3)
+	{
+		return false;
+	}
+	read_number(s, n, speed);
+	s += n;
+
+	if (s < end && 'G' == *s)
+	{
+		++s;
+		n = count_digits(s, end);
+		if (n < 2 || n > 3)
+		{
+			return false;
+		}
+		read_number(s, n, gust);
+		s += n;
+	}
+
+	if (2 == end - s && 0 == strncmp(s, "KT", 2))
+	{
+	}
+	else if (3 == end - s && 0 == strncmp(s, "MPS", 3))
+	{
+		speed = speed * 194 / 100;
+		gust = gust * 194 / 100;
+	}
+	else if (3 == end - s && 0 == strncmp(s, "KMH", 3))
+	{
+		speed = speed * 100 / 185;
+		gust = gust * 100 / 185;
+	}
+	else
+	{
+		return false;
+	}
+
+	wind.direction = (int16_t)direction;
+	wind.speed = speed > 255 ? 255 : speed;
+	wind.gust = gust > 255 ? 255 : gust;
+	wind.from = -1;
+	wind.to = -1;
+	return true;
+}
+
+// dddVddd
+static bool parse_wind_variation(const wx_text &token, wx_wind &wind)
+{
+	uint16_t from, to;
+	if (7 != token.length || 'V' != token.text[3] ||
+		!read_number(token.text, 3, from) ||
+		!read_number(token.text + 4, 3, to))
+	{
+		return false;
+	}
+	wind.from = from;
+	wind.to = to;
+	return true;
+}
+
+// [P|M]n, [P|M]n/d without the SM suffix, in meters
+static bool parse_statute_miles(const char *s, const char *end, uint16_t &meters)
+{
+	uint16_t whole, numerator, denominator;
+	uint8_t n;
+	bool more = false;
+
+	if (s < end && ('P' == *s || 'M' == *s))
+	{
+		more = 'P' == *s++;
+	}
+
+	n = count_digits(s, end);
+	if (0 == n || n > 2)
+	{
+		return false;
+	}
+	read_number(s, n, whole);
+	s += n;
+
+	// P6SM, more than reported in the US: 10 km or more
+	if (s == end)
+	{
+		meters = more || whole * SM_TO_M > 9999 ? 9999 : whole * SM_TO_M;
+		return true;
+	}
+
+	numerator = whole;
+	if ('/' != *s++)
+	{
+		return false;
+	}
+	n = count_digits(s, end);
+	if (0 == n || n > 2 || s + n != end)
+	{
+		return false;
+	}
+	read_number(s, n, denominator);
+	if (0 == denominator)
+	{
+		return false;
+	}
+	meters = (uint32_t)numerator * SM_TO_M / denominator;
+	return true;
+}
+
+// dddd[direction], CAVOK, statute miles (possibly split as "1 1/2SM")
+static bool parse_visibility(tokenizer &t, const wx_text &token, wx_conditions &conditions)
+{
+	uint16_t meters;
+
+	if (wx_equals(token, "CAVOK"))
+	{
+		conditions.cavok = true;
+		conditions.visibility = 9999;
+		return true;
+	}
+
+	if (ends_with(token, "SM"))
+	{
+		if (!parse_statute_miles(token.text, token.text + token.length - 2, meters))
+		{
+			return false;
+		}
+		conditions.visibility = meters;
+		return true;
+	}
+
+	if (token.length <= 2 && count_digits(token.text, token.text + token.length) == token.length)
+	{
+		// whole miles followed by a fraction
+		wx_text fraction;
+		uint16_t whole, part;
+		if (!peek_token(t, fraction) || !ends_with(fraction, "SM") ||
+			!parse_statute_miles(fraction.text, fraction.text + fraction.length - 2, part))
+		{
+			return false;
+		}
+		read_number(token.text, token.length, whole);
+		next_token(t, fraction);
+		conditions.visibility = whole * SM_TO_M + part > 9999 ? 9999 : whole * SM_TO_M + part;
+		return true;
+	}
+
+	if (token.length >= 4 && read_number(token.text, 4, meters))
+	{
+		for (uint16_t i = 4; i < token.length; ++i)
+		{
+			if (!is_upper(token.text[i]))
+			{
+				return false;
+			}
+		}
+		// the minimum visibility follows the prevailing one
+		if (WX_UNKNOWN == conditions.visibility)
+		{
+			conditions.visibility = meters;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+// [-|+|VC] followed by descriptor / phenomenon pairs
+static bool parse_weather(const wx_text &token, wx_conditions &conditions)
+{
+	const char *s = token.text;
+	const char *end = token.text + token.length;
+
+	if (s < end && ('-' == *s || '+' == *s))
+	{
+		++s;
+	}
+	else if (starts_with(token, "VC"))
+	{
+		s += 2;
+	}
+
+	if (s == end || 0 != (end - s) % 2)
+	{
+		return false;
+	}
+
+	for (; s < end; s += 2)
+	{
+		const char *code = weather_codes;
+		while (*code && (code[0] != s[0] || code[1] != s[1]))
+		{
+			code += 2;
+		}
+		if (!*code)
+		{
+			return false;
+		}
+	}
+
+	if (conditions.weather_count < WX_MAX_WEATHER)
+	{
+		conditions.weather[conditions.weather_count++] = token;
+	}
+	return true;
+}
+
+// FEWhhh[CB|TCU], VVhhh, NSC, NCD, SKC, CLR
+static bool parse_cloud(const wx_text &token, wx_conditions &conditions)
+{
+	static const char *covers[] = {"FEW", "SCT", "BKN", "OVC"};
+	wx_cloud cloud;
+	uint16_t base;
+	uint8_t n;
+
+	cloud.type = WX_CLOUD;
+	cloud.base = WX_UNKNOWN;
+
+	if (wx_equals(token, "NSC"))
+	{
+		cloud.cover = WX_NSC;
+	}
+	else if (wx_equals(token, "NCD"))
+	{
+		cloud.cover = WX_NCD;
+	}
+	else if (wx_equals(token, "SKC"))
+	{
+		cloud.cover = WX_SKC;
+	}
+	else if (wx_equals(token, "CLR"))
+	{
+		cloud.cover = WX_CLR;
+	}
+	else
+	{
+		cloud.cover = WX_NONE;
+		n = 0;
+		for (uint8_t i = 0; i < 4; ++i)
+		{
+			if (starts_with(token, covers[i]))
+			{
+				cloud.cover = (wx_cover)(WX_FEW + i);
+				n = 3;
+			}
+		}
+		if (WX_NONE == cloud.cover && starts_with(token, "VV"))
+		{
+			cloud.cover = WX_VV;
+			n = 2;
+		}
+		if (WX_NONE == cloud.cover || token.length < n + 3)
+		{
+			return false;
+		}
+
+		if (read_number(token.text + n, 3, base))
+		{
+			cloud.base = base * 100;
+		}
+		else if (0 != strncmp(token.text + n, "///", 3))
+		{
+			return false;
+		}
+		n += 3;
+
+		if (token.length == n || (token.length == n + 3 && 0 == strncmp(token.text + n, "///", 3)))
+		{
+		}
+		else if (token.length == n + 2 && 0 == strncmp(token.text + n, "CB", 2))
+		{
+			cloud.type = WX_CB;
+		}
+		else if (token.length == n + 3 && 0 == strncmp(token.text + n, "TCU", 3))
+		{
+			cloud.type = WX_TCU;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	if (conditions.cloud_count < WX_MAX_CLOUDS)
+	{
+		conditions.clouds[conditions.cloud_count++] = cloud;
+	}
+	return true;
+}
+
+// wind, visibility, weather and clouds, common to all report parts
+static bool parse_conditions(tokenizer &t, const wx_text &token, wx_conditions &conditions)
+{
+	if (parse_wind(token, conditions.wind))
+	{
+		conditions.has_wind = true;
+		return true;
+	}
+	if (conditions.has_wind && parse_wind_variation(token, conditions.wind))
+	{
+		return true;
+	}
+	if (wx_equals(token, "NSW"))
+	{
+		conditions.nsw = true;
+		return true;
+	}
+	return parse_visibility(t, token, conditions) ||
+		   parse_weather(token, conditions) ||
+		   parse_cloud(token, conditions);
+}
+
+// Rdd[LCR]/[P|M]dddd[V[P|M]dddd][FT][/][U|D|N]
+static bool parse_rvr(const wx_text &token, wx_rvr &rvr)
+{
+	const char *s = token.text;
+	const char *end = token.text + token.length;
+	uint16_t value;
+	bool feet;
+
+	if (token.length < 8 || 'R' != s[0] || !is_digit(s[1]) || !is_digit(s[2]))
+	{
+		return false;
+	}
+	s += 3;
+	if ('L' == *s || 'C' == *s || 'R' == *s)
+	{
+		++s;
+	}
+	if ('/' != *s)
+	{
+		return false;
+	}
+	rvr.runway.text = token.text + 1;
+	rvr.runway.length = s - rvr.runway.text;
+	++s;
+
+	rvr.modifier = 0;
+	if (s < end && ('P' == *s || 'M' == *s))
+	{
+		rvr.modifier = *s++;
+	}
+	if (end - s < 4 || !read_number(s, 4, value))
+	{
+		return false;
+	}
+	rvr.min = rvr.max = value;
+	s += 4;
+
+	if (s < end && 'V' == *s)
+	{
+		++s;
+		if (s < end && ('P' == *s || 'M' == *s))
+		{
+			++s;
+		}
+		if (end - s < 4 || !read_number(s, 4, value))
+		{
+			return false;
+		}
+		rvr.max = value;
+		s += 4;
+	}
+
+	feet = end - s >= 2 && 0 == strncmp(s, "FT", 2);
+	if (feet)
+	{
+		rvr.min = FT_TO_M(rvr.min);
+		rvr.max = FT_TO_M(rvr.max);
+		s += 2;
+	}
+
+	if (s < end && '/' == *s)
+	{
+		++s;
+	}
+	rvr.trend = 0;
+	if (s < end && ('U' == *s || 'D' == *s || 'N' == *s))
+	{
+		rvr.trend = *s++;
+	}
+	return s == end;
+}
+
+// [M]dd
+static bool parse_celsius(const char *&s, const char *end, int8_t &value)
+{
+	bool minus = false;
+	uint16_t number;
+
+	if (s < end && 'M' == *s)
+	{
+		minus = true;
+		++s;
+	}
+	if (end - s < 2 || !read_number(s, 2, number))
+	{
+		return false;
+	}
+	s += 2;
+	value = minus ? -(int8_t)number : (int8_t)number;
+	return true;
+}
+
+// [M]dd/[M]dd, dew point may be missing
+static bool parse_temperature(const wx_text &token, int8_t &temperature, int8_t &dew_point)
+{
+	const char *s = token.text;
+	const char *end = token.text + token.length;
+	int8_t t, d = WX_NO_TEMP;
+
+	if (!parse_celsius(s, end, t) || s == end || '/' != *s++)
+	{
+		return false;
+	}
+	if (s < end && !parse_celsius(s, end, d))
+	{
+		// "//" or "XX" for a missing dew point
+		d = WX_NO_TEMP;
+		s = end;
+	}
+	if (s != end)
+	{
+		return false;
+	}
+	temperature = t;
+	dew_point = d;
+	return true;
+}
+
+// Qdddd (hPa), Adddd (hundredths of inHg)
+static bool parse_qnh(const wx_text &token, uint16_t &qnh)
+{
+	uint16_t value;
+	if (5 != token.length || !read_number(token.text + 1, 4, value))
+	{
+		return false;
+	}
+	if ('Q' == token.text[0])
+	{
+		qnh = value;
+		return true;
+	}
+	if ('A' == token.text[0])
+	{
+		qnh = ((uint32_t)value * 338639 + 500000) / 1000000;
+		return true;
+	}
+	return false;
+}
+
+// TXdd/DDHHZ, TNdd/DDHHZ
+static bool parse_extreme(const wx_text &token, int8_t &temperature, wx_time &time)
+{
+	const char *s = token.text + 2;
+	const char *end = token.text + token.length;
+	uint16_t day, hour;
+
+	if (!parse_celsius(s, end, temperature) || 6 != end - s || '/' != s[0] || 'Z' != s[5] ||
+		!read_number(s + 1, 2, day) || !read_number(s + 3, 2, hour))
+	{
+		return false;
+	}
+	time.day = day;
+	time.hour = hour;
+	time.minute = 0;
+	return true;
+}
+
+// FMDDHHMM
+static bool parse_from(const wx_text &token, wx_time &time)
+{
+	uint16_t day, hour, minute;
+	if (8 != token.length || !starts_with(token, "FM") ||
+		!read_number(token.text + 2, 2, day) ||
+		!read_number(token.text + 4, 2, hour) ||
+		!read_number(token.text + 6, 2, minute))
+	{
+		return false;
+	}
+	time.day = day;
+	time.hour = hour;
+	time.minute = minute;
+	return true;
+}
+
+// FMHHMM, TLHHMM, ATHHMM in trends
+static bool parse_trend_time(const wx_text &token, wx_group &group)
+{
+	uint16_t hour, minute;
+	if (6 != token.length || !read_number(token.text + 2, 2, hour) || !read_number(token.text + 4, 2, minute))
+	{
+		return false;
+	}
+	if (starts_with(token, "FM") || starts_with(token, "AT"))
+	{
+		group.from.hour = hour;
+		group.from.minute = minute;
+		return true;
+	}
+	if (starts_with(token, "TL"))
+	{
+		group.to.hour = hour;
+		group.to.minute = minute;
+		return true;
+	}
+	return false;
+}
+
+static void set_remarks(const wx_text &token, const char *end, wx_text &remarks)
+{
+	while (end > token.text && (is_space(end[-1]) || '=' == end[-1]))
+	{
+		--end;
+	}
+	remarks.text = token.text;
+	remarks.length = end - token.text;
+}
+
+bool wx_equals(const wx_text &text, const char *string)
+{
+	uint16_t n = strlen(string);
+	return text.length == n && 0 == strncmp(text.text, string, n);
+}
+
+bool metar_decode(const char *text, uint16_t length, metar &report)
+{
+	tokenizer t = {text, text + length};
+	wx_group scratch;
+	wx_group *trend = 0;
+	wx_text token;
+
+	memset(&report, 0, sizeof(report));
+	init_conditions(report.conditions);
+	report.temperature = WX_NO_TEMP;
+	report.dew_point = WX_NO_TEMP;
+
+	// header
+	if (!next_token(t, token))
+	{
+		return false;
+	}
+	if (wx_equals(token, "METAR") || wx_equals(token, "SPECI"))
+	{
+		report.speci = 'S' == token.text[0];
+		if (!next_token(t, token))
+		{
+			return false;
+		}
+	}
+	if (wx_equals(token, "COR") && !next_token(t, token))
+	{
+		return false;
+	}
+	if (!is_station(token))
+	{
+		return false;
+	}
+	report.station = token;
+	if (!next_token(t, token) || !parse_time(token, report.time))
+	{
+		return false;
+	}
+
+	while (next_token(t, token))
+	{
+		if (wx_equals(token, "RMK"))
+		{
+			set_remarks(token, t.end, report.remarks);
+			break;
+		}
+
+		// trends
+		wx_change change = WX_BASE;
+		if (wx_equals(token, "NOSIG"))
+		{
+			change = WX_NOSIG;
+		}
+		else if (wx_equals(token, "BECMG"))
+		{
+			change = WX_BECMG;
+		}
+		else if (wx_equals(token, "TEMPO"))
+		{
+			change = WX_TEMPO;
+		}
+		if (WX_BASE != change)
+		{
+			trend = report.trend_count < WX_MAX_TRENDS ? &report.trends[report.trend_count++] : &scratch;
+			init_group(*trend, change);
+			extend(trend->text, token);
+			continue;
+		}
+		if (trend)
+		{
+			if (parse_trend_time(token, *trend) || parse_conditions(t, token, trend->conditions))
+			{
+				extend(trend->text, token);
+			}
+			continue;
+		}
+
+		// observation
+		if (wx_equals(token, "AUTO"))
+		{
+			report.auto_report = true;
+		}
+		else if (wx_equals(token, "NIL"))
+		{
+			report.nil = true;
+		}
+		else if (parse_conditions(t, token, report.conditions))
+		{
+		}
+		else if (report.rvr_count < WX_MAX_RVR && parse_rvr(token, report.rvr[report.rvr_count]))
+		{
+			++report.rvr_count;
+		}
+		else if (parse_temperature(token, report.temperature, report.dew_point))
+		{
+		}
+		else
+		{
+			parse_qnh(token, report.qnh);
+		}
+	}
+
+	return true;
+}
+
+bool taf_decode(const char *text, uint16_t length, taf &report)
+{
+	tokenizer t = {text, text + length};
+	wx_group scratch;
+	wx_group *group;
+	wx_text token;
+
+	memset(&report, 0, sizeof(report));
+	report.max_temperature = WX_NO_TEMP;
+	report.min_temperature = WX_NO_TEMP;
+
+	// header
+	if (!next_token(t, token))
+	{
+		return false;
+	}
+	if (wx_equals(token, "TAF") && !next_token(t, token))
+	{
+		return false;
+	}
+	while (wx_equals(token, "AMD") || wx_equals(token, "COR"))
+	{
+		report.amended = true;
+		if (!next_token(t, token))
+		{
+			return false;
+		}
+	}
+	if (!is_station(token))
+	{
+		return false;
+	}
+	report.station = token;
+	if (!next_token(t, token))
+	{
+		return false;
+	}
+	if (parse_time(token, report.time) && !next_token(t, token))
+	{
+		return false;
+	}
+	if (wx_equals(token, "NIL"))
+	{
+		report.nil = true;
+		return true;
+	}
+	if (!parse_period(token, report.from, report.to))
+	{
+		return false;
+	}
+
+	// base forecast
+	group = &report.groups[report.group_count++];
+	init_group(*group, WX_BASE);
+	group->from = report.from;
+	group->to = report.to;
+
+	while (next_token(t, token))
+	{
+		if (wx_equals(token, "RMK"))
+		{
+			break;
+		}
+
+		// change groups
+		wx_time from;
+		wx_change change = WX_BASE;
+		uint8_t probability = 0;
+		if (parse_from(token, from))
+		{
+			change = WX_FM;
+		}
+		else if (wx_equals(token, "BECMG"))
+		{
+			change = WX_BECMG;
+		}
+		else if (wx_equals(token, "TEMPO"))
+		{
+			change = WX_TEMPO;
+		}
+		else if (wx_equals(token, "PROB30") || wx_equals(token, "PROB40"))
+		{
+			change = WX_PROB;
+			probability = '3' == token.text[4] ? 30 : 40;
+		}
+
+		if (WX_BASE != change)
+		{
+			group = report.group_count < WX_MAX_GROUPS ? &report.groups[report.group_count++] : &scratch;
+			init_group(*group, change);
+			group->probability = probability;
+			extend(group->text, token);
+
+			if (WX_FM == change)
+			{
+				group->from = from;
+				group->to = report.to;
+				continue;
+			}
+
+			wx_text next;
+			if (WX_PROB == change && peek_token(t, next) && wx_equals(next, "TEMPO"))
+			{
+				group->temporary = true;
+				next_token(t, token);
+				extend(group->text, token);
+			}
+			if (peek_token(t, next) && parse_period(next, group->from, group->to))
+			{
+				next_token(t, token);
+				extend(group->text, token);
+			}
+			continue;
+		}
+
+		if (starts_with(token, "TX") && parse_extreme(token, report.max_temperature, report.max_time))
+		{
+			continue;
+		}
+		if (starts_with(token, "TN") && parse_extreme(token, report.min_temperature, report.min_time))
+		{
+			continue;
+		}
+		if (parse_conditions(t, token, group->conditions))
+		{
+			extend(group->text, token);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,159 @@
+//
+// METAR / TAF decoder
+//
+// Reports are decoded in place: every text field is a slice of the input,
+// which must outlive the decoded structure. Decoding never allocates and
+// all groups are held in fixed size arrays, extra groups are dropped.
+//
+#ifndef METAR_H_
+#define METAR_H_
+
+#include <Arduino.h>
+
+#define WX_MAX_WEATHER 4
+#define WX_MAX_CLOUDS 4
+#define WX_MAX_RVR 4
+#define WX_MAX_TRENDS 2
+#define WX_MAX_GROUPS 12
+
+#define WX_UNKNOWN 0xffff // visibility, cloud base...
+#define WX_VRB -1		  // variable wind direction
+#define WX_NO_TEMP -128	  // missing temperature
+
+// slice of the report text (not null terminated)
+typedef struct
+{
+	const char *text;
+	uint16_t length;
+} wx_text;
+
+typedef struct
+{
+	uint8_t day;
+	uint8_t hour;
+	uint8_t minute;
+} wx_time;
+
+typedef struct
+{
+	int16_t direction; // degrees, WX_VRB
+	uint8_t speed;	   // knots
+	uint8_t gust;	   // knots, 0 if none
+	int16_t from;	   // variable sector, -1 if none
+	int16_t to;
+} wx_wind;
+
+typedef enum
+{
+	WX_NONE,
+	WX_FEW,
+	WX_SCT,
+	WX_BKN,
+	WX_OVC,
+	WX_VV,	// vertical visibility (sky obscured)
+	WX_NSC, // no significant cloud
+	WX_NCD, // no cloud detected
+	WX_SKC,
+	WX_CLR
+} wx_cover;
+
+typedef enum
+{
+	WX_CLOUD,
+	WX_CB,
+	WX_TCU
+} wx_cloud_type;
+
+typedef struct
+{
+	wx_cover cover;
+	wx_cloud_type type;
+	uint16_t base; // feet, WX_UNKNOWN
+} wx_cloud;
+
+typedef struct
+{
+	wx_text runway;
+	uint16_t min;	// meters
+	uint16_t max;	// meters, same as min if not variable
+	char modifier;	// 'P', 'M' or 0
+	char trend;		// 'U', 'D', 'N' or 0
+} wx_rvr;
+
+// conditions shared by observations, trends and forecast groups
+typedef struct
+{
+	bool has_wind;
+	wx_wind wind;
+	bool cavok;
+	uint16_t visibility; // meters, 9999 is 10 km or more, WX_UNKNOWN
+	bool nsw;			 // no significant weather
+	uint8_t weather_count;
+	wx_text weather[WX_MAX_WEATHER];
+	uint8_t cloud_count;
+	wx_cloud clouds[WX_MAX_CLOUDS];
+} wx_conditions;
+
+typedef enum
+{
+	WX_BASE,
+	WX_FM,
+	WX_BECMG,
+	WX_TEMPO,
+	WX_PROB, // probability, may also be temporary
+	WX_NOSIG
+} wx_change;
+
+typedef struct
+{
+	wx_change change;
+	uint8_t probability; // 30 or 40 for WX_PROB
+	bool temporary;		 // PROBxx TEMPO
+	wx_time from;
+	wx_time to;
+	wx_text text; // whole group
+	wx_conditions conditions;
+} wx_group;
+
+typedef struct
+{
+	bool speci;
+	bool auto_report;
+	bool nil;
+	wx_text station;
+	wx_time time;
+	wx_conditions conditions;
+	uint8_t rvr_count;
+	wx_rvr rvr[WX_MAX_RVR];
+	int8_t temperature; // celsius, WX_NO_TEMP
+	int8_t dew_point;	// celsius, WX_NO_TEMP
+	uint16_t qnh;		// hPa, 0 if missing
+	uint8_t trend_count;
+	wx_group trends[WX_MAX_TRENDS];
+	wx_text remarks;
+} metar;
+
+typedef struct
+{
+	bool amended;
+	bool nil;
+	wx_text station;
+	wx_time time;
+	wx_time from;
+	wx_time to;
+	int8_t max_temperature; // WX_NO_TEMP
+	wx_time max_time;
+	int8_t min_temperature; // WX_NO_TEMP
+	wx_time min_time;
+	uint8_t group_count; // groups[0] is the base forecast
+	wx_group groups[WX_MAX_GROUPS];
+} taf;
+
+// decode a raw report, return false if it is not a valid METAR / TAF
+bool metar_decode(const char *text, uint16_t length, metar &report);
+bool taf_decode(const char *text, uint16_t length, taf &report);
+
+// compare a slice with a null terminated string
+bool wx_equals(const wx_text &text, const char *string);
+
+#endif
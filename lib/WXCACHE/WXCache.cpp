@@ -0,0 +1,166 @@
+//
+// Station report cache and fetch schedule
+//
+
+#include <Arduino.h>
+
+#include "WXCache.h"
+
+#define SECONDS_PER_DAY 86400UL
+
+// days since 1970-01-01 of a civil date
+static int32_t days_from_civil(int32_t year, uint8_t month, uint8_t day)
+{
+	year -= month <= 2;
+	int32_t era = (year >= 0 ? year : year - 399) / 400;
+	uint32_t yoe = year - era * 400;
+	uint32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + (int32_t)doe - 719468;
+}
+
+// civil date of a day count since 1970-01-01
+static void civil_from_days(int32_t days, int32_t &year, uint8_t &month, uint8_t &day)
+{
+	days += 719468;
+	int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+	uint32_t doe = days - era * 146097;
+	uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	uint32_t mp = (5 * doy + 2) / 153;
+	day = doy - (153 * mp + 2) / 5 + 1;
+	month = mp < 10 ? mp + 3 : mp - 9;
+	year = (int32_t)yoe + era * 400 + (month <= 2);
+}
+
+static uint8_t days_in_month(int32_t year, uint8_t month)
+{
+	int32_t first = days_from_civil(year, month, 1);
+	return 12 == month ? days_from_civil(year + 1, 1, 1) - first : days_from_civil(year, month + 1, 1) - first;
+}
+
+static uint32_t next(const wx_source &source, uint32_t now, uint32_t interval, uint32_t delay, uint32_t retry)
+{
+	if (0 == source.checked)
+	{
+		return now;
+	}
+	if (0 != source.issued && now >= WX_CLOCK_VALID)
+	{
+		uint32_t published = source.issued + interval + delay;
+		return published > source.checked + retry ? published : source.checked + retry;
+	}
+	return source.checked + interval;
+}
+
+static bool store(wx_source &source, char *cached, uint16_t size, const char *text, uint16_t length, const wx_time *time, uint32_t now)
+{
+	source.checked = now;
+	if (0 != time && now >= WX_CLOCK_VALID)
+	{
+		source.issued = wx_epoch(*time, now);
+	}
+
+	// too long: keep the whole groups that fit, or as much as fits of a
+	// first group longer than that
+	if (length >= size)
+	{
+		length = size - 1;
+		while (length && ' ' != text[length])
+		{
+			--length;
+		}
+		if (0 == length)
+		{
+			length = size - 1;
+		}
+	}
+
+	if (0 == strncmp(cached, text, length) && 0 == cached[length])
+	{
+		return false;
+	}
+	memcpy(cached, text, length);
+	cached[length] = 0;
+	return true;
+}
+
+void wx_station_init(wx_station &station, const char *icao)
+{
+	memset(&station, 0, sizeof(station));
+	strncpy(station.icao, icao, sizeof(station.icao) - 1);
+}
+
+bool wx_metar_due(const wx_station &station, uint32_t now)
+{
+	return (int32_t)(now - wx_metar_next(station, now)) >= 0;
+}
+
+bool wx_taf_due(const wx_station &station, uint32_t now)
+{
+	return (int32_t)(now - wx_taf_next(station, now)) >= 0;
+}
+
+uint32_t wx_metar_next(const wx_station &station, uint32_t now)
+{
+	return next(station.metar_source, now, WX_METAR_INTERVAL, WX_METAR_DELAY, WX_METAR_RETRY);
+}
+
+uint32_t wx_taf_next(const wx_station &station, uint32_t now)
+{
+	return next(station.taf_source, now, WX_TAF_INTERVAL, 0, WX_TAF_RETRY);
+}
+
+bool wx_store_metar(wx_station &station, const char *text, uint16_t length, uint32_t now)
+{
+	static metar report;
+	bool valid = metar_decode(text, length, report) && 0 != report.time.day;
+	bool changed = store(station.metar_source, station.metar, sizeof(station.metar), text, length, valid ? &report.time : 0, now);
+	station.changed = station.changed || changed;
+	return changed;
+}
+
+bool wx_store_taf(wx_station &station, const char *text, uint16_t length, uint32_t now)
+{
+	static taf report;
+	bool decoded = taf_decode(text, length, report);
+	bool valid = decoded && 0 != report.time.day;
+	bool changed = store(station.taf_source, station.taf, sizeof(station.taf), text, length, valid ? &report.time : 0, now);
+	if (changed)
+	{
+		station.timeline.hours = 0;
+		if (decoded && now >= WX_CLOCK_VALID)
+		{
+			wx_timeline_build(station.timeline, report, now);
+		}
+	}
+	station.changed = station.changed || changed;
+	return changed;
+}
+
+uint32_t wx_epoch(const wx_time &time, uint32_t now)
+{
+	int32_t year;
+	uint8_t month, day;
+	civil_from_days(now / SECONDS_PER_DAY, year, month, day);
+
+	// a day of month after today is in the previous month
+	if (time.day > day)
+	{
+		if (1 == month)
+		{
+			month = 12;
+			--year;
+		}
+		else
+		{
+			--month;
+		}
+	}
+
+	// no such day in that month (clock a few days off): its last day
+	uint8_t last = days_in_month(year, month);
+	uint8_t mday = time.day < last ? time.day : last;
+
+	return (uint32_t)days_from_civil(year, month, mday) * SECONDS_PER_DAY + time.hour * 3600UL + time.minute * 60UL;
+}
@@ -0,0 +1,66 @@
+//
+// Last reports received for each station, with what is needed to decide
+// when to ask for the next ones (report time, HTTP validators)
+//
+// Entries are plain data so they can live in RTC memory.
+//
+#ifndef WXCACHE_H_
+#define WXCACHE_H_
+
+#include <Arduino.h>
+#include <METAR.h>
+#include <WXTimeline.h>
+
+#define WX_METAR_SIZE 256
+#define WX_TAF_SIZE 1024
+#define WX_ETAG_SIZE 48
+#define WX_DATE_SIZE 32
+
+// schedule, in seconds
+#define WX_METAR_INTERVAL (30 * 60) // between two observations
+#define WX_METAR_DELAY (5 * 60)		// before an observation is published
+#define WX_METAR_RETRY (5 * 60)		// while the next one is not published
+#define WX_TAF_INTERVAL (3 * 3600)
+#define WX_TAF_RETRY (30 * 60)
+
+// below this the clock is not set (seconds since 1970)
+#define WX_CLOCK_VALID 1500000000UL
+
+typedef struct
+{
+	uint32_t issued;  // report time, 0 if unknown
+	uint32_t checked; // last request, 0 if never
+	char etag[WX_ETAG_SIZE];
+	char modified[WX_DATE_SIZE];
+} wx_source;
+
+typedef struct
+{
+	char icao[5];
+	bool changed; // reports differ from the displayed ones
+	wx_source metar_source;
+	wx_source taf_source;
+	char metar[WX_METAR_SIZE];
+	char taf[WX_TAF_SIZE];
+	wx_timeline timeline; // of the cached TAF
+} wx_station;
+
+void wx_station_init(wx_station &station, const char *icao);
+
+// true if a new report may be available
+bool wx_metar_due(const wx_station &station, uint32_t now);
+bool wx_taf_due(const wx_station &station, uint32_t now);
+
+// time at which the next report may be available
+uint32_t wx_metar_next(const wx_station &station, uint32_t now);
+uint32_t wx_taf_next(const wx_station &station, uint32_t now);
+
+// keep a received report, return true if it differs from the cached one;
+// a new TAF is resolved into the station timeline
+bool wx_store_metar(wx_station &station, const char *text, uint16_t length, uint32_t now);
+bool wx_store_taf(wx_station &station, const char *text, uint16_t length, uint32_t now);
+
+// seconds since 1970 of a report time, taken in the last month before now
+uint32_t wx_epoch(const wx_time &time, uint32_t now);
+
+#endif
@@ -0,0 +1,229 @@
+//
+// Streaming reader for the aviationweather.gov data server XML
+//
+
+#include <Arduino.h>
+
+#include "WXFeed.h"
+
+WXFeed::WXFeed(const char *const *stations, uint8_t station_count, wx_report *callback, void *context) : stations(stations),
+																										 station_count(station_count),
+																										 callback(callback),
+																										 context(context)
+{
+	this->reset();
+}
+
+void WXFeed::reset()
+{
+	this->state = CONTENT;
+	this->tag_length = 0;
+	this->closing = false;
+	this->tag_done = false;
+	this->empty = false;
+	this->entity_length = 0;
+	this->in_raw_text = false;
+	this->overflow = false;
+	this->text_length = 0;
+}
+
+size_t WXFeed::write(uint8_t c)
+{
+	switch (this->state)
+	{
+	case CONTENT:
+		if ('<' == c)
+		{
+			this->state = TAG;
+			this->tag_length = 0;
+			this->closing = false;
+			this->tag_done = false;
+			this->empty = false;
+		}
+		else if (this->in_raw_text)
+		{
+			if ('&' == c)
+			{
+				this->state = ENTITY;
+				this->entity_length = 0;
+			}
+			else
+			{
+				this->append(c);
+			}
+		}
+		break;
+
+	case TAG:
+		if ('>' == c)
+		{
+			this->state = CONTENT;
+			this->end_tag();
+		}
+		else if ('/' == c)
+		{
+			if (0 == this->tag_length && !this->tag_done)
+			{
+				this->closing = true;
+			}
+			else
+			{
+				// <tag/> if nothing else follows
+				this->tag_done = true;
+				this->empty = true;
+			}
+		}
+		else if (' ' == c || '\t' == c || '\r' == c || '\n' == c)
+		{
+			// attributes are ignored
+			this->tag_done = this->tag_done || 0 != this->tag_length;
+		}
+		else
+		{
+			this->empty = false;
+			if (!this->tag_done && this->tag_length < WXFEED_TAG_SIZE - 1)
+			{
+				this->tag[this->tag_length++] = c;
+			}
+		}
+		break;
+
+	case ENTITY:
+		if (';' == c)
+		{
+			this->state = CONTENT;
+			this->end_entity();
+		}
+		else if (this->entity_length < sizeof(this->entity) - 1)
+		{
+			this->entity[this->entity_length++] = c;
+		}
+		break;
+	}
+	return 1;
+}
+
+size_t WXFeed::write(const uint8_t *buffer, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		this->write(buffer[i]);
+	}
+	return size;
+}
+
+int WXFeed::available()
+{
+	return 0;
+}
+
+int WXFeed::read()
+{
+	return -1;
+}
+
+int WXFeed::peek()
+{
+	return -1;
+}
+
+void WXFeed::flush()
+{
+}
+
+// Private functions
+void WXFeed::append(char c)
+{
+	if (this->text_length < WXFEED_TEXT_SIZE - 1)
+	{
+		this->text[this->text_length++] = c;
+	}
+	else
+	{
+		this->overflow = true;
+	}
+}
+
+void WXFeed::end_tag()
+{
+	this->tag[this->tag_length] = 0;
+	if (this->empty || 0 != strcmp(this->tag, "raw_text"))
+	{
+		return;
+	}
+
+	if (this->closing)
+	{
+		if (this->in_raw_text)
+		{
+			this->end_report();
+		}
+		this->in_raw_text = false;
+	}
+	else
+	{
+		this->in_raw_text = true;
+		this->overflow = false;
+		this->text_length = 0;
+	}
+}
+
+void WXFeed::end_entity()
+{
+	static const struct
+	{
+		const char *name;
+		char c;
+	} entities[] = {{"amp", '&'}, {"lt", '<'}, {"gt", '>'}, {"quot", '"'}, {"apos", '\''}};
+
+	this->entity[this->entity_length] = 0;
+	for (uint8_t i = 0; i < sizeof(entities) / sizeof(entities[0]); ++i)
+	{
+		if (0 == strcmp(this->entity, entities[i].name))
+		{
+			this->append(entities[i].c);
+			return;
+		}
+	}
+}
+
+void WXFeed::end_report()
+{
+	// a truncated report would decode to wrong values
+	if (this->overflow || 0 == this->callback)
+	{
+		return;
+	}
+	this->text[this->text_length] = 0;
+
+	// station is the first token after the report type
+	const char *s = this->text;
+	for (;;)
+	{
+		while (' ' == *s || '\n' == *s || '\r' == *s || '\t' == *s)
+		{
+			++s;
+		}
+		if (0 == strncmp(s, "METAR ", 6) || 0 == strncmp(s, "SPECI ", 6))
+		{
+			s += 6;
+		}
+		else if (0 == strncmp(s, "TAF ", 4) || 0 == strncmp(s, "AMD ", 4) || 0 == strncmp(s, "COR ", 4))
+		{
+			s += 4;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	for (uint8_t i = 0; i < this->station_count; ++i)
+	{
+		if (0 == strncmp(s, this->stations[i], 4) && (' ' == s[4] || 0 == s[4]))
+		{
+			this->callback(this->stations[i], this->text, this->text_length, this->context);
+			return;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+//
+// Streaming reader for the aviationweather.gov data server XML
+//
+// The HTTP body is pushed in chunks as it arrives (WXFeed is a Stream, so
+// HTTPClient::writeToStream can feed it directly). Only <raw_text> contents
+// are kept, in a fixed buffer, and handed to the callback when the report
+// belongs to one of the configured stations. Memory use does not depend on
+// the response size.
+//
+#ifndef WXFEED_H_
+#define WXFEED_H_
+
+#include <Arduino.h>
+
+#define WXFEED_TEXT_SIZE 1024
+#define WXFEED_TAG_SIZE 16
+
+// text is null terminated and only valid during the call
+typedef void wx_report(const char *station, const char *text, uint16_t length, void *context);
+
+class WXFeed : public Stream
+{
+private:
+	const char *const *stations;
+	uint8_t station_count;
+	wx_report *callback;
+	void *context;
+
+	enum
+	{
+		CONTENT,
+		TAG,
+		ENTITY
+	} state;
+
+	char tag[WXFEED_TAG_SIZE];
+	uint8_t tag_length;
+	bool closing;
+	bool tag_done;
+	bool empty;
+
+	char entity[8];
+	uint8_t entity_length;
+
+	bool in_raw_text;
+	bool overflow;
+	char text[WXFEED_TEXT_SIZE];
+	uint16_t text_length;
+
+	void append(char c);
+	void end_tag();
+	void end_entity();
+	void end_report();
+
+public:
+	WXFeed(const char *const *stations, uint8_t station_count, wx_report *callback, void *context = 0);
+
+	// forget any partial document, call before each new response
+	void reset();
+
+	// push the response body
+	size_t write(uint8_t c);
+	size_t write(const uint8_t *buffer, size_t size);
+
+	// write only stream
+	int available();
+	int read();
+	int peek();
+	void flush();
+};
+
+#endif
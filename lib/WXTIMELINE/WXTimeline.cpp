@@ -0,0 +1,238 @@
+//
+// TAF timeline
+//
+
+#include <Arduino.h>
+
+#include "WXTimeline.h"
+#include "WXCache.h"
+
+#define SECONDS_PER_HOUR 3600UL
+#define SECONDS_PER_DAY 86400UL
+
+// change groups are at most a few days after the report time
+#define GROUP_WINDOW (3 * SECONDS_PER_DAY)
+
+// conditions prevailing at some time, the elements a group may change
+typedef struct
+{
+	int16_t wind_direction;
+	uint8_t wind_speed;
+	uint16_t visibility;
+	uint8_t cover;
+	uint16_t ceiling;
+} forecast;
+
+// most covering layer and lowest broken, overcast or obscured base
+static void clouds_of(const wx_conditions &conditions, uint8_t &cover, uint16_t &ceiling)
+{
+	cover = WX_NONE;
+	ceiling = WX_UNKNOWN;
+	if (conditions.cavok)
+	{
+		cover = WX_NSC;
+	}
+	for (uint8_t i = 0; i < conditions.cloud_count; ++i)
+	{
+		const wx_cloud &cloud = conditions.clouds[i];
+		if (cloud.cover <= WX_VV ? cover > WX_VV || cloud.cover > cover : WX_NONE == cover)
+		{
+			cover = cloud.cover;
+		}
+		if ((WX_BKN == cloud.cover || WX_OVC == cloud.cover || WX_VV == cloud.cover) && cloud.base < ceiling)
+		{
+			ceiling = cloud.base;
+		}
+	}
+}
+
+// elements given by the group replace the current ones
+static void apply(forecast &f, const wx_conditions &conditions)
+{
+	if (conditions.has_wind)
+	{
+		f.wind_direction = conditions.wind.direction;
+		f.wind_speed = conditions.wind.speed;
+	}
+	if (conditions.cavok)
+	{
+		f.visibility = 9999;
+	}
+	else if (WX_UNKNOWN != conditions.visibility)
+	{
+		f.visibility = conditions.visibility;
+	}
+	if (conditions.cavok || conditions.cloud_count)
+	{
+		clouds_of(conditions, f.cover, f.ceiling);
+	}
+}
+
+static void reset(forecast &f)
+{
+	f.wind_direction = -1;
+	f.wind_speed = 0;
+	f.visibility = WX_UNKNOWN;
+	f.cover = WX_NONE;
+	f.ceiling = WX_UNKNOWN;
+}
+
+static uint8_t category(const forecast &f)
+{
+	return wx_category_of(f.ceiling, f.visibility);
+}
+
+static uint8_t worse(uint8_t a, uint8_t b)
+{
+	return a > b ? a : b;
+}
+
+// time of a group, in the month of the report
+static uint32_t group_time(const wx_time &time, uint32_t issued)
+{
+	return wx_epoch(time, issued + GROUP_WINDOW);
+}
+
+void wx_timeline_build(wx_timeline &timeline, const taf &report, uint32_t now)
+{
+	timeline.start = 0;
+	timeline.hours = 0;
+	if (report.nil || 0 == report.group_count || 0 == report.from.day)
+	{
+		return;
+	}
+
+	// report time, or the start of validity if it is missing
+	uint32_t issued = wx_epoch(0 != report.time.day ? report.time : report.from, now);
+	uint32_t from = group_time(report.from, issued);
+	uint32_t to = group_time(report.to, issued);
+	if ((int32_t)(to - from) <= 0)
+	{
+		return;
+	}
+
+	uint32_t group_from[WX_MAX_GROUPS];
+	uint32_t group_to[WX_MAX_GROUPS];
+	for (uint8_t g = 1; g < report.group_count; ++g)
+	{
+		group_from[g] = group_time(report.groups[g].from, issued);
+		group_to[g] = WX_FM == report.groups[g].change ? to : group_time(report.groups[g].to, issued);
+	}
+
+	timeline.start = from - from % SECONDS_PER_HOUR;
+	uint32_t hours = (to - timeline.start + SECONDS_PER_HOUR - 1) / SECONDS_PER_HOUR;
+	timeline.hours = hours < WX_TIMELINE_HOURS ? hours : WX_TIMELINE_HOURS;
+
+	for (uint8_t h = 0; h < timeline.hours; ++h)
+	{
+		uint32_t begin = timeline.start + h * SECONDS_PER_HOUR;
+		uint32_t end = begin + SECONDS_PER_HOUR;
+
+		// prevailing at the start of the hour, anything seen during it
+		// counts for the worst case
+		forecast prevailing;
+		reset(prevailing);
+		apply(prevailing, report.groups[0].conditions);
+		uint8_t worst = 0;
+
+		for (uint8_t g = 1; g < report.group_count; ++g)
+		{
+			const wx_group &group = report.groups[g];
+			if (0 == group.from.day)
+			{
+				// no period, nothing to place it in time
+				continue;
+			}
+			bool during = (int32_t)(group_from[g] - end) < 0 && (int32_t)(group_to[g] - begin) > 0;
+			forecast changed;
+
+			switch (group.change)
+			{
+			case WX_FM:
+				// a complete forecast from then on
+				reset(changed);
+				apply(changed, group.conditions);
+				if ((int32_t)(group_from[g] - begin) <= 0)
+				{
+					prevailing = changed;
+				}
+				else if (during)
+				{
+					worst = worse(worst, category(changed));
+				}
+				break;
+
+			case WX_BECMG:
+				// done at the end of the period, either one during it
+				changed = prevailing;
+				apply(changed, group.conditions);
+				if ((int32_t)(group_to[g] - begin) <= 0)
+				{
+					prevailing = changed;
+				}
+				else if (during)
+				{
+					worst = worse(worst, category(changed));
+				}
+				break;
+
+			case WX_TEMPO:
+			case WX_PROB:
+				if (during)
+				{
+					changed = prevailing;
+					apply(changed, group.conditions);
+					worst = worse(worst, category(changed));
+				}
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		wx_hour &entry = timeline.hour[h];
+		entry.category = category(prevailing);
+		entry.worst = worse(worst, entry.category);
+		entry.cover = prevailing.cover;
+		entry.wind_speed = prevailing.wind_speed;
+		entry.wind_direction = prevailing.wind_direction;
+		entry.ceiling = prevailing.ceiling;
+		entry.visibility = prevailing.visibility;
+	}
+}
+
+const wx_hour *wx_timeline_at(const wx_timeline &timeline, uint32_t time)
+{
+	if ((int32_t)(time - timeline.start) < 0)
+	{
+		return 0;
+	}
+	uint32_t h = (time - timeline.start) / SECONDS_PER_HOUR;
+	return h < timeline.hours ? &timeline.hour[h] : 0;
+}
+
+wx_category wx_category_of(uint16_t ceiling, uint16_t visibility)
+{
+	if (ceiling < 500 || visibility < 1600)
+	{
+		return WX_LIFR;
+	}
+	if (ceiling < 1000 || visibility < 4800)
+	{
+		return WX_IFR;
+	}
+	if (ceiling <= 3000 || visibility <= 8000)
+	{
+		return WX_MVFR;
+	}
+	return WX_VFR;
+}
+
+wx_category wx_category_of(const wx_conditions &conditions)
+{
+	forecast f;
+	reset(f);
+	apply(f, conditions);
+	return (wx_category)category(f);
+}
@@ -0,0 +1,53 @@
+//
+// TAF resolved hour by hour
+//
+// The change groups of a forecast (FM, BECMG, TEMPO, PROB) are replayed
+// once when the TAF is received, into one entry per hour of validity.
+// Conditions at a given time are then a lookup. The timeline is plain
+// data so it can live in RTC memory with the report.
+//
+#ifndef WXTIMELINE_H_
+#define WXTIMELINE_H_
+
+#include <Arduino.h>
+#include <METAR.h>
+
+#define WX_TIMELINE_HOURS 30
+
+typedef enum
+{
+	WX_VFR,
+	WX_MVFR,
+	WX_IFR,
+	WX_LIFR
+} wx_category;
+
+typedef struct
+{
+	uint8_t category; // wx_category of the conditions at the start of the hour
+	uint8_t worst;	  // worst wx_category during the hour, TEMPO and PROB included
+	uint8_t cover;	  // wx_cover of the most covering layer, WX_NONE if unknown
+	uint8_t wind_speed;
+	int16_t wind_direction; // WX_VRB, -1 if unknown
+	uint16_t ceiling;		// feet, WX_UNKNOWN if none
+	uint16_t visibility;	// meters, WX_UNKNOWN
+} wx_hour;
+
+typedef struct
+{
+	uint32_t start; // seconds since 1970 of the first hour
+	uint8_t hours;	// 0 if there is no forecast
+	wx_hour hour[WX_TIMELINE_HOURS];
+} wx_timeline;
+
+// replay a decoded TAF, now is used to find the month of its times
+void wx_timeline_build(wx_timeline &timeline, const taf &report, uint32_t now);
+
+// forecast for the hour holding time, 0 if it is not covered
+const wx_hour *wx_timeline_at(const wx_timeline &timeline, uint32_t time);
+
+// flight category of a ceiling and a visibility (US definitions)
+wx_category wx_category_of(uint16_t ceiling, uint16_t visibility);
+wx_category wx_category_of(const wx_conditions &conditions);
+
+#endif
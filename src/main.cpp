@@ -1,54 +1,521 @@
-
 #include <Arduino.h>
 #include <SPI.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+#include <Preferences.h>
 #include <EPD.h>
 #include <frame.h>
+#include <LM75A.h>
+#include <METAR.h>
+#include <WXFeed.h>
+#include <WXCache.h>
+#include <WXTimeline.h>
+#include <Icons.h>
+
+#define DISPLAY_SIZE EPD_2_7
+#define DISPLAY_WIDTH EPD_WIDTH(DISPLAY_SIZE)
+#define DISPLAY_HEIGHT EPD_HEIGHT(DISPLAY_SIZE)
+#define DISPLAY_BYTES EPD_IMAGE_BYTES(DISPLAY_SIZE)
+
+// network settings, override with build flags
+#ifndef WIFI_SSID
+#define WIFI_SSID ""
+#endif
+#ifndef WIFI_PASSWORD
+#define WIFI_PASSWORD ""
+#endif
+#define WIFI_TIMEOUT 15000
+
+#define METAR_URL "https://aviationweather.gov/api/data/metar?format=xml&ids="
+#define TAF_URL "https://aviationweather.gov/api/data/taf?format=xml&ids="
+#define NTP_SERVER "pool.ntp.org"
+
+// seconds each station stays on screen
+#define ROTATION_INTERVAL 60
+
+// forecast band: hours shown, width of an hour
+#define BAND_HOURS 12
+#define BAND_STEP 22
 
-#define DISPLAY_WIDTH 264
-#define DISPLAY_HEIGHT 176
+// deep sleep between wake-ups instead of waiting, 0 to stay awake
+#ifndef DEEP_SLEEP
+#define DEEP_SLEEP 1
+#endif
+#define MIN_SLEEP 10		  // seconds
+#define MAX_SLEEP (30 * 60) // seconds
 
-static uint8_t state = 0;
+// print refresh and loop counters over serial
+#ifndef TELEMETRY
+#define TELEMETRY 0
+#endif
+
+// kept in RTC memory across deep sleep
+RTC_DATA_ATTR static uint8_t state = 0;
+
+EPD einkDisplay(DISPLAY_SIZE, 33, 25, 26, 27, 14, 5, SPI);
+
+// ghosting built up on the panel, decides between partial, full update and
+// clear cycle
+RTC_DATA_ATTR static epd_ghosting ghosting;
+EPD_Policy refreshPolicy(ghosting, DISPLAY_HEIGHT);
 
-EPD einkDisplay(DISPLAY_WIDTH, DISPLAY_HEIGHT, 33, 25, 26, 27, 14, 5, SPI);
 Frame displayFrame(DISPLAY_WIDTH, DISPLAY_HEIGHT);
+LM75A_Class panelSensor;
+
+// displayed airfields, in rotation order
+static const char *const stationList[] = {"LFLY", "LFLL", "LFLS"};
+#define STATION_COUNT (sizeof(stationList) / sizeof(stationList[0]))
+
+RTC_DATA_ATTR static wx_station stations[STATION_COUNT];
+
+// RTC slow memory is 8 KB, less what the core and the ULP reserve and the
+// other RTC variables (ghosting state, schedule)
+#define RTC_STATIONS_SIZE 6144
+static_assert(sizeof(stations) <= RTC_STATIONS_SIZE, "too many stations for RTC memory, shorten stationList or WX_TAF_SIZE");
+
+RTC_DATA_ATTR static uint8_t current = STATION_COUNT - 1;
+RTC_DATA_ATTR static uint32_t shown = 0;
+RTC_DATA_ATTR static uint32_t shownHour = 0;
+RTC_DATA_ATTR static bool redraw = true;
+
+// displayed image, too large for RTC memory, kept in flash
+static Preferences panelState;
+static volatile bool imageChanged = false;
+
+typedef bool store_report(wx_station &station, const char *text, uint16_t length, uint32_t now);
+
+typedef struct
+{
+  wx_station *station;
+  store_report *store;
+  uint32_t now;
+  bool received;
+} Request;
+
+// keep the first report of the station, they are sorted newest first
+static void storeReport(const char *icao, const char *text, uint16_t length, void *context)
+{
+  Request *request = (Request *)context;
+  if (!request->received)
+  {
+    request->store(*request->station, text, length, request->now);
+    request->received = true;
+  }
+}
+
+static bool connect()
+{
+  if (WL_CONNECTED == WiFi.status())
+  {
+    return true;
+  }
+
+  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  unsigned long start = millis();
+  while (WL_CONNECTED != WiFi.status())
+  {
+    if (millis() - start > WIFI_TIMEOUT)
+    {
+      return false;
+    }
+    delay(100);
+  }
+
+  configTime(0, 0, NTP_SERVER);
+  return true;
+}
+
+static void copyHeader(HTTPClient &http, const char *name, char *value, size_t size)
+{
+  strncpy(value, http.header(name).c_str(), size - 1);
+  value[size - 1] = 0;
+}
+
+// conditional request of a station report, streamed through the feed
+// reader; nothing is downloaded if the server still has the cached one
+static bool fetch(const char *url, wx_station &station, wx_source &source, store_report *store, uint32_t now)
+{
+  static const char *validators[] = {"ETag", "Last-Modified"};
+  char address[96];
+  snprintf(address, sizeof(address), "%s%s", url, station.icao);
+
+  // public data, the server certificate is not checked
+  WiFiClientSecure client;
+  client.setInsecure();
+
+  HTTPClient http;
+  if (!http.begin(client, address))
+  {
+    return false;
+  }
+  http.collectHeaders(validators, 2);
+  if (source.etag[0])
+  {
+    http.addHeader("If-None-Match", source.etag);
+  }
+  if (source.modified[0])
+  {
+    http.addHeader("If-Modified-Since", source.modified);
+  }
+
+  const char *const icao[] = {station.icao};
+  Request request = {&station, store, now, false};
+  WXFeed feed(icao, 1, storeReport, &request);
+
+  bool ok = false;
+  int code = http.GET();
+  if (HTTP_CODE_OK == code && http.writeToStream(&feed) >= 0)
+  {
+    if (request.received)
+    {
+      copyHeader(http, "ETag", source.etag, sizeof(source.etag));
+      copyHeader(http, "Last-Modified", source.modified, sizeof(source.modified));
+    }
+    ok = true;
+  }
+  else if (HTTP_CODE_NOT_MODIFIED == code)
+  {
+    ok = true;
+  }
+
+  // wait for the schedule before asking again
+  if (ok)
+  {
+    source.checked = now;
+  }
+  http.end();
+  return ok;
+}
+
+// request the reports which may have been renewed
+static void updateReports(uint32_t now)
+{
+  bool online = false;
+
+  for (uint8_t i = 0; i < STATION_COUNT; ++i)
+  {
+    wx_station &station = stations[i];
+    bool metarDue = wx_metar_due(station, now);
+    bool tafDue = wx_taf_due(station, now);
+
+    if (!metarDue && !tafDue)
+    {
+      continue;
+    }
+    if (!online && !(online = connect()))
+    {
+      return;
+    }
+    if (metarDue)
+    {
+      fetch(METAR_URL, station, station.metar_source, wx_store_metar, now);
+    }
+    if (tafDue)
+    {
+      fetch(TAF_URL, station, station.taf_source, wx_store_taf, now);
+    }
+  }
+}
+
+#define ICON_SPACING 4
+
+static icon categoryIcon(uint8_t category)
+{
+  return (icon)(ICON_VFR + category);
+}
+
+// a row of icons below the text: sky cover, wind, weather, and the flight
+// category on the right
+static void drawConditions(const wx_conditions &conditions)
+{
+  wx_cover cover = conditions.cavok ? WX_SKC : WX_NONE;
+  for (uint8_t i = 0; i < conditions.cloud_count; ++i)
+  {
+    // the most covering layer (FEW to VV are in order), clear sky codes
+    // only if there is nothing else
+    wx_cover layer = conditions.clouds[i].cover;
+    if (layer <= WX_VV ? cover > WX_VV || layer > cover : WX_NONE == cover)
+    {
+      cover = layer;
+    }
+  }
+
+  icon icons[2 + WX_MAX_WEATHER];
+  uint8_t count = 0;
+  icons[count++] = icon_cover(cover);
+  icons[count++] = conditions.has_wind ? icon_wind(conditions.wind) : ICON_COUNT;
+  for (uint8_t i = 0; i < conditions.weather_count; ++i)
+  {
+    icons[count++] = icon_weather(conditions.weather[i]);
+  }
+
+  int16_t x = 0;
+  int16_t y = displayFrame.getCursorY();
+  uint8_t height = 0;
+  for (uint8_t i = 0; i < count; ++i)
+  {
+    uint8_t w, h;
+    if (icon_size(icons[i], w, h))
+    {
+      icon_draw(displayFrame, icons[i], x, y);
+      x += w + ICON_SPACING;
+      height = h > height ? h : height;
+    }
+  }
+
+  uint8_t w, h;
+  icon badge = categoryIcon(wx_category_of(conditions));
+  icon_size(badge, w, h);
+  icon_draw(displayFrame, badge, displayFrame.width() - w, y);
+  height = h > height ? h : height;
+
+  displayFrame.setCursor(0, y + height);
+}
+
+// flight category of the next hours from the TAF timeline, the hour
+// (UTC) above it, underlined when TEMPO or PROB groups make it worse
+static void drawForecast(const wx_timeline &timeline, uint32_t now)
+{
+  int16_t y = displayFrame.getCursorY();
+  uint32_t hour = now - now % 3600;
+
+  for (uint8_t i = 0; i < BAND_HOURS; ++i, hour += 3600)
+  {
+    const wx_hour *forecast = wx_timeline_at(timeline, hour);
+    if (!forecast)
+    {
+      break;
+    }
+
+    int16_t x = i * BAND_STEP;
+    uint8_t w, h;
+    icon badge = categoryIcon(forecast->category);
+    icon_size(badge, w, h);
+    displayFrame.setCursor(x + (BAND_STEP - 12) / 2, y);
+    displayFrame.printf("%02lu", (unsigned long)(hour / 3600 % 24));
+    icon_draw(displayFrame, badge, x + (BAND_STEP - w) / 2, y + 9);
+    if (forecast->worst > forecast->category)
+    {
+      displayFrame.fillRect(x + 2, y + 20, BAND_STEP - 4, 2, BLACK);
+    }
+  }
+  displayFrame.setCursor(0, y + 24);
+}
+
+static void drawStation(const wx_station &station, uint32_t now)
+{
+  static metar observation;
+
+  displayFrame.clear();
+  displayFrame.setTextColor(BLACK);
+  displayFrame.setCursor(0, 0);
+
+  if (metar_decode(station.metar, strlen(station.metar), observation))
+  {
+    displayFrame.printf("%s\n", station.metar);
+    drawConditions(observation.conditions);
+  }
+  else
+  {
+    displayFrame.printf("%s: no METAR\n", station.icao);
+  }
+
+  displayFrame.printf("\n");
+
+  // the TAF resolved when it was received, only looked up here
+  if (wx_timeline_at(station.timeline, now))
+  {
+    drawForecast(station.timeline, now);
+    displayFrame.printf("%s\n", station.taf);
+  }
+  else if (station.taf[0])
+  {
+    displayFrame.printf("%s\n", station.taf);
+  }
+  else
+  {
+    displayFrame.printf("%s: no TAF\n", station.icao);
+  }
+}
+
+// panel temperature for the EPD stage times, 25 if the sensor is missing
+static int16_t panelTemperature()
+{
+  int16_t tenths = panelSensor.temperature();
+  return LM75A_NO_SAMPLE == tenths ? 25 : (tenths + (tenths < 0 ? -5 : 5)) / 10;
+}
+
+// called from the refresh task
+static void refreshDone(void *)
+{
+  if (EPD_skip == einkDisplay.getLastRefresh())
+  {
+    return;
+  }
+  imageChanged = true;
+  if (TELEMETRY)
+  {
+    einkDisplay.printTelemetry(Serial);
+  }
+}
+
+// push the frame to the display, only if something was drawn
+static void refresh()
+{
+  if (displayFrame.isDirty())
+  {
+    panelSensor.wait();
+
+    // the canvas is handed to the display, which gives back a free one;
+    // outside the damaged lines it is the same as the frame before
+    int16_t first = displayFrame.dirtyFirstLine();
+    int16_t last = displayFrame.dirtyLastLine();
+    uint8_t *next = einkDisplay.swapAsync(displayFrame.getBuffer(), first, last);
+    if (!next)
+    {
+      next = einkDisplay.updateSwap(displayFrame.getBuffer(), first, last);
+      refreshDone(NULL);
+    }
+    displayFrame.swapBuffer(next);
+    displayFrame.clearDirty();
+  }
+}
+
+// show the next station when its time is over, or the current one again
+// when its reports changed
+static void updateDisplay(uint32_t now)
+{
+  if (STATION_COUNT > 1 && now - shown >= ROTATION_INTERVAL)
+  {
+    current = (current + 1) % STATION_COUNT;
+    shown = now;
+    redraw = true;
+  }
+
+  // the forecast band moves every hour
+  if (now / 3600 != shownHour)
+  {
+    shownHour = now / 3600;
+    redraw = true;
+  }
+
+  if (redraw || stations[current].changed)
+  {
+    drawStation(stations[current], now);
+    refresh();
+    stations[current].changed = false;
+    redraw = false;
+  }
+}
+
+// what the panel shows, written only after it changed
+static void saveImage()
+{
+  panelState.putBytes("image", einkDisplay.getImage(), DISPLAY_BYTES);
+  panelState.putUChar("partial", einkDisplay.getPartialCount());
+  imageChanged = false;
+}
+
+// the frame buffer is free at wake-up, use it to load the image
+static bool restoreImage()
+{
+  if (panelState.getBytesLength("image") != DISPLAY_BYTES)
+  {
+    return false;
+  }
+  panelState.getBytes("image", displayFrame.getBuffer(), DISPLAY_BYTES);
+  einkDisplay.restore(displayFrame.getBuffer(), panelState.getUChar("partial"));
+
+  // the first frame is compared with all of it
+  displayFrame.invalidate();
+  return true;
+}
+
+// sleep until the next report is due or the next station is shown
+static void deepSleep(uint32_t now)
+{
+  uint32_t wake = STATION_COUNT > 1 ? shown + ROTATION_INTERVAL : (shownHour + 1) * 3600;
+  for (uint8_t i = 0; i < STATION_COUNT; ++i)
+  {
+    uint32_t metarNext = wx_metar_next(stations[i], now);
+    uint32_t tafNext = wx_taf_next(stations[i], now);
+    wake = (int32_t)(metarNext - wake) < 0 ? metarNext : wake;
+    wake = (int32_t)(tafNext - wake) < 0 ? tafNext : wake;
+  }
+
+  int32_t seconds = wake - now;
+  seconds = seconds < MIN_SLEEP ? MIN_SLEEP : seconds > MAX_SLEEP ? MAX_SLEEP : seconds;
+
+  // the last refresh tells whether the image changed
+  while (einkDisplay.isBusy())
+  {
+    delay(10);
+  }
+  if (imageChanged)
+  {
+    saveImage();
+  }
+
+  // a wake-up without redraw has not waited for its sample yet, and the
+  // sensor converts on through the sleep unless shut down
+  panelSensor.end();
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+
+  esp_deep_sleep((uint64_t)seconds * 1000000ULL);
+}
 
 // setup
 void setup()
 {
+  if (TELEMETRY)
+  {
+    Serial.begin(115200);
+  }
+  WiFi.mode(WIFI_STA);
+  panelState.begin("panel");
+
+  panelSensor.begin();
+
   einkDisplay.begin();
+  einkDisplay.setThermometer(panelTemperature);
+  einkDisplay.setPolicy(&refreshPolicy);
+  einkDisplay.beginAsync(1, refreshDone);
+
+  // first start: nothing known about the panel content
+  if (0 == state || !restoreImage())
+  {
+    for (uint8_t i = 0; i < STATION_COUNT; ++i)
+    {
+      wx_station_init(stations[i], stationList[i]);
+    }
+    refreshPolicy.reset();
+    state = 0;
+  }
   displayFrame.fillScreen(WHITE);
 }
 
 // main loop
 void loop()
 {
-  einkDisplay.setFactor();
-
-  switch (state)
-  {
-  default:
-    break;
-    
-  case 0:
-    einkDisplay.clear();
-    state = 1;
-    break;
-
-  case 1:
-    displayFrame.setCursor(100,100);
-    displayFrame.setTextColor(1);
-    displayFrame.printf("LFLY METAR TAF");
-    einkDisplay.update(displayFrame.getBuffer());
-    displayFrame.clear();
-    state = 2;
-    break;
-
-  case 2:
-    displayFrame.drawCircle(100,30,20,BLACK);
-    einkDisplay.update(displayFrame.getBuffer());
-    displayFrame.clear();
-    state = 0;
-    break;
+  panelSensor.update();
+
+  unsigned long start = millis();
+  uint32_t now = time(NULL);
+  updateReports(now);
+
+  // the first frame is drawn after a clear cycle, chosen by the policy
+  updateDisplay(now);
+  state = 1;
+
+  if (TELEMETRY)
+  {
+    Serial.printf("loop %lu ms, heap low %u B\n", millis() - start, ESP.getMinFreeHeap());
+  }
+  if (DEEP_SLEEP)
+  {
+    deepSleep(now);
   }
 
   delay(10000);
@@ -0,0 +1,320 @@
+//
+// Recording EPD_Bus for host tests and benchmarks
+//
+
+#include <Arduino.h>
+
+#include "EPD_mock_bus.h"
+
+thread_local int16_t EPD_MockBus::current = -1;
+
+EPD_MockBus::EPD_MockBus(uint8_t chip_select_pin,
+						 uint8_t busy_pin,
+						 uint8_t reset_pin,
+						 uint32_t spi_hz)
+{
+	this->byte_ns = 8000000000ULL / spi_hz;
+	this->owner = -1;
+	this->free_ns = 0;
+	this->recording = true;
+	this->addPanel(chip_select_pin, busy_pin, reset_pin);
+	this->setBusy(0, 0);
+	this->reset();
+}
+
+uint8_t EPD_MockBus::addPanel(uint8_t chip_select_pin, uint8_t busy_pin, uint8_t reset_pin)
+{
+	mock_panel panel = {chip_select_pin, busy_pin, reset_pin, 0, 0, false, false, false, false};
+	this->panels.push_back(panel);
+	return this->panels.size() - 1;
+}
+
+void EPD_MockBus::attach(uint8_t panel)
+{
+	std::unique_lock<std::mutex> guard(this->state);
+	this->panels[panel].attached = true;
+}
+
+void EPD_MockBus::detach(uint8_t panel)
+{
+	std::unique_lock<std::mutex> guard(this->state);
+	this->panels[panel].attached = false;
+	if (panel == this->owner)
+	{
+		this->owner = -1;
+	}
+	if (panel == current)
+	{
+		current = -1;
+	}
+	this->turns.notify_all();
+}
+
+void EPD_MockBus::use(uint8_t panel)
+{
+	current = panel;
+}
+
+void EPD_MockBus::setBusy(uint32_t ready_us, uint32_t latch_us, uint32_t poll_us)
+{
+	this->ready_us = ready_us;
+	this->latch_us = latch_us;
+	this->poll_us = poll_us > 0 ? poll_us : 1;
+}
+
+void EPD_MockBus::setRecording(bool enable)
+{
+	this->recording = enable;
+}
+
+void EPD_MockBus::reset()
+{
+	this->events.clear();
+	this->bytes.clear();
+	this->transfer_event = 0;
+	memset(&this->counters, 0, sizeof(this->counters));
+}
+
+const mock_counters &EPD_MockBus::getCounters()
+{
+	return this->counters;
+}
+
+uint32_t EPD_MockBus::getEventCount()
+{
+	return this->events.size();
+}
+
+const mock_event &EPD_MockBus::getEvent(uint32_t index)
+{
+	return this->events[index];
+}
+
+const uint8_t *EPD_MockBus::getBytes(const mock_event &event)
+{
+	return &this->bytes[event.offset];
+}
+
+void EPD_MockBus::begin()
+{
+}
+
+void EPD_MockBus::put(uint8_t c)
+{
+	std::unique_lock<std::mutex> guard(this->state);
+	this->wait_turn(guard);
+	this->transfer(&c, 1);
+}
+
+void EPD_MockBus::write(const uint8_t *buffer, uint16_t length)
+{
+	std::unique_lock<std::mutex> guard(this->state);
+	this->wait_turn(guard);
+	this->transfer(buffer, length);
+
+	// the COG latches the block
+	mock_panel &panel = this->panel();
+	panel.busy_until_ns = panel.now_ns + (uint64_t)this->latch_us * 1000;
+}
+
+void EPD_MockBus::pin_mode(uint8_t, uint8_t)
+{
+}
+
+void EPD_MockBus::pin_write(uint8_t pin, uint8_t value)
+{
+	std::unique_lock<std::mutex> guard(this->state);
+	this->wait_turn(guard);
+	++this->counters.pin_writes;
+	this->record(MOCK_PIN, pin, value, 0);
+
+	mock_panel *target = this->panel_of(pin);
+	if (!target)
+	{
+		return;
+	}
+	if (pin == target->cs_pin)
+	{
+		// bytes up to CS high make one transfer
+		target->selected = LOW == value;
+		target->started = false;
+	}
+	else if (pin == target->reset_pin && HIGH == value)
+	{
+		// the COG starts
+		target->busy_until_ns = this->panel().now_ns + (uint64_t)this->ready_us * 1000;
+	}
+}
+
+int EPD_MockBus::pin_read(uint8_t pin)
+{
+	std::unique_lock<std::mutex> guard(this->state);
+	this->wait_turn(guard);
+	mock_panel &panel = this->panel();
+	mock_panel *target = this->panel_of(pin);
+	if (!target || pin != target->busy_pin || panel.now_ns >= target->busy_until_ns)
+	{
+		return LOW;
+	}
+
+	++this->counters.busy_reads;
+	this->counters.busy_us += this->poll_us;
+	panel.now_ns += (uint64_t)this->poll_us * 1000;
+	this->turns.notify_all();
+	return HIGH;
+}
+
+void EPD_MockBus::delay_ms(uint32_t ms)
+{
+	this->delay_us(ms * 1000);
+}
+
+void EPD_MockBus::delay_us(uint32_t us)
+{
+	std::unique_lock<std::mutex> guard(this->state);
+	this->wait_turn(guard);
+	this->counters.delay_us += us;
+	this->record(MOCK_DELAY, MOCK_NO_PIN, 0, us);
+	this->panel().now_ns += (uint64_t)us * 1000;
+	this->turns.notify_all();
+}
+
+unsigned long EPD_MockBus::time_us()
+{
+	std::unique_lock<std::mutex> guard(this->state);
+	return this->panel().now_ns / 1000;
+}
+
+void EPD_MockBus::idle()
+{
+}
+
+void EPD_MockBus::lock()
+{
+	std::unique_lock<std::mutex> guard(this->state);
+	int16_t index = current < 0 ? 0 : current;
+	mock_panel &panel = this->panels[index];
+
+	// out of the turns while another panel has the bus, unlock() puts it
+	// back at the time the bus is free
+	for (;;)
+	{
+		this->wait_turn(guard);
+		if (this->owner < 0 || index == this->owner)
+		{
+			break;
+		}
+		panel.waiting = true;
+		this->turns.notify_all();
+		this->turns.wait(guard, [&panel] { return !panel.waiting; });
+	}
+	this->owner = index;
+}
+
+void EPD_MockBus::unlock()
+{
+	std::unique_lock<std::mutex> guard(this->state);
+	this->owner = -1;
+	this->free_ns = this->panel().now_ns;
+	for (uint8_t i = 0; i < this->panels.size(); ++i)
+	{
+		mock_panel &panel = this->panels[i];
+		if (panel.waiting)
+		{
+			panel.waiting = false;
+			panel.now_ns = panel.now_ns > this->free_ns ? panel.now_ns : this->free_ns;
+		}
+	}
+	this->turns.notify_all();
+}
+
+// Private functions
+mock_panel &EPD_MockBus::panel()
+{
+	return this->panels[current < 0 ? 0 : current];
+}
+
+mock_panel *EPD_MockBus::panel_of(uint8_t pin)
+{
+	for (uint8_t i = 0; i < this->panels.size(); ++i)
+	{
+		mock_panel &panel = this->panels[i];
+		if (pin == panel.cs_pin || pin == panel.busy_pin || pin == panel.reset_pin)
+		{
+			return &panel;
+		}
+	}
+	return 0;
+}
+
+// no other attached panel that can run is behind this one
+bool EPD_MockBus::first_in_time(uint8_t index)
+{
+	const mock_panel &panel = this->panels[index];
+	for (uint8_t i = 0; i < this->panels.size(); ++i)
+	{
+		const mock_panel &other = this->panels[i];
+		if (i == index || !other.attached || other.waiting)
+		{
+			continue;
+		}
+		if (other.now_ns < panel.now_ns || (other.now_ns == panel.now_ns && i < index))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void EPD_MockBus::wait_turn(std::unique_lock<std::mutex> &guard)
+{
+	if (current < 0)
+	{
+		return;
+	}
+	uint8_t index = current;
+	this->turns.wait(guard, [this, index] { return this->first_in_time(index); });
+}
+
+void EPD_MockBus::transfer(const uint8_t *buffer, uint16_t length)
+{
+	// the bytes go to the panel with CS low, the sender's own first (one
+	// that is off keeps CS low too)
+	mock_panel &panel = this->panel();
+	mock_panel *selected = panel.selected ? &panel : 0;
+	for (uint8_t i = 0; i < this->panels.size() && !selected; ++i)
+	{
+		selected = this->panels[i].selected ? &this->panels[i] : 0;
+	}
+
+	this->counters.bytes += length;
+	if (!selected || !selected->started)
+	{
+		this->counters.transfers += 0 != selected;
+		if (selected)
+		{
+			selected->started = true;
+		}
+		this->record(MOCK_TRANSFER, selected ? selected->cs_pin : MOCK_NO_PIN, 0, this->bytes.size());
+		this->transfer_event = this->events.size() - 1;
+	}
+
+	if (this->recording && this->transfer_event < this->events.size())
+	{
+		this->bytes.insert(this->bytes.end(), buffer, buffer + length);
+		this->events[this->transfer_event].length += length;
+	}
+	panel.now_ns += (uint64_t)this->byte_ns * length;
+	this->turns.notify_all();
+}
+
+void EPD_MockBus::record(uint8_t type, uint8_t pin, uint8_t value, uint32_t offset)
+{
+	if (!this->recording)
+	{
+		return;
+	}
+
+	mock_event event = {type, pin, value, 0, offset, (uint32_t)(this->panel().now_ns / 1000)};
+	this->events.push_back(event);
+}
@@ -0,0 +1,153 @@
+//
+// Recording EPD_Bus for host tests and benchmarks.
+//
+// Every SPI transfer (the bytes sent while a chip select is low), pin
+// write and delay is recorded with its time on a simulated clock. The
+// clock advances with the transfer time of the bytes at the bus clock, with
+// the delays, and by one poll period for each BUSY read while the COG is
+// busy. BUSY is held high after the reset pin is released, while the COG
+// starts, and after each block write, while it latches the line data.
+//
+//   EPD_MockBus bus(5, 27, 26); // CS, BUSY, RESET
+//   EPD epd(EPD_2_7, 33, 25, 26, 26, 27, 5, bus);
+//   epd.begin();
+//   epd.clear();
+//   bus.getCounters().bytes, bus.time_us(), bus.getEvent(i)...
+//
+// Several panels can share the bus, each refreshed from its own thread.
+// Each then has its own clock and the threads take turns so the panel
+// furthest behind always runs: lock() waits for the bus in simulated time
+// as a panel would on the target.
+//
+//   uint8_t second = bus.addPanel(15, 4, 16);
+//   bus.attach(0); bus.attach(second);
+//   std::thread([&] { bus.use(second); epd2.update(image); bus.detach(second); });
+//
+#ifndef EPD_MOCK_BUS_H_
+#define EPD_MOCK_BUS_H_
+
+#include <Arduino.h>
+#include <EPD_bus.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#define MOCK_NO_PIN 0xff
+
+typedef enum
+{
+	MOCK_TRANSFER,
+	MOCK_PIN,
+	MOCK_DELAY
+} mock_event_type;
+
+typedef struct
+{
+	uint8_t type;
+	uint8_t pin;	  // pin written, chip select low during a transfer (MOCK_NO_PIN if none)
+	uint8_t value;	  // level written
+	uint16_t length;  // transfer: bytes
+	uint32_t offset;  // transfer: first byte in getBytes(), delay: microseconds
+	uint32_t time_us; // simulated clock at the start of the event
+} mock_event;
+
+typedef struct
+{
+	uint32_t bytes;
+	uint32_t transfers; // chip select cycles with bytes sent
+	uint32_t pin_writes;
+	uint32_t delay_us;
+	uint32_t busy_reads; // BUSY read high
+	uint32_t busy_us;	 // simulated time spent polling BUSY
+} mock_counters;
+
+typedef struct
+{
+	uint8_t cs_pin;
+	uint8_t busy_pin;
+	uint8_t reset_pin;
+	uint64_t now_ns;
+	uint64_t busy_until_ns;
+	bool selected;
+	bool started;  // bytes sent since CS went low
+	bool attached; // takes turns with the other attached panels
+	bool waiting;  // for the bus, out of the turns until it is free
+} mock_panel;
+
+class EPD_MockBus : public EPD_Bus
+{
+private:
+	uint32_t byte_ns;
+	uint32_t ready_us;
+	uint32_t latch_us;
+	uint32_t poll_us;
+
+	std::vector<mock_panel> panels;
+	int16_t owner; // panel holding the bus lock, -1 if none
+	uint64_t free_ns;
+	std::mutex state;
+	std::condition_variable turns;
+	static thread_local int16_t current; // panel of the calling thread
+
+	bool recording;
+	std::vector<mock_event> events;
+	std::vector<uint8_t> bytes;
+	uint32_t transfer_event; // the one bytes go to
+	mock_counters counters;
+
+	mock_panel &panel();
+	mock_panel *panel_of(uint8_t pin);
+	bool first_in_time(uint8_t index);
+	void wait_turn(std::unique_lock<std::mutex> &guard);
+	void transfer(const uint8_t *buffer, uint16_t length);
+	void record(uint8_t type, uint8_t pin, uint8_t value, uint32_t offset);
+
+public:
+	EPD_MockBus(uint8_t chip_select_pin, uint8_t busy_pin, uint8_t reset_pin, uint32_t spi_hz = 4000000);
+
+	// another panel on the bus, returns its index (the first one is 0)
+	uint8_t addPanel(uint8_t chip_select_pin, uint8_t busy_pin, uint8_t reset_pin);
+
+	// from the test thread before the panel threads start: the panel takes
+	// turns with the other attached ones; from its own thread when done
+	void attach(uint8_t panel);
+	void detach(uint8_t panel);
+
+	// the calling thread drives the panel, panel 0 otherwise
+	void use(uint8_t panel);
+
+	// BUSY high for ready_us after reset and latch_us after a block write,
+	// read every poll_us while it is
+	void setBusy(uint32_t ready_us, uint32_t latch_us, uint32_t poll_us = 1);
+
+	// keep the events (on by default), counters are always kept
+	void setRecording(bool enable);
+
+	// forget the events and counters, the clock goes on
+	void reset();
+
+	const mock_counters &getCounters();
+	uint32_t getEventCount();
+	const mock_event &getEvent(uint32_t index);
+	const uint8_t *getBytes(const mock_event &event);
+
+	// EPD_Bus
+	void begin();
+	void put(uint8_t c);
+	void write(const uint8_t *buffer, uint16_t length);
+
+	void pin_mode(uint8_t pin, uint8_t mode);
+	void pin_write(uint8_t pin, uint8_t value);
+	int pin_read(uint8_t pin);
+
+	void delay_ms(uint32_t ms);
+	void delay_us(uint32_t us);
+	unsigned long time_us();
+
+	void idle();
+	void lock();
+	void unlock();
+};
+
+#endif
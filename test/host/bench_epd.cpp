@@ -0,0 +1,164 @@
+//
+// Refresh cost of the EPD driver on the recording bus
+//
+// For clear() and update() of the 2.7": bytes on the wire, SPI
+// transactions, simulated refresh time at a 4 MHz bus with BUSY latency,
+// and host CPU time of the driver. The simulated time is what the panel
+// would take, the CPU time is what the driver costs to run.
+//
+// Then two and three panels updated at once on one bus, each from its own
+// thread as from its own refresh task on the target: the panel time is
+// the time until the last one is done.
+//
+//   epd_bench [temperature]
+//
+
+#include <Arduino.h>
+#include <EPD.h>
+
+#include <time.h>
+
+#include <thread>
+#include <vector>
+
+#include "EPD_mock_bus.h"
+
+#define PANEL_ON_PIN 1
+#define BORDER_PIN 2
+#define DISCHARGE_PIN 3
+#define RESET_PIN 4
+#define BUSY_PIN 5
+#define CS_PIN 6
+
+// CS, BUSY and RESET of the further panels on the shared bus
+#define SHARED_CS_PIN(n) (10 + 3 * (n))
+#define SHARED_BUSY_PIN(n) (11 + 3 * (n))
+#define SHARED_RESET_PIN(n) (12 + 3 * (n))
+
+// COG start after reset, line data latch
+#define READY_US 1000
+#define LATCH_US 10
+
+static uint8_t image[EPD_IMAGE_BYTES(EPD_2_7)];
+
+static double cpu_ms()
+{
+	timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static void report(const char *name, EPD_MockBus &bus, unsigned long start_us, double start_cpu)
+{
+	const mock_counters &counters = bus.getCounters();
+	printf("%-22s %9u %7u %10.1f %9.1f %9.1f\n",
+		   name,
+		   counters.bytes,
+		   counters.transfers,
+		   (bus.time_us() - start_us) / 1000.0,
+		   counters.busy_us / 1000.0,
+		   cpu_ms() - start_cpu);
+}
+
+static void run(const char *name, EPD &epd, EPD_MockBus &bus, bool clear)
+{
+	bus.reset();
+	unsigned long start_us = bus.time_us();
+	double start_cpu = cpu_ms();
+	if (clear)
+	{
+		epd.clear();
+	}
+	else
+	{
+		epd.update(image);
+	}
+	report(name, bus, start_us, start_cpu);
+}
+
+static void run_shared(const char *name, uint8_t count, int16_t temperature)
+{
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	bus.setBusy(READY_US, LATCH_US);
+	bus.setRecording(false);
+
+	std::vector<EPD *> panels;
+	panels.push_back(new EPD(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus));
+	for (uint8_t i = 1; i < count; ++i)
+	{
+		bus.addPanel(SHARED_CS_PIN(i), SHARED_BUSY_PIN(i), SHARED_RESET_PIN(i));
+		panels.push_back(new EPD(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, SHARED_RESET_PIN(i), SHARED_BUSY_PIN(i), SHARED_CS_PIN(i), bus));
+	}
+	for (uint8_t i = 0; i < count; ++i)
+	{
+		panels[i]->begin();
+		panels[i]->setFactor(temperature);
+		bus.attach(i);
+	}
+
+	// count the refreshes only
+	bus.reset();
+	double start_cpu = cpu_ms();
+	std::vector<unsigned long> end_us(count);
+	std::vector<std::thread> threads;
+	for (uint8_t i = 0; i < count; ++i)
+	{
+		threads.push_back(std::thread([&bus, &panels, &end_us, i]()
+									  {
+			bus.use(i);
+			panels[i]->update(image);
+			end_us[i] = bus.time_us();
+			bus.detach(i); }));
+	}
+
+	unsigned long last_us = 0;
+	for (uint8_t i = 0; i < count; ++i)
+	{
+		threads[i].join();
+		last_us = end_us[i] > last_us ? end_us[i] : last_us;
+		delete panels[i];
+	}
+
+	const mock_counters &counters = bus.getCounters();
+	printf("%-22s %9u %7u %10.1f %9.1f %9.1f\n",
+		   name,
+		   counters.bytes,
+		   counters.transfers,
+		   last_us / 1000.0,
+		   counters.busy_us / 1000.0,
+		   cpu_ms() - start_cpu);
+}
+
+int main(int argc, char **argv)
+{
+	int16_t temperature = argc > 1 ? atoi(argv[1]) : 25;
+
+	for (uint32_t i = 0; i < sizeof(image); ++i)
+	{
+		image[i] = (i * 37) >> 3;
+	}
+
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	bus.setBusy(READY_US, LATCH_US);
+	bus.setRecording(false);
+
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	epd.setFactor(temperature);
+
+	printf("2.7\" at %d C, 4 MHz SPI, BUSY %u us at reset, %u us per line\n", temperature, READY_US, LATCH_US);
+	printf("%-22s %9s %7s %10s %9s %9s\n", "", "bytes", "xfers", "panel ms", "busy ms", "cpu ms");
+
+	run("clear", epd, bus, true);
+	run("update", epd, bus, false);
+
+	epd.setLineCache(true);
+	run("clear, line cache", epd, bus, true);
+	run("update, line cache", epd, bus, false);
+	run("update again, cache", epd, bus, false);
+
+	run_shared("2 panels, one bus", 2, temperature);
+	run_shared("3 panels, one bus", 3, temperature);
+
+	return 0;
+}
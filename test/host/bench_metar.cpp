@@ -0,0 +1,72 @@
+//
+// Decoding throughput of the METAR / TAF decoder over the report corpus
+//
+// Host CPU time per report and the size of the decoded structures, which
+// is all the memory a decode takes: nothing is allocated.
+//
+//   metar_bench [passes]
+//
+
+#include <Arduino.h>
+#include <METAR.h>
+
+#include <time.h>
+
+#include <vector>
+
+#include "wx_corpus.h"
+
+static double cpu_us()
+{
+	timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return now.tv_sec * 1000000.0 + now.tv_nsec / 1000.0;
+}
+
+static metar metar_report;
+static taf taf_report;
+
+// keeps the decode from being optimized away
+static volatile uint32_t decoded = 0;
+
+static void run(const char *name, const char *const *reports, uint32_t count, uint32_t passes, bool is_taf)
+{
+	std::vector<uint16_t> lengths(count);
+	uint32_t bytes = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		lengths[i] = strlen(reports[i]);
+		bytes += lengths[i];
+	}
+
+	double start = cpu_us();
+	for (uint32_t pass = 0; pass < passes; ++pass)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			decoded += is_taf ? taf_decode(reports[i], lengths[i], taf_report)
+							  : metar_decode(reports[i], lengths[i], metar_report);
+		}
+	}
+	double elapsed = cpu_us() - start;
+
+	printf("%-8s %7u %8u %10.3f %10.1f %10u\n",
+		   name,
+		   count,
+		   bytes / count,
+		   elapsed / (passes * count),
+		   passes * bytes / elapsed,
+		   is_taf ? (uint32_t)sizeof(taf) : (uint32_t)sizeof(metar));
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t passes = argc > 1 ? atoi(argv[1]) : 20000;
+
+	printf("%u passes over the corpus\n", passes);
+	printf("%-8s %7s %8s %10s %10s %10s\n", "", "reports", "bytes", "us each", "MB/s", "struct");
+	run("METAR", wx_metars, WX_METAR_COUNT, passes, false);
+	run("TAF", wx_tafs, WX_TAF_COUNT, passes, true);
+
+	return decoded ? 0 : 1;
+}
@@ -0,0 +1,264 @@
+//
+// Adafruit GFX subset for the host build
+//
+
+#include "Adafruit_GFX.h"
+
+// 5 columns per glyph, bit 0 at the top, as in glcdfont.c
+static uint8_t font_column(unsigned char c, uint8_t column)
+{
+	uint32_t h = (c + 1) * 2654435761u + column * 40503u;
+	return (h >> 13) & 0x7f;
+}
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h)
+{
+	this->_width = w;
+	this->_height = h;
+	this->cursor_x = 0;
+	this->cursor_y = 0;
+	this->textcolor = 0xffff;
+	this->textbgcolor = 0xffff;
+	this->textsize_x = 1;
+	this->textsize_y = 1;
+	this->rotation = 0;
+	this->wrap = true;
+	this->_cp437 = false;
+	this->gfxFont = 0;
+}
+
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+	for (int16_t i = 0; i < h; ++i)
+	{
+		this->drawPixel(x, y + i, color);
+	}
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+	for (int16_t i = 0; i < w; ++i)
+	{
+		this->drawPixel(x + i, y, color);
+	}
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	for (int16_t i = x; i < x + w; ++i)
+	{
+		this->drawFastVLine(i, y, h, color);
+	}
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color)
+{
+	this->fillRect(0, 0, this->_width, this->_height, color);
+}
+
+void Adafruit_GFX::setRotation(uint8_t r)
+{
+	this->rotation = r & 3;
+	this->_width = this->rotation & 1 ? HEIGHT : WIDTH;
+	this->_height = this->rotation & 1 ? WIDTH : HEIGHT;
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	this->drawFastHLine(x, y, w, color);
+	this->drawFastHLine(x, y + h - 1, w, color);
+	this->drawFastVLine(x, y, h, color);
+	this->drawFastVLine(x + w - 1, y, h, color);
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size)
+{
+	if (x >= this->_width || y >= this->_height || x + 6 * size - 1 < 0 || y + 8 * size - 1 < 0)
+	{
+		return;
+	}
+	if (!this->_cp437 && c >= 176)
+	{
+		c++;
+	}
+
+	for (int8_t i = 0; i < 5; ++i)
+	{
+		uint8_t line = font_column(c, i);
+		for (int8_t j = 0; j < 8; ++j, line >>= 1)
+		{
+			if (line & 1)
+			{
+				this->fillRect(x + i * size, y + j * size, size, size, color);
+			}
+			else if (bg != color)
+			{
+				this->fillRect(x + i * size, y + j * size, size, size, bg);
+			}
+		}
+	}
+	if (bg != color)
+	{
+		this->fillRect(x + 5 * size, y, size, 8 * size, bg);
+	}
+}
+
+size_t Adafruit_GFX::write(uint8_t c)
+{
+	if ('\n' == c)
+	{
+		this->cursor_x = 0;
+		this->cursor_y += this->textsize_y * 8;
+	}
+	else if ('\r' != c)
+	{
+		if (this->wrap && this->cursor_x + this->textsize_x * 6 > this->_width)
+		{
+			this->cursor_x = 0;
+			this->cursor_y += this->textsize_y * 8;
+		}
+		this->drawChar(this->cursor_x, this->cursor_y, c, this->textcolor, this->textbgcolor, this->textsize_x);
+		this->cursor_x += this->textsize_x * 6;
+	}
+	return 1;
+}
+
+void Adafruit_GFX::setCursor(int16_t x, int16_t y)
+{
+	this->cursor_x = x;
+	this->cursor_y = y;
+}
+
+void Adafruit_GFX::setTextColor(uint16_t c)
+{
+	this->textcolor = c;
+	this->textbgcolor = c;
+}
+
+void Adafruit_GFX::setTextColor(uint16_t c, uint16_t bg)
+{
+	this->textcolor = c;
+	this->textbgcolor = bg;
+}
+
+void Adafruit_GFX::setTextSize(uint8_t s)
+{
+	this->textsize_x = s > 0 ? s : 1;
+	this->textsize_y = this->textsize_x;
+}
+
+void Adafruit_GFX::setTextWrap(bool w)
+{
+	this->wrap = w;
+}
+
+void Adafruit_GFX::cp437(bool x)
+{
+	this->_cp437 = x;
+}
+
+int16_t Adafruit_GFX::width() const
+{
+	return this->_width;
+}
+
+int16_t Adafruit_GFX::height() const
+{
+	return this->_height;
+}
+
+uint8_t Adafruit_GFX::getRotation() const
+{
+	return this->rotation;
+}
+
+int16_t Adafruit_GFX::getCursorX() const
+{
+	return this->cursor_x;
+}
+
+int16_t Adafruit_GFX::getCursorY() const
+{
+	return this->cursor_y;
+}
+
+GFXcanvas1::GFXcanvas1(uint16_t w, uint16_t h) : Adafruit_GFX(w, h)
+{
+	this->buffer = (uint8_t *)calloc((w + 7) / 8 * h, 1);
+}
+
+GFXcanvas1::~GFXcanvas1(void)
+{
+	free(this->buffer);
+}
+
+void GFXcanvas1::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+	if (x < 0 || y < 0 || x >= this->_width || y >= this->_height)
+	{
+		return;
+	}
+
+	int16_t t;
+	switch (this->rotation)
+	{
+	case 1:
+		t = x;
+		x = WIDTH - 1 - y;
+		y = t;
+		break;
+	case 2:
+		x = WIDTH - 1 - x;
+		y = HEIGHT - 1 - y;
+		break;
+	case 3:
+		t = x;
+		x = y;
+		y = HEIGHT - 1 - t;
+		break;
+	}
+
+	uint8_t *p = &this->buffer[x / 8 + y * ((WIDTH + 7) / 8)];
+	if (color)
+	{
+		*p |= 0x80 >> (x & 7);
+	}
+	else
+	{
+		*p &= ~(0x80 >> (x & 7));
+	}
+}
+
+void GFXcanvas1::fillScreen(uint16_t color)
+{
+	memset(this->buffer, color ? 0xff : 0x00, (WIDTH + 7) / 8 * HEIGHT);
+}
+
+bool GFXcanvas1::getPixel(int16_t x, int16_t y) const
+{
+	if (x < 0 || y < 0 || x >= this->_width || y >= this->_height)
+	{
+		return false;
+	}
+
+	int16_t t;
+	switch (this->rotation)
+	{
+	case 1:
+		t = x;
+		x = WIDTH - 1 - y;
+		y = t;
+		break;
+	case 2:
+		x = WIDTH - 1 - x;
+		y = HEIGHT - 1 - y;
+		break;
+	case 3:
+		t = x;
+		x = y;
+		y = HEIGHT - 1 - t;
+		break;
+	}
+
+	return this->buffer[x / 8 + y * ((WIDTH + 7) / 8)] & (0x80 >> (x & 7));
+}
@@ -0,0 +1,76 @@
+//
+// Adafruit GFX subset for the host build: the pixel level of GFXcanvas1
+// (rotation, clipping, buffer layout) and the primitives Frame overrides,
+// drawn pixel by pixel, so they serve as the reference of the faster Frame
+// versions. The built-in font has made up glyphs of the same size.
+//
+#ifndef HOST_ADAFRUIT_GFX_H_
+#define HOST_ADAFRUIT_GFX_H_
+
+#include <Arduino.h>
+
+typedef struct GFXfont GFXfont;
+
+class Adafruit_GFX : public Print
+{
+public:
+	Adafruit_GFX(int16_t w, int16_t h);
+
+	virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+	virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+	virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+	virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+	virtual void fillScreen(uint16_t color);
+	virtual void setRotation(uint8_t r);
+
+	void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+	void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size);
+	virtual size_t write(uint8_t c);
+
+	void setCursor(int16_t x, int16_t y);
+	void setTextColor(uint16_t c);
+	void setTextColor(uint16_t c, uint16_t bg);
+	void setTextSize(uint8_t s);
+	void setTextWrap(bool w);
+	void cp437(bool x = true);
+
+	int16_t width() const;
+	int16_t height() const;
+	uint8_t getRotation() const;
+	int16_t getCursorX() const;
+	int16_t getCursorY() const;
+
+protected:
+	int16_t WIDTH;
+	int16_t HEIGHT;
+	int16_t _width;
+	int16_t _height;
+	int16_t cursor_x;
+	int16_t cursor_y;
+	uint16_t textcolor;
+	uint16_t textbgcolor;
+	uint8_t textsize_x;
+	uint8_t textsize_y;
+	uint8_t rotation;
+	bool wrap;
+	bool _cp437;
+	GFXfont *gfxFont;
+};
+
+class GFXcanvas1 : public Adafruit_GFX
+{
+public:
+	GFXcanvas1(uint16_t w, uint16_t h);
+	~GFXcanvas1(void);
+
+	void drawPixel(int16_t x, int16_t y, uint16_t color);
+	void fillScreen(uint16_t color);
+	bool getPixel(int16_t x, int16_t y) const;
+	uint8_t *getBuffer(void) const { return buffer; }
+
+protected:
+	uint8_t *buffer;
+};
+
+#endif
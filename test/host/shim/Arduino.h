@@ -0,0 +1,88 @@
+//
+// Arduino core for the host build of the libraries
+//
+// Only what the libraries under lib/ use: types, pins (no-ops), clock,
+// Print and Stream. Arduino.h of the ESP32 core also brings FreeRTOS in,
+// so does this one.
+//
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define RTC_DATA_ATTR
+#define IRAM_ATTR
+#define PROGMEM
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr) (*(void *const *)(addr))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+// wall clock of the host
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+unsigned long millis();
+unsigned long micros();
+void yield();
+
+class Print
+{
+public:
+	virtual ~Print(void) {}
+
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+
+	size_t write(const char *text);
+	size_t print(const char *text);
+	size_t println(const char *text = "");
+	size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print
+{
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+	virtual void flush() {}
+};
+
+// standard output
+class HostSerial : public Stream
+{
+public:
+	void begin(unsigned long baud);
+	size_t write(uint8_t c);
+	int available();
+	int read();
+	int peek();
+};
+
+extern HostSerial Serial;
+
+#include "freertos/FreeRTOS.h"
+
+#endif
@@ -0,0 +1,25 @@
+//
+// SPI for the host build: nothing is connected, EPD runs on a test bus
+//
+#ifndef HOST_SPI_H_
+#define HOST_SPI_H_
+
+#include <Arduino.h>
+
+#define SPI_MODE0 0x00
+#define SPI_CLOCK_DIV4 4
+
+class SPIClass
+{
+public:
+	void begin() {}
+	void setBitOrder(uint8_t) {}
+	void setDataMode(uint8_t) {}
+	void setClockDivider(uint32_t) {}
+	uint8_t transfer(uint8_t) { return 0; }
+	void writeBytes(const uint8_t *, uint32_t) {}
+};
+
+extern SPIClass SPI;
+
+#endif
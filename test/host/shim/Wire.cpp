@@ -0,0 +1,62 @@
+//
+// I2C for the host build
+//
+
+#include <Wire.h>
+
+TwoWire Wire;
+
+TwoWire::TwoWire()
+{
+	memset(this->devices, 0, sizeof(this->devices));
+	this->address = 0;
+	this->length = 0;
+	this->position = 0;
+}
+
+void TwoWire::attach(uint8_t address, WireDevice *device)
+{
+	this->devices[address & (WIRE_DEVICES - 1)] = device;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+	this->address = address & (WIRE_DEVICES - 1);
+	this->length = 0;
+}
+
+size_t TwoWire::write(uint8_t c)
+{
+	if (this->length >= WIRE_BUFFER)
+	{
+		return 0;
+	}
+	this->bytes[this->length++] = c;
+	return 1;
+}
+
+// 0 for success, 2 for no acknowledge of the address as the ESP32 core
+uint8_t TwoWire::endTransmission()
+{
+	WireDevice *device = this->devices[this->address];
+	return device && device->receive(this->bytes, this->length) ? 0 : 2;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t length)
+{
+	WireDevice *device = this->devices[address & (WIRE_DEVICES - 1)];
+	length = length < WIRE_BUFFER ? length : WIRE_BUFFER;
+	this->length = device ? device->send(this->bytes, length) : 0;
+	this->position = 0;
+	return this->length;
+}
+
+int TwoWire::available()
+{
+	return this->length - this->position;
+}
+
+int TwoWire::read()
+{
+	return this->position < this->length ? this->bytes[this->position++] : -1;
+}
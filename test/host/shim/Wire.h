@@ -0,0 +1,50 @@
+//
+// I2C for the host build: devices are objects of the tests attached at
+// their address, nothing answers elsewhere
+//
+#ifndef HOST_WIRE_H_
+#define HOST_WIRE_H_
+
+#include <Arduino.h>
+
+class WireDevice
+{
+public:
+	virtual ~WireDevice() {}
+
+	// bytes of one write transaction, false for no acknowledge
+	virtual bool receive(const uint8_t *bytes, uint8_t length) = 0;
+
+	// fill a read transaction, the number of bytes sent
+	virtual uint8_t send(uint8_t *bytes, uint8_t length) = 0;
+};
+
+#define WIRE_DEVICES 128
+#define WIRE_BUFFER 32
+
+class TwoWire
+{
+public:
+	TwoWire();
+
+	void attach(uint8_t address, WireDevice *device);
+
+	void begin() {}
+	void beginTransmission(uint8_t address);
+	size_t write(uint8_t c);
+	uint8_t endTransmission();
+	uint8_t requestFrom(uint8_t address, uint8_t length);
+	int available();
+	int read();
+
+private:
+	WireDevice *devices[WIRE_DEVICES];
+	uint8_t address;
+	uint8_t bytes[WIRE_BUFFER];
+	uint8_t length;
+	uint8_t position;
+};
+
+extern TwoWire Wire;
+
+#endif
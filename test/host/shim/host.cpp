@@ -0,0 +1,274 @@
+//
+// Arduino core and FreeRTOS for the host build
+//
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+HostSerial Serial;
+SPIClass SPI;
+
+static const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+
+// pins
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+void digitalWrite(uint8_t, uint8_t)
+{
+}
+
+int digitalRead(uint8_t)
+{
+	return LOW;
+}
+
+// clock
+
+void delay(uint32_t ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us)
+{
+	std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+unsigned long millis()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - boot).count();
+}
+
+unsigned long micros()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot).count();
+}
+
+void yield()
+{
+	std::this_thread::yield();
+}
+
+// Print
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--)
+	{
+		n += this->write(*buffer++);
+	}
+	return n;
+}
+
+size_t Print::write(const char *text)
+{
+	return this->write((const uint8_t *)text, strlen(text));
+}
+
+size_t Print::print(const char *text)
+{
+	return this->write(text);
+}
+
+size_t Print::println(const char *text)
+{
+	return this->write(text) + this->write("\r\n");
+}
+
+size_t Print::printf(const char *format, ...)
+{
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	if (length < 0)
+	{
+		return 0;
+	}
+	return this->write((const uint8_t *)buffer, (size_t)length < sizeof(buffer) ? length : sizeof(buffer) - 1);
+}
+
+void HostSerial::begin(unsigned long)
+{
+}
+
+size_t HostSerial::write(uint8_t c)
+{
+	return 1 == fwrite(&c, 1, 1, stdout);
+}
+
+int HostSerial::available()
+{
+	return 0;
+}
+
+int HostSerial::read()
+{
+	return -1;
+}
+
+int HostSerial::peek()
+{
+	return -1;
+}
+
+// tasks
+
+struct host_task
+{
+	std::mutex mutex;
+	std::condition_variable wake;
+	uint32_t notified;
+	bool deleted;
+};
+
+// thrown into a deleted task to end its thread
+struct task_deleted
+{
+};
+
+static thread_local host_task *current_task = 0;
+
+static void run_task(host_task *task, TaskFunction_t code, void *parameter)
+{
+	current_task = task;
+	try
+	{
+		code(parameter);
+	}
+	catch (const task_deleted &)
+	{
+	}
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code,
+								   const char *,
+								   uint32_t,
+								   void *parameter,
+								   UBaseType_t,
+								   TaskHandle_t *created,
+								   BaseType_t)
+{
+	// never freed: a deleted task may still be on its way out
+	host_task *task = new host_task();
+	task->notified = 0;
+	task->deleted = false;
+
+	std::thread(run_task, task, code, parameter).detach();
+
+	if (created)
+	{
+		*created = task;
+	}
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+	if (0 == task)
+	{
+		throw task_deleted();
+	}
+	std::lock_guard<std::mutex> guard(task->mutex);
+	task->deleted = true;
+	task->wake.notify_all();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+	delay(ticks);
+}
+
+TickType_t xTaskGetTickCount()
+{
+	return millis();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+	host_task *task = current_task;
+	if (0 == task)
+	{
+		// not a task: nothing can notify it
+		delay(portMAX_DELAY == ticks ? 0 : ticks);
+		return 0;
+	}
+
+	std::unique_lock<std::mutex> guard(task->mutex);
+	std::chrono::steady_clock::time_point until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+	while (!task->deleted && 0 == task->notified)
+	{
+		if (portMAX_DELAY == ticks)
+		{
+			task->wake.wait(guard);
+		}
+		else if (std::cv_status::timeout == task->wake.wait_until(guard, until))
+		{
+			break;
+		}
+	}
+	if (task->deleted)
+	{
+		throw task_deleted();
+	}
+
+	uint32_t count = task->notified;
+	task->notified = clear ? 0 : (count ? count - 1 : 0);
+	return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+	std::lock_guard<std::mutex> guard(task->mutex);
+	++task->notified;
+	task->wake.notify_all();
+	return pdPASS;
+}
+
+// mutexes
+
+struct host_mutex
+{
+	std::timed_mutex mutex;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+	return new host_mutex();
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t mutex)
+{
+	delete mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+	if (portMAX_DELAY == ticks)
+	{
+		mutex->mutex.lock();
+		return pdTRUE;
+	}
+	return mutex->mutex.try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+	mutex->mutex.unlock();
+	return pdTRUE;
+}
+
+void taskYIELD()
+{
+	std::this_thread::yield();
+}
@@ -0,0 +1,48 @@
+//
+// Minimal test runner for the host build
+//
+//   TEST(suite, name)
+//   {
+//       CHECK(condition);
+//       CHECK_EQUAL(expected, actual);
+//   }
+//
+// A failed check is reported and the test goes on. host_tests runs every
+// test, or those of the suites given on the command line.
+//
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <Arduino.h>
+
+typedef void test_function(void);
+
+typedef struct test_case
+{
+	const char *suite;
+	const char *name;
+	test_function *run;
+	struct test_case *next;
+} test_case;
+
+// adds a test at static initialization, they run in that order
+struct test_registration
+{
+	test_registration(test_case &test);
+};
+
+void test_fail(const char *file, int line, const char *expression);
+void test_equal(const char *file, int line, const char *expression, long long expected, long long actual);
+
+#define TEST(suite, name)                                                          \
+	static void suite##_##name(void);                                              \
+	static test_case suite##_##name##_case = {#suite, #name, suite##_##name, 0};    \
+	static test_registration suite##_##name##_registration(suite##_##name##_case); \
+	static void suite##_##name(void)
+
+#define CHECK(condition) ((condition) ? (void)0 : test_fail(__FILE__, __LINE__, #condition))
+
+#define CHECK_EQUAL(expected, actual) \
+	test_equal(__FILE__, __LINE__, #actual, (long long)(expected), (long long)(actual))
+
+#endif
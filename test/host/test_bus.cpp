@@ -0,0 +1,379 @@
+//
+// COG protocol order on the recording bus
+//
+
+#include <Arduino.h>
+#include <EPD.h>
+
+#include <thread>
+#include <vector>
+
+#include "EPD_mock_bus.h"
+#include "test.h"
+
+#define PANEL_ON_PIN 1
+#define BORDER_PIN 2
+#define DISCHARGE_PIN 3
+#define RESET_PIN 4
+#define BUSY_PIN 5
+#define CS_PIN 6
+
+// one 0x70 index / 0x72 data pair
+typedef struct
+{
+	uint8_t index;
+	std::vector<uint8_t> data;
+	uint32_t time_us;
+} register_write;
+
+static std::vector<register_write> register_writes(EPD_MockBus &bus)
+{
+	std::vector<register_write> writes;
+	int16_t index = -1;
+	for (uint32_t i = 0; i < bus.getEventCount(); ++i)
+	{
+		const mock_event &event = bus.getEvent(i);
+		if (MOCK_TRANSFER != event.type || CS_PIN != event.pin || event.length < 2)
+		{
+			continue;
+		}
+		const uint8_t *bytes = bus.getBytes(event);
+		if (0x70 == bytes[0])
+		{
+			index = bytes[1];
+		}
+		else if (0x72 == bytes[0] && index >= 0)
+		{
+			register_write write;
+			write.index = index;
+			write.data.assign(bytes + 1, bytes + event.length);
+			write.time_us = event.time_us;
+			writes.push_back(write);
+			index = -1;
+		}
+	}
+	return writes;
+}
+
+static bool same(const register_write &write, uint8_t index, const uint8_t *data, uint8_t length)
+{
+	return write.index == index && write.data.size() == length && 0 == memcmp(&write.data[0], data, length);
+}
+
+// time of the first write of level to pin at or after from_us, -1 if none
+static int64_t pin_time(EPD_MockBus &bus, uint8_t pin, uint8_t level, int64_t from_us = 0)
+{
+	for (uint32_t i = 0; i < bus.getEventCount(); ++i)
+	{
+		const mock_event &event = bus.getEvent(i);
+		if (MOCK_PIN == event.type && pin == event.pin && level == event.value && event.time_us >= from_us)
+		{
+			return event.time_us;
+		}
+	}
+	return -1;
+}
+
+TEST(bus, power_on_sequence)
+{
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	bus.reset();
+	epd.clear();
+
+	// G1 COG power on of the 2.7", up to the first line
+	static const struct
+	{
+		uint8_t index;
+		uint8_t length;
+		uint8_t data[8];
+	} expected[] = {
+		{0x01, 8, {0x00, 0x00, 0x00, 0x7f, 0xff, 0xfe, 0x00, 0x00}}, // channel select
+		{0x06, 1, {0xff}},											 // DC/DC frequency
+		{0x07, 1, {0x9d}},											 // high power mode osc
+		{0x08, 1, {0x00}},											 // disable ADC
+		{0x09, 2, {0xd0, 0x00}},									 // Vcom level
+		{0x04, 1, {0x00}},											 // gate and source voltage levels
+		{0x03, 1, {0x01}},											 // driver latch on
+		{0x03, 1, {0x00}},											 // driver latch off
+		{0x05, 1, {0x01}},											 // charge pump positive voltage on
+		{0x05, 1, {0x03}},											 // charge pump negative voltage on
+		{0x05, 1, {0x0f}},											 // Vcom driver on
+		{0x02, 1, {0x24}},											 // output enable to disable
+		{0x04, 1, {0x00}},											 // first line: voltage levels
+	};
+
+	std::vector<register_write> writes = register_writes(bus);
+	CHECK(writes.size() > sizeof(expected) / sizeof(expected[0]));
+	for (uint8_t i = 0; i < sizeof(expected) / sizeof(expected[0]) && i < writes.size(); ++i)
+	{
+		CHECK(same(writes[i], expected[i].index, expected[i].data, expected[i].length));
+	}
+
+	// panel powered, then a reset pulse, before any register write
+	int64_t panel_on = pin_time(bus, PANEL_ON_PIN, HIGH);
+	int64_t reset_low = pin_time(bus, RESET_PIN, LOW, panel_on + 1);
+	int64_t reset_high = pin_time(bus, RESET_PIN, HIGH, reset_low);
+	CHECK(panel_on >= 0);
+	CHECK(reset_low >= panel_on + 5000);
+	CHECK(reset_high >= reset_low + 5000);
+	CHECK(writes.size() > 0 && writes[0].time_us >= reset_high);
+
+	// charge pumps settle before the Vcom driver and the output
+	CHECK(writes.size() > 11 && writes[10].time_us >= writes[9].time_us + 30000);
+	CHECK(writes.size() > 11 && writes[11].time_us >= writes[10].time_us + 30000);
+}
+
+TEST(bus, power_off_sequence)
+{
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	bus.reset();
+	epd.clear();
+
+	// G1 COG power off, after the dummy line
+	static const uint8_t expected[][2] = {
+		{0x02, 0x2f}, // output of the dummy line
+		{0x03, 0x01}, // latch reset turn on
+		{0x02, 0x05}, // output enable off
+		{0x05, 0x0e}, // Vcom power off
+		{0x05, 0x02}, // power off negative charge pump
+		{0x04, 0x0c}, // discharge
+		{0x05, 0x00}, // all charge pumps off
+		{0x07, 0x0d}, // turn off osc
+		{0x04, 0x50}, // discharge internal - 1
+		{0x04, 0xa0}, // discharge internal - 2
+		{0x04, 0x00}, // discharge internal - 3
+	};
+	uint8_t count = sizeof(expected) / sizeof(expected[0]);
+
+	std::vector<register_write> writes = register_writes(bus);
+	CHECK(writes.size() > count);
+	uint32_t first = writes.size() - count;
+	for (uint8_t i = 0; i < count && i < writes.size(); ++i)
+	{
+		CHECK(same(writes[first + i], expected[i][0], &expected[i][1], 1));
+	}
+
+	// the dummy line selects no scan line
+	CHECK(first >= 1 && 0x0a == writes[first - 1].index);
+
+	// then power and signals off, and the discharge pulse
+	int64_t panel_off = pin_time(bus, PANEL_ON_PIN, LOW, writes.back().time_us);
+	int64_t discharge = pin_time(bus, DISCHARGE_PIN, HIGH, panel_off);
+	int64_t discharged = pin_time(bus, DISCHARGE_PIN, LOW, discharge);
+	CHECK(panel_off >= 0);
+	CHECK(discharge >= panel_off);
+	CHECK(discharged >= discharge + 150000);
+}
+
+// a black image on a smaller panel: its COG settings, then blocks of its
+// line length with one scan line each, all of them driven
+static void small_panel(EPD_size size, const uint8_t *channel_select, uint8_t gate_source, bool filler)
+{
+	uint16_t height = EPD_HEIGHT(size);
+	uint16_t bytes_per_line = EPD_WIDTH(size) / 8;
+	uint16_t bytes_per_scan = height / 4;
+	uint16_t length = 2 * bytes_per_line + bytes_per_scan + (filler ? 1 : 0);
+
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(size, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	std::vector<uint8_t> image(EPD_IMAGE_BYTES(size), 0xff);
+	bus.reset();
+	epd.update(&image[0]);
+
+	std::vector<register_write> writes = register_writes(bus);
+	CHECK(writes.size() > 5 && same(writes[0], 0x01, channel_select, 8));
+	CHECK(writes.size() > 5 && same(writes[5], 0x04, &gate_source, 1));
+
+	std::vector<bool> selected(height, false);
+	uint32_t blocks = 0;
+	uint32_t bad_blocks = 0;
+	const register_write *last_line = 0;
+	for (uint32_t i = 0; i < writes.size(); ++i)
+	{
+		const std::vector<uint8_t> &data = writes[i].data;
+		if (0x0a != writes[i].index)
+		{
+			continue;
+		}
+		++blocks;
+		if (length != data.size() || (filler && 0x00 != data.back()))
+		{
+			++bad_blocks;
+			continue;
+		}
+
+		// at most one scan pair set, the dummy line has none
+		int16_t line = -1;
+		uint8_t pairs = 0;
+		for (uint16_t b = 0; b < bytes_per_scan; ++b)
+		{
+			uint8_t scan = data[bytes_per_line + b];
+			for (uint8_t k = 0; k < 4; ++k)
+			{
+				uint8_t pair = (scan >> (6 - 2 * k)) & 0x03;
+				pairs += 0 != pair;
+				line = 0x03 == pair ? 4 * b + k : line;
+			}
+		}
+		if (pairs > 1 || (1 == pairs && line < 0))
+		{
+			++bad_blocks;
+			continue;
+		}
+		if (line >= 0)
+		{
+			selected[line] = true;
+		}
+		if (line >= 0 && 0x55 != data[0])
+		{
+			last_line = &writes[i];
+		}
+	}
+	CHECK(blocks > 4U * height);
+	CHECK_EQUAL(0, bad_blocks);
+	CHECK(std::vector<bool>(height, true) == selected);
+
+	// the last line of the normal stage, before the dummy frame: black
+	// pixels around the last scan byte
+	CHECK(0 != last_line);
+	if (last_line)
+	{
+		const uint8_t *data = &last_line->data[0];
+		std::vector<uint8_t> black(bytes_per_line, 0xff);
+		CHECK(0 == memcmp(&black[0], data, bytes_per_line));
+		CHECK_EQUAL(0x03, data[bytes_per_line + bytes_per_scan - 1]);
+		CHECK(0 == memcmp(&black[0], data + bytes_per_line + bytes_per_scan, bytes_per_line));
+	}
+}
+
+TEST(bus, panel_1_44)
+{
+	static const uint8_t channel_select[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x0f, 0xff, 0x00};
+	small_panel(EPD_1_44, channel_select, 0x03, false);
+}
+
+TEST(bus, panel_2_0)
+{
+	static const uint8_t channel_select[] = {0x00, 0x00, 0x00, 0x00, 0x01, 0xff, 0xe0, 0x00};
+	small_panel(EPD_2_0, channel_select, 0x03, true);
+}
+
+TEST(bus, busy_is_waited_for)
+{
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	bus.setBusy(2000, 20);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	bus.reset();
+	epd.clear();
+
+	// nothing is sent before the COG is ready after reset
+	std::vector<register_write> writes = register_writes(bus);
+	int64_t reset_high = pin_time(bus, RESET_PIN, HIGH);
+	CHECK(writes.size() > 0 && writes[0].time_us >= reset_high + 2000);
+	CHECK(bus.getCounters().busy_reads > 0);
+
+	// CS stays low until each line block is latched
+	uint32_t blocks = 0;
+	for (uint32_t i = 0; i + 1 < bus.getEventCount(); ++i)
+	{
+		const mock_event &event = bus.getEvent(i);
+		if (MOCK_TRANSFER != event.type || event.length < 10)
+		{
+			continue;
+		}
+		uint32_t end_us = event.time_us + event.length * 2 + 20;
+		const mock_event &next = bus.getEvent(i + 1);
+		CHECK(MOCK_PIN == next.type && CS_PIN == next.pin && HIGH == next.value);
+		CHECK(next.time_us >= end_us);
+		++blocks;
+	}
+	CHECK(blocks > 0);
+}
+
+TEST(bus, telemetry_matches_the_wire)
+{
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+
+	static uint8_t image[EPD_IMAGE_BYTES(EPD_2_7)];
+	for (uint32_t i = 0; i < sizeof(image); ++i)
+	{
+		image[i] = i * 7;
+	}
+
+	bus.reset();
+	epd.update(image);
+	const epd_telemetry &telemetry = epd.getTelemetry();
+	CHECK_EQUAL(bus.getCounters().bytes, telemetry.spi_bytes);
+	// plus the single bytes at power on and off, CS is still low then
+	CHECK_EQUAL(bus.getCounters().transfers, telemetry.spi_transactions + 2);
+	CHECK(telemetry.refresh_us > 0 && telemetry.refresh_us <= bus.time_us());
+}
+
+TEST(bus, shared_bus_takes_turns)
+{
+	static uint8_t image[EPD_IMAGE_BYTES(EPD_2_7)];
+	for (uint32_t i = 0; i < sizeof(image); ++i)
+	{
+		image[i] = i * 7;
+	}
+
+	// alone first
+	EPD_MockBus single(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD alone(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, single);
+	alone.begin();
+	alone.update(image);
+	uint32_t alone_us = alone.getTelemetry().refresh_us;
+
+	// then with a second panel on the same bus
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	uint8_t second = bus.addPanel(CS_PIN + 10, BUSY_PIN + 10, RESET_PIN + 10);
+	EPD first_epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	EPD second_epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN + 10, BUSY_PIN + 10, CS_PIN + 10, bus);
+	first_epd.begin();
+	second_epd.begin();
+	bus.attach(0);
+	bus.attach(second);
+	bus.reset();
+
+	std::thread other([&]
+					  {
+		bus.use(second);
+		second_epd.update(image);
+		bus.detach(second); });
+	bus.use(0);
+	first_epd.update(image);
+	bus.detach(0);
+	other.join();
+
+	// the line transfers of the two panels alternate
+	uint32_t switches = 0;
+	uint8_t last_cs = MOCK_NO_PIN;
+	for (uint32_t i = 0; i < bus.getEventCount(); ++i)
+	{
+		const mock_event &event = bus.getEvent(i);
+		if (MOCK_TRANSFER != event.type || event.length < 10)
+		{
+			continue;
+		}
+		switches += MOCK_NO_PIN != last_cs && event.pin != last_cs;
+		last_cs = event.pin;
+	}
+	CHECK(switches > 1000);
+
+	// each refresh still fits its stage windows
+	CHECK(first_epd.getTelemetry().refresh_us < alone_us * 5 / 4);
+	CHECK(second_epd.getTelemetry().refresh_us < alone_us * 5 / 4);
+	for (uint8_t s = 0; s < 4; ++s)
+	{
+		CHECK(first_epd.getTelemetry().passes[s] > 1);
+		CHECK(second_epd.getTelemetry().passes[s] > 1);
+	}
+}
@@ -0,0 +1,154 @@
+//
+// Drive times of each stage on the COG emulator, and the under-drive and
+// ghosting reports of an update driven too short
+//
+
+#include <Arduino.h>
+#include <EPD.h>
+#include <EPD_emulator.h>
+
+#include <string>
+
+#include "test.h"
+
+#define PANEL_ON_PIN 1
+#define BORDER_PIN 2
+#define DISCHARGE_PIN 3
+#define RESET_PIN 4
+#define BUSY_PIN 5
+#define CS_PIN 6
+
+#define WIDTH EPD_WIDTH(EPD_2_7)
+#define HEIGHT EPD_HEIGHT(EPD_2_7)
+
+static uint8_t first_image[EPD_IMAGE_BYTES(EPD_2_7)];
+static uint8_t second_image[EPD_IMAGE_BYTES(EPD_2_7)];
+
+static void random_bytes(uint8_t *bytes, uint32_t length, uint32_t seed)
+{
+	for (uint32_t i = 0; i < length; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		bytes[i] = seed >> 16;
+	}
+}
+
+static bool black(const uint8_t *image, uint16_t x, uint16_t y)
+{
+	return image[(uint32_t)y * (WIDTH / 8) + x / 8] & (0x80 >> (x & 0x07));
+}
+
+// first then second image, the second at the given temperature
+static void two_updates(EPD_Emulator &cog, int16_t temperature)
+{
+	random_bytes(first_image, sizeof(first_image), 1);
+	random_bytes(second_image, sizeof(second_image), 2);
+
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, cog);
+	epd.begin();
+	epd.update(first_image);
+	epd.setFactor(temperature);
+	epd.update(second_image);
+}
+
+// shortest drive of a stage on the panel
+static uint32_t shortest(EPD_Emulator &cog)
+{
+	uint32_t us = 0xffffffff;
+	for (uint16_t y = 0; y < HEIGHT; ++y)
+	{
+		for (uint16_t x = 0; x < WIDTH; ++x)
+		{
+			for (uint8_t s = 0; s < cog.stages(); ++s)
+			{
+				uint32_t drive = cog.driveTime(x, y, s);
+				us = drive && drive < us ? drive : us;
+			}
+		}
+	}
+	return us;
+}
+
+class Capture : public Print
+{
+public:
+	std::string bytes;
+
+	size_t write(uint8_t c)
+	{
+		bytes += (char)c;
+		return 1;
+	}
+};
+
+TEST(emulator, drive_of_each_stage)
+{
+	EPD_Emulator cog(WIDTH, HEIGHT, CS_PIN, BUSY_PIN, PANEL_ON_PIN);
+	two_updates(cog, 25);
+	CHECK(0 == memcmp(cog.getImage(), second_image, sizeof(second_image)));
+	CHECK_EQUAL(4, cog.stages());
+
+	// compensate and normal drive every pixel, white only those white in
+	// the previous image and inverse those white in the new one
+	uint32_t mismatches = 0;
+	for (uint16_t y = 0; y < HEIGHT; ++y)
+	{
+		for (uint16_t x = 0; x < WIDTH; ++x)
+		{
+			mismatches += 0 == cog.driveTime(x, y, 0);
+			mismatches += black(first_image, x, y) == (0 != cog.driveTime(x, y, 1));
+			mismatches += black(second_image, x, y) == (0 != cog.driveTime(x, y, 2));
+			mismatches += 0 == cog.driveTime(x, y, 3);
+		}
+	}
+	CHECK_EQUAL(0, mismatches);
+	CHECK_EQUAL(0, cog.driveTime(0, 0, EPD_EMULATOR_STAGES));
+
+	uint32_t reference_us = shortest(cog);
+	CHECK(reference_us > 0);
+	CHECK_EQUAL(0, cog.underDriven(reference_us));
+	CHECK_EQUAL(0, cog.ghosting(reference_us));
+}
+
+TEST(emulator, short_drive_reported)
+{
+	uint32_t reference_us;
+	{
+		EPD_Emulator cog(WIDTH, HEIGHT, CS_PIN, BUSY_PIN, PANEL_ON_PIN);
+		two_updates(cog, 25);
+		reference_us = shortest(cog);
+	}
+
+	// hot panel: shorter stages than the reference, every pixel under
+	// driven and those changing color ghosting
+	EPD_Emulator cog(WIDTH, HEIGHT, CS_PIN, BUSY_PIN, PANEL_ON_PIN);
+	two_updates(cog, 60);
+	uint32_t changed = 0;
+	for (uint16_t y = 0; y < HEIGHT; ++y)
+	{
+		for (uint16_t x = 0; x < WIDTH; ++x)
+		{
+			changed += black(first_image, x, y) != black(second_image, x, y);
+		}
+	}
+	CHECK(shortest(cog) < reference_us);
+	CHECK_EQUAL((uint32_t)WIDTH * HEIGHT, cog.underDriven(reference_us));
+	CHECK_EQUAL(changed, cog.ghosting(reference_us));
+	CHECK_EQUAL(0, cog.underDriven(shortest(cog)));
+
+	// gray in proportion to the shortest stage
+	Capture report;
+	cog.writeReport(report, reference_us);
+	std::string header = "P5\n264 176\n255\n";
+	CHECK_EQUAL(header.size() + (uint32_t)WIDTH * HEIGHT, report.bytes.size());
+	CHECK(0 == report.bytes.compare(0, header.size(), header));
+	uint32_t first_pixel_us = 0xffffffff;
+	for (uint8_t s = 0; s < cog.stages(); ++s)
+	{
+		uint32_t drive = cog.driveTime(0, 0, s);
+		first_pixel_us = drive && drive < first_pixel_us ? drive : first_pixel_us;
+	}
+	uint8_t gray = (uint64_t)first_pixel_us * 255 / reference_us;
+	CHECK_EQUAL(gray, (uint8_t)report.bytes[header.size()]);
+	CHECK(gray > 0 && gray < 255);
+}
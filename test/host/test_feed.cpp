@@ -0,0 +1,146 @@
+//
+// Data server responses pushed through WXFeed in chunks of any size
+//
+
+#include <Arduino.h>
+#include <METAR.h>
+#include <WXFeed.h>
+
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+// recorded responses, FIXTURE_DIR is set by the build
+static std::string load(const char *name)
+{
+	std::string path = std::string(FIXTURE_DIR) + "/" + name;
+	std::string body;
+	FILE *file = fopen(path.c_str(), "rb");
+	CHECK(0 != file);
+	if (file)
+	{
+		char buffer[512];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		{
+			body.append(buffer, n);
+		}
+		fclose(file);
+	}
+	return body;
+}
+
+typedef struct
+{
+	const char *station;
+	std::string text;
+} received;
+
+static void collect(const char *station, const char *text, uint16_t length, void *context)
+{
+	std::vector<received> &reports = *(std::vector<received> *)context;
+	CHECK_EQUAL(length, strlen(text));
+	received report = {station, std::string(text, length)};
+	reports.push_back(report);
+}
+
+static void push(WXFeed &feed, const std::string &body, size_t chunk)
+{
+	for (size_t i = 0; i < body.size(); i += chunk)
+	{
+		size_t n = body.size() - i < chunk ? body.size() - i : chunk;
+		CHECK_EQUAL(n, feed.write((const uint8_t *)body.data() + i, n));
+	}
+}
+
+static const char *const stations[] = {"LFLY", "LFLS"};
+
+TEST(feed, reports_of_the_stations)
+{
+	std::string body = load("metars.xml");
+	static const size_t chunks[] = {1, 3, 64, 1460, 100000};
+	for (uint8_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c)
+	{
+		std::vector<received> reports;
+		WXFeed feed(stations, 2, collect, &reports);
+		push(feed, body, chunks[c]);
+
+		// LFLL and LFPG are not asked for
+		CHECK_EQUAL(2, reports.size());
+		if (2 != reports.size())
+		{
+			continue;
+		}
+		CHECK(stations[0] == reports[0].station);
+		CHECK(reports[0].text == "LFLY 171130Z 33007KT 290V360 CAVOK 16/06 Q1021 NOSIG");
+		CHECK(stations[1] == reports[1].station);
+		CHECK(reports[1].text == "LFLS 171130Z 01005KT 330V050 9999 SCT035 BKN120 12/04 Q1022");
+
+		static metar report;
+		CHECK(metar_decode(reports[1].text.c_str(), reports[1].text.size(), report));
+		CHECK_EQUAL(1022, report.qnh);
+	}
+}
+
+TEST(feed, forecast_over_several_lines)
+{
+	static const char *const lyon[] = {"LFLL"};
+	std::vector<received> reports;
+	WXFeed feed(lyon, 1, collect, &reports);
+	push(feed, load("tafs.xml"), 128);
+
+	// after TAF AMD, and the line break kept for the decoder
+	CHECK_EQUAL(1, reports.size());
+	static taf report;
+	if (1 == reports.size())
+	{
+		CHECK(std::string::npos != reports[0].text.find('\n'));
+		CHECK(taf_decode(reports[0].text.c_str(), reports[0].text.size(), report));
+		CHECK(report.amended);
+		CHECK_EQUAL(2, report.group_count);
+		CHECK_EQUAL(800, report.groups[1].conditions.clouds[0].base);
+	}
+}
+
+TEST(feed, entities)
+{
+	std::vector<received> reports;
+	WXFeed feed(stations, 2, collect, &reports);
+	push(feed, "<raw_text>LFLY 171130Z RMK A&amp;B &lt;1&gt; &unknown;</raw_text>", 5);
+	CHECK_EQUAL(1, reports.size());
+	CHECK(1 == reports.size() && reports[0].text == "LFLY 171130Z RMK A&B <1> ");
+}
+
+TEST(feed, bounded_memory)
+{
+	std::vector<received> reports;
+	WXFeed feed(stations, 2, collect, &reports);
+
+	// a report that does not fit is dropped, not truncated
+	std::string body = "<data><raw_text>LFLY 171130Z";
+	while (body.size() < 2 * WXFEED_TEXT_SIZE)
+	{
+		body += " 9999";
+	}
+	body += "</raw_text><raw_text>LFLS 171130Z 9999</raw_text></data>";
+	push(feed, body, 256);
+	CHECK_EQUAL(1, reports.size());
+	CHECK(1 == reports.size() && stations[1] == reports[0].station);
+
+	// the buffer is the feed, whatever the response size
+	CHECK(sizeof(WXFeed) < WXFEED_TEXT_SIZE + 128);
+}
+
+TEST(feed, empty_and_partial_documents)
+{
+	std::vector<received> reports;
+	WXFeed feed(stations, 2, collect, &reports);
+	push(feed, "<raw_text/><raw_text />LFLY 171130Z<raw_text>", 1);
+
+	// a response cut short, then the next one
+	feed.reset();
+	push(feed, "</raw_text><raw_text>LFLS 171130Z 9999</raw_text>", 7);
+	CHECK_EQUAL(1, reports.size());
+	CHECK(1 == reports.size() && reports[0].text == "LFLS 171130Z 9999");
+}
@@ -0,0 +1,267 @@
+//
+// Frame span primitives against GFXcanvas1 drawing pixel by pixel, in
+// every rotation, and the damaged area covering what they change
+//
+
+#include <Arduino.h>
+#include <frame.h>
+
+#include <vector>
+
+#include "test.h"
+
+static uint32_t seed;
+
+static int16_t random_in(int16_t low, int16_t high)
+{
+	seed = seed * 1103515245 + 12345;
+	return low + (int16_t)((seed >> 8) % (uint32_t)(high - low + 1));
+}
+
+static uint32_t buffer_bytes(GFXcanvas1 &canvas)
+{
+	uint8_t rotation = canvas.getRotation();
+	canvas.setRotation(0);
+	uint32_t bytes = (canvas.width() + 7) / 8 * canvas.height();
+	canvas.setRotation(rotation);
+	return bytes;
+}
+
+// the damaged rectangle holds every buffer pixel that changed
+static bool damage_covers(Frame &frame, const std::vector<uint8_t> &before)
+{
+	int16_t x, y, w, h;
+	frame.getDirtyRect(x, y, w, h);
+	uint8_t rotation = frame.getRotation();
+	frame.setRotation(0);
+	uint16_t bytes_per_row = (frame.width() + 7) / 8;
+	frame.setRotation(rotation);
+
+	const uint8_t *after = frame.getBuffer();
+	for (uint32_t i = 0; i < before.size(); ++i)
+	{
+		uint8_t changed = before[i] ^ after[i];
+		for (uint8_t bit = 0; bit < 8; ++bit)
+		{
+			int16_t px = (i % bytes_per_row) * 8 + bit;
+			int16_t py = i / bytes_per_row;
+			if ((changed & (0x80 >> bit)) && (px < x || px >= x + w || py < y || py >= y + h))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// a negative size extends left or up from x, y, as in Frame
+static void reference_fill(GFXcanvas1 &canvas, int16_t x, int16_t y, int16_t w, int16_t h, int16_t color, bool invert)
+{
+	if (w < 0)
+	{
+		x += w + 1;
+		w = -w;
+	}
+	if (h < 0)
+	{
+		y += h + 1;
+		h = -h;
+	}
+	for (int16_t j = y; j < y + h; ++j)
+	{
+		for (int16_t i = x; i < x + w; ++i)
+		{
+			canvas.drawPixel(i, j, invert ? !canvas.getPixel(i, j) : color);
+		}
+	}
+}
+
+// the pixels whose source and destination are both on the display
+static void reference_copy(GFXcanvas1 &canvas, int16_t sx, int16_t sy, int16_t w, int16_t h, int16_t dx, int16_t dy)
+{
+	std::vector<uint8_t> pixels(w * h);
+	for (int16_t j = 0; j < h; ++j)
+	{
+		for (int16_t i = 0; i < w; ++i)
+		{
+			pixels[j * w + i] = canvas.getPixel(sx + i, sy + j);
+		}
+	}
+	for (int16_t j = 0; j < h; ++j)
+	{
+		for (int16_t i = 0; i < w; ++i)
+		{
+			bool inside = sx + i >= 0 && sy + j >= 0 && sx + i < canvas.width() && sy + j < canvas.height();
+			if (inside)
+			{
+				canvas.drawPixel(dx + i, dy + j, pixels[j * w + i]);
+			}
+		}
+	}
+}
+
+static void reference_span(GFXcanvas1 &canvas, int16_t x, int16_t y, const uint8_t *bits, int16_t w, uint16_t color)
+{
+	for (int16_t i = 0; i < w; ++i)
+	{
+		if (bits[i / 8] & (0x80 >> (i & 7)))
+		{
+			canvas.drawPixel(x + i, y, color);
+		}
+	}
+}
+
+// random primitives on both, the buffers compared after each
+static void random_drawing(uint16_t width, uint16_t height, uint8_t rotation, uint32_t operations)
+{
+	Frame frame(width, height);
+	GFXcanvas1 reference(width, height);
+	frame.setRotation(rotation);
+	reference.setRotation(rotation);
+	frame.clear();
+	reference.fillScreen(0);
+	uint32_t bytes = buffer_bytes(reference);
+
+	int16_t w = frame.width();
+	int16_t h = frame.height();
+	uint32_t mismatches = 0;
+	uint32_t uncovered = 0;
+	for (uint32_t n = 0; n < operations; ++n)
+	{
+		std::vector<uint8_t> before(frame.getBuffer(), frame.getBuffer() + bytes);
+		frame.clearDirty();
+
+		int16_t x = random_in(-20, w + 10);
+		int16_t y = random_in(-20, h + 10);
+		int16_t rw = random_in(-40, w / 2);
+		int16_t rh = random_in(-40, h / 2);
+		uint16_t color = random_in(0, 1);
+		switch (random_in(0, 5))
+		{
+		case 0:
+			frame.fillRect(x, y, rw, rh, color);
+			reference_fill(reference, x, y, rw, rh, color, false);
+			break;
+		case 1:
+			frame.drawFastHLine(x, y, rw, color);
+			reference_fill(reference, x, y, rw, 1, color, false);
+			break;
+		case 2:
+			frame.drawFastVLine(x, y, rh, color);
+			reference_fill(reference, x, y, 1, rh, color, false);
+			break;
+		case 3:
+			frame.invertRect(x, y, rw, rh);
+			reference_fill(reference, x, y, rw, rh, 0, true);
+			break;
+		case 4:
+		{
+			int16_t cw = random_in(1, w / 2);
+			int16_t ch = random_in(1, h / 2);
+			int16_t dx = x + random_in(-12, 12);
+			int16_t dy = y + random_in(-12, 12);
+			frame.copyRect(x, y, cw, ch, dx, dy);
+			reference_copy(reference, x, y, cw, ch, dx, dy);
+			break;
+		}
+		default:
+		{
+			uint8_t bits[16];
+			for (uint8_t i = 0; i < sizeof(bits); ++i)
+			{
+				bits[i] = random_in(0, 255);
+			}
+			int16_t sw = random_in(1, 8 * sizeof(bits));
+			frame.drawSpan(x, y, bits, sw, color);
+			reference_span(reference, x, y, bits, sw, color);
+			break;
+		}
+		}
+
+		mismatches += 0 != memcmp(frame.getBuffer(), reference.getBuffer(), bytes);
+		uncovered += !damage_covers(frame, before);
+		if (mismatches)
+		{
+			break;
+		}
+	}
+	CHECK_EQUAL(0, mismatches);
+	CHECK_EQUAL(0, uncovered);
+}
+
+TEST(frame, spans_match_pixels)
+{
+	seed = 1;
+	for (uint8_t rotation = 0; rotation < 4; ++rotation)
+	{
+		random_drawing(264, 176, rotation, 400);
+	}
+}
+
+TEST(frame, spans_match_pixels_odd_width)
+{
+	// rows neither word nor byte aligned
+	seed = 2;
+	for (uint8_t rotation = 0; rotation < 4; ++rotation)
+	{
+		random_drawing(101, 37, rotation, 400);
+	}
+}
+
+TEST(frame, overlapping_copies)
+{
+	Frame frame(264, 176);
+	GFXcanvas1 reference(264, 176);
+	seed = 3;
+	for (int16_t y = 0; y < 176; ++y)
+	{
+		for (int16_t x = 0; x < 264; ++x)
+		{
+			uint16_t color = random_in(0, 1);
+			frame.drawPixel(x, y, color);
+			reference.drawPixel(x, y, color);
+		}
+	}
+
+	// by less than a byte and by more than a chunk, in each direction
+	static const int16_t moves[][2] = {{3, 0}, {-3, 0}, {0, 5}, {0, -5}, {7, 9}, {-70, -1}, {70, 2}};
+	for (uint8_t m = 0; m < sizeof(moves) / sizeof(moves[0]); ++m)
+	{
+		frame.copyRect(20, 30, 150, 80, 20 + moves[m][0], 30 + moves[m][1]);
+		reference_copy(reference, 20, 30, 150, 80, 20 + moves[m][0], 30 + moves[m][1]);
+		CHECK(0 == memcmp(frame.getBuffer(), reference.getBuffer(), 33 * 176));
+	}
+}
+
+TEST(frame, text_matches_glyphs)
+{
+	Frame frame(264, 176);
+	GFXcanvas1 reference(264, 176);
+	frame.clear();
+	reference.fillScreen(0);
+
+	// transparent then opaque, at every bit offset and over the right edge
+	static const char text[] = "LFLY 171130Z 33007KT CAVOK 16/06 Q1021 NOSIG";
+	for (uint8_t x = 0; x < 8; ++x)
+	{
+		for (uint8_t opaque = 0; opaque < 2; ++opaque)
+		{
+			int16_t y = x * 20 + opaque * 10;
+			frame.setCursor(x, y);
+			reference.setCursor(x, y);
+			if (opaque)
+			{
+				frame.setTextColor(BLACK, WHITE);
+				reference.setTextColor(BLACK, WHITE);
+			}
+			else
+			{
+				frame.setTextColor(BLACK);
+				reference.setTextColor(BLACK);
+			}
+			frame.print(text);
+			reference.print(text);
+		}
+	}
+	CHECK(0 == memcmp(frame.getBuffer(), reference.getBuffer(), 33 * 176));
+}
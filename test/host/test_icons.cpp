@@ -0,0 +1,140 @@
+//
+// Packed icons decoded against their art in tools/icons.txt
+//
+
+#include <Arduino.h>
+#include <Icons.h>
+
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+typedef struct
+{
+	std::string name;
+	std::vector<std::string> rows;
+} art;
+
+// same rules as tools/iconpack.py, ICON_ART is set by the build
+static std::vector<art> read_art()
+{
+	std::vector<art> icons;
+	FILE *file = fopen(ICON_ART, "r");
+	CHECK(0 != file);
+	if (!file)
+	{
+		return icons;
+	}
+	char buffer[300];
+	while (fgets(buffer, sizeof(buffer), file))
+	{
+		std::string line(buffer);
+		line.erase(line.find_last_not_of(" \t\r\n") + 1);
+		line.erase(0, line.find_first_not_of(" \t"));
+		if (line.empty() || ';' == line[0])
+		{
+			continue;
+		}
+		if (0 == line.compare(0, 5, "icon "))
+		{
+			art picture;
+			picture.name = line.substr(5);
+			icons.push_back(picture);
+		}
+		else if (!icons.empty())
+		{
+			icons.back().rows.push_back(line);
+		}
+	}
+	fclose(file);
+	return icons;
+}
+
+// the icon drawn at (x, y) on a white or black frame shows the art
+static bool matches(const art &picture, icon id, int16_t x, int16_t y, uint16_t color)
+{
+	Frame frame(100, 60);
+	frame.fillScreen(!color);
+	icon_draw(frame, id, x, y, color);
+	for (int16_t j = 0; j < frame.height(); ++j)
+	{
+		for (int16_t i = 0; i < frame.width(); ++i)
+		{
+			int16_t row = j - y;
+			int16_t column = i - x;
+			bool inside = row >= 0 && column >= 0 && row < (int16_t)picture.rows.size() &&
+						  column < (int16_t)picture.rows[row].size();
+			bool drawn = inside && '#' == picture.rows[row][column];
+			if (frame.getPixel(i, j) != (drawn ? color : !color))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+TEST(icons, decode_matches_art)
+{
+	std::vector<art> icons = read_art();
+	CHECK_EQUAL(ICON_COUNT, icons.size());
+
+	for (uint8_t id = 0; id < ICON_COUNT && id < icons.size(); ++id)
+	{
+		const art &picture = icons[id];
+		uint8_t width, height;
+		CHECK(icon_size((icon)id, width, height));
+		CHECK_EQUAL(picture.rows[0].size(), width);
+		CHECK_EQUAL(picture.rows.size(), height);
+
+		// at every bit offset, across the edges, and in white
+		bool same = true;
+		for (int16_t x = 0; x < 8; ++x)
+		{
+			same = same && matches(picture, (icon)id, x, 3, BLACK);
+		}
+		same = same && matches(picture, (icon)id, -5, -3, BLACK);
+		same = same && matches(picture, (icon)id, 100 - width / 2, 60 - height / 2, BLACK);
+		same = same && matches(picture, (icon)id, 11, 7, WHITE);
+		CHECK(same);
+		if (!same)
+		{
+			printf("  icon %s\n", picture.name.c_str());
+		}
+	}
+
+	uint8_t width, height;
+	CHECK(!icon_size(ICON_COUNT, width, height));
+}
+
+TEST(icons, report_groups)
+{
+	CHECK_EQUAL(ICON_BKN, icon_cover(WX_BKN));
+	CHECK_EQUAL(ICON_SKC, icon_cover(WX_NSC));
+	CHECK_EQUAL(ICON_COUNT, icon_cover(WX_NONE));
+
+	wx_wind wind = {360, 10, 0, -1, -1};
+	CHECK_EQUAL(ICON_WIND_N, icon_wind(wind));
+	wind.direction = 22;
+	CHECK_EQUAL(ICON_WIND_N, icon_wind(wind));
+	wind.direction = 23;
+	CHECK_EQUAL(ICON_WIND_NE, icon_wind(wind));
+	wind.direction = 240;
+	CHECK_EQUAL(ICON_WIND_SW, icon_wind(wind));
+	wind.direction = WX_VRB;
+	CHECK_EQUAL(ICON_COUNT, icon_wind(wind));
+	wind.direction = 240;
+	wind.speed = 0;
+	CHECK_EQUAL(ICON_COUNT, icon_wind(wind));
+
+	wx_text weather = {"+TSRA", 5};
+	CHECK_EQUAL(ICON_TS, icon_weather(weather));
+	weather.text = "-SHRA";
+	CHECK_EQUAL(ICON_SH, icon_weather(weather));
+	weather.text = "BR";
+	weather.length = 2;
+	CHECK_EQUAL(ICON_FG, icon_weather(weather));
+	weather.text = "VA";
+	CHECK_EQUAL(ICON_COUNT, icon_weather(weather));
+}
@@ -0,0 +1,124 @@
+//
+// LM75A sampling and filter on a simulated sensor, a sensor object per
+// wake-up as after deep sleep
+//
+
+#include <Arduino.h>
+#include <LM75A.h>
+#include <Wire.h>
+
+#include "test.h"
+
+#define LM75A_ADDRESS 0x49
+
+// temperature in 1/8 degree, converting unless shut down
+class FakeLM75A : public WireDevice
+{
+public:
+	int16_t eighths;
+	bool off;
+	uint32_t samples;
+
+	FakeLM75A() : eighths(0), off(false), samples(0), pointer(0) {}
+
+	bool receive(const uint8_t *bytes, uint8_t length)
+	{
+		if (length > 0)
+		{
+			pointer = bytes[0];
+		}
+		if (length > 1 && 0x01 == pointer)
+		{
+			off = bytes[1] & 0x01;
+		}
+		return true;
+	}
+
+	uint8_t send(uint8_t *bytes, uint8_t length)
+	{
+		if (0x00 != pointer || length < 2)
+		{
+			return 0;
+		}
+		++samples;
+		uint16_t raw = (uint16_t)(eighths << 5);
+		bytes[0] = raw >> 8;
+		bytes[1] = raw;
+		return 2;
+	}
+
+private:
+	uint8_t pointer;
+};
+
+// tenths the driver reads for a temperature
+static int16_t tenths(int16_t eighths)
+{
+	return (int32_t)eighths * 10 / 8;
+}
+
+static void wake(FakeLM75A &fake)
+{
+	LM75A_Class sensor;
+	sensor.begin();
+	sensor.wait();
+	sensor.end();
+	CHECK(fake.off);
+}
+
+// the filter is kept across wake-ups, these tests run in order
+TEST(lm75a, first_sample_as_is)
+{
+	FakeLM75A fake;
+	Wire.attach(LM75A_ADDRESS, &fake);
+	fake.eighths = 160;
+
+	LM75A_Class sensor;
+	CHECK_EQUAL(LM75A_NO_SAMPLE, sensor.temperature());
+	sensor.begin();
+	sensor.wait();
+	CHECK_EQUAL(200, sensor.temperature());
+	sensor.end();
+	CHECK(fake.off);
+	Wire.attach(LM75A_ADDRESS, 0);
+}
+
+TEST(lm75a, filter_converges_both_ways)
+{
+	FakeLM75A fake;
+	Wire.attach(LM75A_ADDRESS, &fake);
+
+	// steps smaller than the filter weight are not lost, warming or cooling
+	static const int16_t targets[] = {163, 159};
+	for (uint8_t t = 0; t < 2; ++t)
+	{
+		fake.eighths = targets[t];
+		int16_t previous = LM75A_Class().temperature();
+		for (uint8_t i = 0; i < 12; ++i)
+		{
+			wake(fake);
+			int16_t now = LM75A_Class().temperature();
+			CHECK(t ? now <= previous : now >= previous);
+			previous = now;
+		}
+		CHECK_EQUAL(tenths(targets[t]), previous);
+	}
+	Wire.attach(LM75A_ADDRESS, 0);
+}
+
+TEST(lm75a, sampled_and_shut_down_before_sleep)
+{
+	FakeLM75A fake;
+	Wire.attach(LM75A_ADDRESS, &fake);
+	fake.eighths = 159;
+
+	// a wake-up without waiting for the sample still takes it
+	LM75A_Class sensor;
+	sensor.begin();
+	CHECK(!fake.off);
+	sensor.end();
+	CHECK_EQUAL(1, fake.samples);
+	CHECK(fake.off);
+	CHECK(sensor.age() < 1000);
+	Wire.attach(LM75A_ADDRESS, 0);
+}
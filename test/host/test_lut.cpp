@@ -0,0 +1,425 @@
+//
+// Line encoding through the stage lookup tables against the bit by bit
+// encoder of the original Pervasive Displays driver
+//
+
+#include <Arduino.h>
+#include <EPD.h>
+
+#include <vector>
+
+#include "EPD_mock_bus.h"
+#include "test.h"
+
+#define PANEL_ON_PIN 1
+#define BORDER_PIN 2
+#define DISCHARGE_PIN 3
+#define RESET_PIN 4
+#define BUSY_PIN 5
+#define CS_PIN 6
+
+#define WIDTH EPD_WIDTH(EPD_2_7)
+#define HEIGHT EPD_HEIGHT(EPD_2_7)
+#define BYTES_PER_LINE (WIDTH / 8)
+#define BYTES_PER_SCAN (HEIGHT / 4)
+
+// 0x72, even pixels, scan, odd pixels, filler
+#define BLOCK_LENGTH (1 + 2 * BYTES_PER_LINE + BYTES_PER_SCAN + 1)
+
+// EPD::line() before the tables, data 0 for fixed_value
+static void reference_line(uint16_t line, const uint8_t *data, uint8_t fixed_value, stage stage, uint8_t *block)
+{
+	uint8_t *p = block;
+	*p++ = 0x72;
+
+	for (uint16_t b = BYTES_PER_LINE; b > 0; --b)
+	{
+		if (0 != data)
+		{
+			uint8_t pixels = data[b - 1] & 0x55;
+			switch (stage)
+			{
+			case EPD_compensate:
+				pixels = 0xaa | (pixels ^ 0x55);
+				break;
+			case EPD_white:
+				pixels = 0x55 + (pixels ^ 0x55);
+				break;
+			case EPD_inverse:
+				pixels = 0x55 | ((pixels ^ 0x55) << 1);
+				break;
+			case EPD_normal:
+				pixels = 0xaa | pixels;
+				break;
+			}
+			uint8_t p1 = (pixels >> 0) & 0x03;
+			uint8_t p2 = (pixels >> 2) & 0x03;
+			uint8_t p3 = (pixels >> 4) & 0x03;
+			uint8_t p4 = (pixels >> 6) & 0x03;
+			*p++ = (p1 << 6) | (p2 << 4) | (p3 << 2) | (p4 << 0);
+		}
+		else
+		{
+			*p++ = fixed_value;
+		}
+	}
+
+	for (uint16_t b = 0; b < BYTES_PER_SCAN; ++b)
+	{
+		*p++ = line / 4 == b ? 0xc0 >> (2 * (line & 0x03)) : 0x00;
+	}
+
+	for (uint16_t b = 0; b < BYTES_PER_LINE; ++b)
+	{
+		if (0 != data)
+		{
+			uint8_t pixels = data[b] & 0xaa;
+			switch (stage)
+			{
+			case EPD_compensate:
+				pixels = 0xaa | ((pixels ^ 0xaa) >> 1);
+				break;
+			case EPD_white:
+				pixels = 0x55 + ((pixels ^ 0xaa) >> 1);
+				break;
+			case EPD_inverse:
+				pixels = 0x55 | (pixels ^ 0xaa);
+				break;
+			case EPD_normal:
+				pixels = 0xaa | (pixels >> 1);
+				break;
+			}
+			*p++ = pixels;
+		}
+		else
+		{
+			*p++ = fixed_value;
+		}
+	}
+
+	*p++ = 0x00;
+}
+
+// line data blocks sent to the COG (register 0x0a), in order
+static std::vector<const uint8_t *> line_blocks(EPD_MockBus &bus)
+{
+	std::vector<const uint8_t *> blocks;
+	bool data = false;
+	for (uint32_t i = 0; i < bus.getEventCount(); ++i)
+	{
+		const mock_event &event = bus.getEvent(i);
+		if (MOCK_TRANSFER != event.type || CS_PIN != event.pin)
+		{
+			continue;
+		}
+		const uint8_t *bytes = bus.getBytes(event);
+		if (data && BLOCK_LENGTH == event.length)
+		{
+			blocks.push_back(bytes);
+		}
+		data = 2 == event.length && 0x70 == bytes[0] && 0x0a == bytes[1];
+	}
+	return blocks;
+}
+
+// scan line selected by a block, -1 for none (dummy line)
+static int16_t block_line(const uint8_t *block)
+{
+	const uint8_t *scan = block + 1 + BYTES_PER_LINE;
+	for (uint16_t b = 0; b < BYTES_PER_SCAN; ++b)
+	{
+		for (uint8_t k = 0; k < 4; ++k)
+		{
+			if (scan[b] == 0xc0 >> (2 * k))
+			{
+				return b * 4 + k;
+			}
+		}
+	}
+	return -1;
+}
+
+static void random_bytes(uint8_t *bytes, uint32_t length, uint32_t seed)
+{
+	for (uint32_t i = 0; i < length; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		bytes[i] = seed >> 16;
+	}
+}
+
+// every block of an update from previous to next equals the reference
+// encoding of one stage, stages in order and lines only in the range,
+// then the dummy frame and line of the power off
+static void check_update(EPD_MockBus &bus, const uint8_t *previous, const uint8_t *next, uint16_t first_line, uint16_t last_line)
+{
+	std::vector<const uint8_t *> blocks = line_blocks(bus);
+	uint8_t reference[BLOCK_LENGTH];
+	uint8_t current = EPD_compensate;
+	uint32_t seen[4] = {0, 0, 0, 0};
+	uint32_t mismatches = 0;
+	uint32_t outside = 0;
+
+	CHECK(blocks.size() > HEIGHT + 1);
+	uint32_t stages = blocks.size() > HEIGHT + 1 ? blocks.size() - HEIGHT - 1 : 0;
+	for (uint32_t i = 0; i < stages; ++i)
+	{
+		int16_t line = block_line(blocks[i]);
+		if (line < first_line || line > last_line)
+		{
+			++outside;
+			continue;
+		}
+
+		// the stage of this block, the current one or a later one
+		bool found = false;
+		for (uint8_t s = current; s <= EPD_normal && !found; ++s)
+		{
+			const uint8_t *image = s <= EPD_white ? previous : next;
+			reference_line(line, &image[line * BYTES_PER_LINE], 0, (stage)s, reference);
+			if (0 == memcmp(reference, blocks[i], BLOCK_LENGTH))
+			{
+				current = s;
+				++seen[s];
+				found = true;
+			}
+		}
+		mismatches += !found;
+	}
+
+	// whole passes of each stage
+	CHECK_EQUAL(0, mismatches);
+	CHECK_EQUAL(0, outside);
+	for (uint8_t s = 0; s < 4; ++s)
+	{
+		CHECK(seen[s] > 0);
+		CHECK_EQUAL(0, seen[s] % (last_line - first_line + 1));
+	}
+
+	// nothing driven at the power off
+	for (uint32_t i = stages; i < blocks.size(); ++i)
+	{
+		int16_t line = block_line(blocks[i]);
+		reference_line(line < 0 ? 0x7fff : line, 0, 0x55, EPD_normal, reference);
+		mismatches += 0 != memcmp(reference, blocks[i], BLOCK_LENGTH);
+	}
+	CHECK_EQUAL(0, mismatches);
+	CHECK(blocks.size() > 0 && block_line(blocks.back()) < 0);
+}
+
+static void update_test(bool cache)
+{
+	static uint8_t previous[EPD_IMAGE_BYTES(EPD_2_7)];
+	static uint8_t next[EPD_IMAGE_BYTES(EPD_2_7)];
+	random_bytes(previous, sizeof(previous), 1);
+	random_bytes(next, sizeof(next), 2);
+
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	epd.setLineCache(cache);
+	epd.restore(previous);
+
+	bus.reset();
+	epd.update(next);
+	check_update(bus, previous, next, 0, HEIGHT - 1);
+
+	// again, from the cache if it is on
+	bus.reset();
+	epd.update(previous);
+	check_update(bus, next, previous, 0, HEIGHT - 1);
+}
+
+TEST(lut, update_matches_reference)
+{
+	update_test(false);
+}
+
+TEST(lut, cached_update_matches_reference)
+{
+	update_test(true);
+}
+
+TEST(lut, partial_update_matches_reference)
+{
+	static uint8_t previous[EPD_IMAGE_BYTES(EPD_2_7)];
+	static uint8_t next[EPD_IMAGE_BYTES(EPD_2_7)];
+	random_bytes(previous, sizeof(previous), 3);
+	memcpy(next, previous, sizeof(next));
+
+	// lines 40 to 99 change
+	random_bytes(&next[40 * BYTES_PER_LINE], 60 * BYTES_PER_LINE, 4);
+
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	epd.setFullRefreshInterval(0);
+	epd.restore(previous);
+
+	bus.reset();
+	epd.updateRegion(next);
+	check_update(bus, previous, next, 40, 99);
+}
+
+// every byte sent to the COG, in order
+static std::vector<uint8_t> sent_bytes(EPD_MockBus &bus)
+{
+	std::vector<uint8_t> sent;
+	for (uint32_t i = 0; i < bus.getEventCount(); ++i)
+	{
+		const mock_event &event = bus.getEvent(i);
+		if (MOCK_TRANSFER == event.type)
+		{
+			const uint8_t *bytes = bus.getBytes(event);
+			sent.insert(sent.end(), bytes, bytes + event.length);
+		}
+	}
+	return sent;
+}
+
+static void render_image(uint16_t line, uint8_t *data, void *context)
+{
+	memcpy(data, (const uint8_t *)context + line * BYTES_PER_LINE, BYTES_PER_LINE);
+}
+
+TEST(lut, stream_matches_update)
+{
+	static uint8_t previous[EPD_IMAGE_BYTES(EPD_2_7)];
+	static uint8_t next[EPD_IMAGE_BYTES(EPD_2_7)];
+	random_bytes(previous, sizeof(previous), 6);
+	random_bytes(next, sizeof(next), 7);
+
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	epd.restore(previous);
+	bus.reset();
+	epd.update(next);
+	std::vector<uint8_t> updated = sent_bytes(bus);
+
+	// next drawn line by line, over the retained image or a given one
+	EPD_MockBus stream_bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD stream(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, stream_bus);
+	stream.begin();
+	stream.restore(previous);
+	stream_bus.reset();
+	stream.updateStream(epd_render_source(render_image, next));
+	check_update(stream_bus, previous, next, 0, HEIGHT - 1);
+	CHECK(updated == sent_bytes(stream_bus));
+	CHECK(0 == memcmp(stream.getImage(), next, sizeof(next)));
+
+	stream.restore(next);
+	stream_bus.reset();
+	stream.updateStream(epd_image_source(next), epd_render_source(render_image, previous));
+	check_update(stream_bus, next, previous, 0, HEIGHT - 1);
+	CHECK(0 == memcmp(stream.getImage(), previous, sizeof(previous)));
+}
+
+TEST(lut, clear_matches_reference)
+{
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	bus.reset();
+	epd.clear();
+
+	// black then white, as fixed bytes
+	static const struct
+	{
+		uint8_t value;
+		stage pass;
+	} stages[] = {{0xff, EPD_compensate}, {0xff, EPD_white}, {0xaa, EPD_inverse}, {0xaa, EPD_normal}, {0x55, EPD_normal}};
+
+	std::vector<const uint8_t *> blocks = line_blocks(bus);
+	uint8_t reference[BLOCK_LENGTH];
+	uint8_t current = 0;
+	uint32_t mismatches = 0;
+	for (uint32_t i = 0; i < blocks.size(); ++i)
+	{
+		int16_t line = block_line(blocks[i]);
+		bool found = false;
+		for (uint8_t s = current; s < 5 && !found; ++s)
+		{
+			reference_line(line < 0 ? 0x7fff : line, 0, stages[s].value, stages[s].pass, reference);
+			found = 0 == memcmp(reference, blocks[i], BLOCK_LENGTH);
+			current = found ? s : current;
+		}
+		mismatches += !found;
+	}
+	CHECK(blocks.size() > 4 * HEIGHT);
+	CHECK_EQUAL(0, mismatches);
+	CHECK_EQUAL(4, current);
+}
+
+// stage time factor of the original driver, a step per temperature range
+static uint8_t table_factor_10x(int16_t temperature)
+{
+	if (temperature <= -10)
+	{
+		return 170;
+	}
+	else if (temperature <= -5)
+	{
+		return 120;
+	}
+	else if (temperature <= 5)
+	{
+		return 80;
+	}
+	else if (temperature <= 10)
+	{
+		return 40;
+	}
+	else if (temperature <= 15)
+	{
+		return 30;
+	}
+	else if (temperature <= 20)
+	{
+		return 20;
+	}
+	else if (temperature <= 40)
+	{
+		return 10;
+	}
+	return 7;
+}
+
+TEST(lut, factor_never_below_table)
+{
+	static uint8_t image[EPD_IMAGE_BYTES(EPD_2_7)];
+	random_bytes(image, sizeof(image), 5);
+
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	epd.setFullRefreshInterval(0);
+	epd.restore(image);
+
+	// a one line refresh at each temperature, falling with warmth
+	uint8_t previous = 0xff;
+	uint32_t below = 0;
+	uint32_t rising = 0;
+	for (int16_t temperature = -25; temperature <= 60; ++temperature)
+	{
+		epd.setFactor(temperature);
+		image[0] ^= 0xff;
+		epd.updateRegion(image);
+		uint8_t factor_10x = epd.getTelemetry().factor_10x;
+		below += factor_10x < table_factor_10x(temperature);
+		rising += factor_10x > previous;
+		previous = factor_10x;
+	}
+	CHECK_EQUAL(0, below);
+	CHECK_EQUAL(0, rising);
+
+	// the table itself at the warm edge of each range
+	epd.setFactor(5);
+	image[0] ^= 0xff;
+	epd.updateRegion(image);
+	CHECK_EQUAL(80, epd.getTelemetry().factor_10x);
+	epd.setFactor(20);
+	image[0] ^= 0xff;
+	epd.updateRegion(image);
+	CHECK_EQUAL(20, epd.getTelemetry().factor_10x);
+}
@@ -0,0 +1,82 @@
+//
+// Host test runner
+//
+
+#include <Arduino.h>
+
+#include "test.h"
+
+static test_case *first_test = 0;
+static test_case *last_test = 0;
+static uint32_t failures = 0;
+
+test_registration::test_registration(test_case &test)
+{
+	if (last_test)
+	{
+		last_test->next = &test;
+	}
+	else
+	{
+		first_test = &test;
+	}
+	last_test = &test;
+}
+
+void test_fail(const char *file, int line, const char *expression)
+{
+	++failures;
+	printf("  %s:%d: CHECK(%s) failed\n", file, line, expression);
+}
+
+void test_equal(const char *file, int line, const char *expression, long long expected, long long actual)
+{
+	if (expected == actual)
+	{
+		return;
+	}
+	++failures;
+	printf("  %s:%d: %s is %lld, expected %lld\n", file, line, expression, actual, expected);
+}
+
+static bool selected(const test_case &test, int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		return true;
+	}
+	for (int i = 1; i < argc; ++i)
+	{
+		if (0 == strcmp(argv[i], test.suite))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t run = 0;
+	uint32_t failed = 0;
+
+	for (test_case *test = first_test; test; test = test->next)
+	{
+		if (!selected(*test, argc, argv))
+		{
+			continue;
+		}
+
+		uint32_t before = failures;
+		test->run();
+		++run;
+		if (failures != before)
+		{
+			++failed;
+		}
+		printf("%s %s.%s\n", failures != before ? "FAIL" : "ok  ", test->suite, test->name);
+	}
+
+	printf("%u tests, %u failed\n", run, failed);
+	return 0 == run || 0 != failed;
+}
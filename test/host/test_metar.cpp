@@ -0,0 +1,274 @@
+//
+// METAR and TAF decoding, group by group and over the report corpus
+//
+
+#include <Arduino.h>
+#include <METAR.h>
+#include <WXTimeline.h>
+
+#include "test.h"
+#include "wx_corpus.h"
+
+static bool decode(const char *text, metar &report)
+{
+	return metar_decode(text, strlen(text), report);
+}
+
+static bool decode(const char *text, taf &report)
+{
+	return taf_decode(text, strlen(text), report);
+}
+
+TEST(metar, european_report)
+{
+	static const char text[] = "METAR LFPG 171130Z AUTO 24012G25KT 200V280 6000 1500N R27L/0800V1200U -SHRA BR "
+							   "FEW012 SCT030CB BKN///TCU M02/M05 Q1013 TEMPO FM1200 TL1300 2000 SHRA=";
+	static metar report;
+	CHECK(decode(text, report));
+	CHECK(!report.speci && report.auto_report && !report.nil);
+	CHECK(wx_equals(report.station, "LFPG"));
+	CHECK(report.station.text == text + 6);
+	CHECK_EQUAL(17, report.time.day);
+	CHECK_EQUAL(11, report.time.hour);
+	CHECK_EQUAL(30, report.time.minute);
+
+	const wx_conditions &conditions = report.conditions;
+	CHECK(conditions.has_wind);
+	CHECK_EQUAL(240, conditions.wind.direction);
+	CHECK_EQUAL(12, conditions.wind.speed);
+	CHECK_EQUAL(25, conditions.wind.gust);
+	CHECK_EQUAL(200, conditions.wind.from);
+	CHECK_EQUAL(280, conditions.wind.to);
+
+	// the minimum visibility does not replace the prevailing one
+	CHECK_EQUAL(6000, conditions.visibility);
+
+	CHECK_EQUAL(1, report.rvr_count);
+	CHECK(wx_equals(report.rvr[0].runway, "27L"));
+	CHECK_EQUAL(800, report.rvr[0].min);
+	CHECK_EQUAL(1200, report.rvr[0].max);
+	CHECK_EQUAL('U', report.rvr[0].trend);
+
+	CHECK_EQUAL(2, conditions.weather_count);
+	CHECK(wx_equals(conditions.weather[0], "-SHRA"));
+	CHECK(wx_equals(conditions.weather[1], "BR"));
+
+	CHECK_EQUAL(3, conditions.cloud_count);
+	CHECK_EQUAL(WX_FEW, conditions.clouds[0].cover);
+	CHECK_EQUAL(1200, conditions.clouds[0].base);
+	CHECK_EQUAL(WX_CLOUD, conditions.clouds[0].type);
+	CHECK_EQUAL(WX_CB, conditions.clouds[1].type);
+	CHECK_EQUAL(WX_BKN, conditions.clouds[2].cover);
+	CHECK_EQUAL(WX_UNKNOWN, conditions.clouds[2].base);
+	CHECK_EQUAL(WX_TCU, conditions.clouds[2].type);
+
+	CHECK_EQUAL(-2, report.temperature);
+	CHECK_EQUAL(-5, report.dew_point);
+	CHECK_EQUAL(1013, report.qnh);
+
+	CHECK_EQUAL(1, report.trend_count);
+	const wx_group &trend = report.trends[0];
+	CHECK_EQUAL(WX_TEMPO, trend.change);
+	CHECK_EQUAL(12, trend.from.hour);
+	CHECK_EQUAL(13, trend.to.hour);
+	CHECK_EQUAL(2000, trend.conditions.visibility);
+	CHECK_EQUAL(1, trend.conditions.weather_count);
+	CHECK(wx_equals(trend.text, "TEMPO FM1200 TL1300 2000 SHRA"));
+}
+
+TEST(metar, us_report)
+{
+	static const char text[] = "KJFK 171151Z 31008KT 1 1/2SM R04R/2000V4000FT/D -RA BR OVC007 12/11 A2992 RMK AO2 SLP132\n";
+	static metar report;
+	CHECK(decode(text, report));
+	CHECK(wx_equals(report.station, "KJFK"));
+
+	// miles and feet in meters, inches of mercury in hPa
+	CHECK_EQUAL(1609 + 804, report.conditions.visibility);
+	CHECK_EQUAL(1, report.rvr_count);
+	CHECK(wx_equals(report.rvr[0].runway, "04R"));
+	CHECK_EQUAL(609, report.rvr[0].min);
+	CHECK_EQUAL(1219, report.rvr[0].max);
+	CHECK_EQUAL('D', report.rvr[0].trend);
+	CHECK_EQUAL(WX_OVC, report.conditions.clouds[0].cover);
+	CHECK_EQUAL(700, report.conditions.clouds[0].base);
+	CHECK_EQUAL(12, report.temperature);
+	CHECK_EQUAL(11, report.dew_point);
+	CHECK_EQUAL(1013, report.qnh);
+	CHECK(wx_equals(report.remarks, "RMK AO2 SLP132"));
+	CHECK_EQUAL(WX_IFR, wx_category_of(report.conditions));
+}
+
+TEST(metar, visibility_forms)
+{
+	static metar report;
+	CHECK(decode("KDEN 171153Z 00000KT P6SM SKC 08/M04 A3021", report));
+	CHECK_EQUAL(9999, report.conditions.visibility);
+	CHECK_EQUAL(WX_SKC, report.conditions.clouds[0].cover);
+
+	CHECK(decode("KSFO 171156Z 28012KT M1/4SM FG VV001 13/13 A2999", report));
+	CHECK_EQUAL(402, report.conditions.visibility);
+	CHECK_EQUAL(WX_VV, report.conditions.clouds[0].cover);
+	CHECK_EQUAL(100, report.conditions.clouds[0].base);
+	CHECK_EQUAL(WX_LIFR, wx_category_of(report.conditions));
+
+	CHECK(decode("UUEE 171130Z 18005MPS CAVOK M03/M09 Q1020 NOSIG", report));
+	CHECK(report.conditions.cavok);
+	CHECK_EQUAL(9999, report.conditions.visibility);
+	CHECK_EQUAL(9, report.conditions.wind.speed);
+	CHECK_EQUAL(1, report.trend_count);
+	CHECK_EQUAL(WX_NOSIG, report.trends[0].change);
+	CHECK_EQUAL(WX_VFR, wx_category_of(report.conditions));
+}
+
+TEST(metar, missing_groups)
+{
+	static metar report;
+	CHECK(decode("LFBO 171130Z AUTO 29010KT 9999 // NCD 19/// Q1018", report));
+	CHECK_EQUAL(0, report.conditions.weather_count);
+	CHECK_EQUAL(WX_NCD, report.conditions.clouds[0].cover);
+	CHECK_EQUAL(19, report.temperature);
+	CHECK_EQUAL(WX_NO_TEMP, report.dew_point);
+
+	CHECK(decode("METAR LFLY 171130Z NIL=", report));
+	CHECK(report.nil);
+	CHECK(!report.conditions.has_wind);
+	CHECK_EQUAL(WX_NO_TEMP, report.temperature);
+	CHECK_EQUAL(0, report.qnh);
+}
+
+TEST(metar, invalid_reports)
+{
+	static metar report;
+	CHECK(!decode("", report));
+	CHECK(!decode("METAR", report));
+	CHECK(!decode("LFLY", report));
+	CHECK(!decode("LFLY 1711Z 33007KT", report));
+	CHECK(!decode("<html>", report));
+}
+
+TEST(metar, extra_groups_are_dropped)
+{
+	static metar report;
+	CHECK(decode("LFLY 171130Z 9999 -RA BR HZ FU SA FEW010 SCT020 BKN030 BKN040 OVC050 "
+				 "R01/0100 R02/0200 R03/0300 R04/0400 R05/0500 TEMPO 3000 BECMG 4000 TEMPO 5000 12/10 Q1000",
+				 report));
+	CHECK_EQUAL(WX_MAX_WEATHER, report.conditions.weather_count);
+	CHECK_EQUAL(WX_MAX_CLOUDS, report.conditions.cloud_count);
+	CHECK_EQUAL(WX_MAX_RVR, report.rvr_count);
+	CHECK_EQUAL(WX_MAX_TRENDS, report.trend_count);
+	CHECK_EQUAL(4000, report.trends[1].conditions.visibility);
+}
+
+TEST(taf, change_groups)
+{
+	static const char text[] = "TAF AMD LFPG 171100Z 1712/1818 24010KT 9999 SCT030 TX18/1714Z TNM02/1806Z "
+							   "PROB30 TEMPO 1720/1724 1500 BR BKN004 BECMG 1800/1802 VRB05KT "
+							   "FM181200 31015G30KT 3SM SHRA OVC010CB RMK NXT FCST BY 12Z";
+	static taf report;
+	CHECK(decode(text, report));
+	CHECK(report.amended && !report.nil);
+	CHECK(wx_equals(report.station, "LFPG"));
+	CHECK_EQUAL(11, report.time.hour);
+	CHECK_EQUAL(17, report.from.day);
+	CHECK_EQUAL(12, report.from.hour);
+	CHECK_EQUAL(18, report.to.day);
+	CHECK_EQUAL(18, report.to.hour);
+	CHECK_EQUAL(18, report.max_temperature);
+	CHECK_EQUAL(14, report.max_time.hour);
+	CHECK_EQUAL(-2, report.min_temperature);
+	CHECK_EQUAL(18, report.min_time.day);
+	CHECK_EQUAL(6, report.min_time.hour);
+	CHECK_EQUAL(4, report.group_count);
+
+	const wx_group &base = report.groups[0];
+	CHECK_EQUAL(WX_BASE, base.change);
+	CHECK_EQUAL(240, base.conditions.wind.direction);
+	CHECK_EQUAL(9999, base.conditions.visibility);
+	CHECK_EQUAL(WX_SCT, base.conditions.clouds[0].cover);
+
+	const wx_group &prob = report.groups[1];
+	CHECK_EQUAL(WX_PROB, prob.change);
+	CHECK_EQUAL(30, prob.probability);
+	CHECK(prob.temporary);
+	CHECK_EQUAL(20, prob.from.hour);
+	CHECK_EQUAL(24, prob.to.hour);
+	CHECK_EQUAL(1500, prob.conditions.visibility);
+	CHECK_EQUAL(400, prob.conditions.clouds[0].base);
+	CHECK(wx_equals(prob.text, "PROB30 TEMPO 1720/1724 1500 BR BKN004"));
+
+	const wx_group &becoming = report.groups[2];
+	CHECK_EQUAL(WX_BECMG, becoming.change);
+	CHECK_EQUAL(18, becoming.from.day);
+	CHECK_EQUAL(2, becoming.to.hour);
+	CHECK_EQUAL(WX_VRB, becoming.conditions.wind.direction);
+	CHECK_EQUAL(WX_UNKNOWN, becoming.conditions.visibility);
+
+	// runs to the end of validity, remarks are not a group
+	const wx_group &from = report.groups[3];
+	CHECK_EQUAL(WX_FM, from.change);
+	CHECK_EQUAL(18, from.from.day);
+	CHECK_EQUAL(12, from.from.hour);
+	CHECK_EQUAL(18, from.to.hour);
+	CHECK_EQUAL(30, from.conditions.wind.gust);
+	CHECK_EQUAL(3 * 1609, from.conditions.visibility);
+	CHECK_EQUAL(WX_CB, from.conditions.clouds[0].type);
+	CHECK(wx_equals(from.text, "FM181200 31015G30KT 3SM SHRA OVC010CB"));
+}
+
+TEST(taf, nil_and_invalid)
+{
+	static taf report;
+	CHECK(decode("TAF LFBO 171100Z NIL=", report));
+	CHECK(report.nil);
+	CHECK_EQUAL(0, report.group_count);
+
+	CHECK(!decode("TAF", report));
+	CHECK(!decode("TAF LFBO 171100Z", report));
+	CHECK(!decode("TAF LFBO 171100Z 24010KT", report));
+}
+
+TEST(taf, extra_groups_are_dropped)
+{
+	static char text[512];
+	strcpy(text, "TAF KJFK 171120Z 1712/1818 31008KT P6SM SKC");
+	for (uint8_t h = 13; h < 13 + WX_MAX_GROUPS + 3; ++h)
+	{
+		sprintf(text + strlen(text), " FM17%02u00 3%02u10KT P6SM SKC", h, h);
+	}
+	static taf report;
+	CHECK(decode(text, report));
+	CHECK_EQUAL(WX_MAX_GROUPS, report.group_count);
+	CHECK_EQUAL(13 + WX_MAX_GROUPS - 2, report.groups[WX_MAX_GROUPS - 1].from.hour);
+}
+
+TEST(metar, corpus)
+{
+	static metar report;
+	for (uint8_t i = 0; i < WX_METAR_COUNT; ++i)
+	{
+		bool decoded = decode(wx_metars[i], report);
+		CHECK(decoded);
+		CHECK(report.conditions.has_wind);
+		CHECK(WX_NO_TEMP != report.temperature);
+		if (!decoded)
+		{
+			printf("  %s\n", wx_metars[i]);
+		}
+	}
+}
+
+TEST(taf, corpus)
+{
+	static taf report;
+	for (uint8_t i = 0; i < WX_TAF_COUNT; ++i)
+	{
+		bool decoded = decode(wx_tafs[i], report);
+		CHECK(decoded);
+		CHECK(report.nil || report.group_count > 0);
+		if (!decoded)
+		{
+			printf("  %s\n", wx_tafs[i]);
+		}
+	}
+}
@@ -0,0 +1,174 @@
+//
+// Refreshes chosen by EPD_Policy, on the COG emulator and the recording bus
+//
+
+#include <Arduino.h>
+#include <EPD.h>
+#include <EPD_emulator.h>
+#include <EPD_policy.h>
+
+#include "EPD_mock_bus.h"
+#include "test.h"
+
+#define PANEL_ON_PIN 1
+#define BORDER_PIN 2
+#define DISCHARGE_PIN 3
+#define RESET_PIN 4
+#define BUSY_PIN 5
+#define CS_PIN 6
+
+#define WIDTH EPD_WIDTH(EPD_2_7)
+#define HEIGHT EPD_HEIGHT(EPD_2_7)
+#define BYTES_PER_LINE (WIDTH / 8)
+
+// no full update or clear cycle for age, 8 partial updates at 25 C
+static const epd_budget budget = {80, 8, 0, 0};
+
+static void random_bytes(uint8_t *bytes, uint32_t length, uint32_t seed)
+{
+	for (uint32_t i = 0; i < length; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		bytes[i] = seed >> 16;
+	}
+}
+
+// panel power ons on the recording bus
+static uint32_t power_cycles(EPD_MockBus &bus)
+{
+	uint32_t cycles = 0;
+	for (uint32_t i = 0; i < bus.getEventCount(); ++i)
+	{
+		const mock_event &event = bus.getEvent(i);
+		cycles += MOCK_PIN == event.type && PANEL_ON_PIN == event.pin && HIGH == event.value;
+	}
+	return cycles;
+}
+
+// a black frame of the clear cycle
+static bool has_clear_frame(EPD_MockBus &bus)
+{
+	for (uint32_t i = 0; i < bus.getEventCount(); ++i)
+	{
+		const mock_event &event = bus.getEvent(i);
+		const uint8_t *bytes = bus.getBytes(event);
+		if (MOCK_TRANSFER == event.type && event.length > BYTES_PER_LINE && 0x72 == bytes[0] &&
+			0xff == bytes[1] && 0xff == bytes[BYTES_PER_LINE])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+TEST(policy, unknown_panel_is_cleared_in_one_power_cycle)
+{
+	static uint8_t image[EPD_IMAGE_BYTES(EPD_2_7)];
+	random_bytes(image, sizeof(image), 1);
+
+	epd_ghosting state;
+	EPD_Policy policy(state, HEIGHT, budget);
+	policy.reset();
+
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	epd.setPolicy(&policy);
+
+	bus.reset();
+	epd.updateRegion(image);
+	CHECK(state.known);
+	CHECK(has_clear_frame(bus));
+	CHECK_EQUAL(1, power_cycles(bus));
+	CHECK(0 == memcmp(epd.getImage(), image, sizeof(image)));
+
+	// and within a session, the COG stays on for the next refresh
+	policy.reset();
+	bus.reset();
+	epd.beginRefresh();
+	image[0] ^= 0xff;
+	epd.updateRegion(image);
+	CHECK(has_clear_frame(bus));
+	image[10 * BYTES_PER_LINE] ^= 0xff;
+	epd.updateRegion(image);
+	epd.endRefresh();
+	CHECK_EQUAL(1, power_cycles(bus));
+}
+
+TEST(policy, cheapest_refresh_within_budget)
+{
+	static uint8_t image[EPD_IMAGE_BYTES(EPD_2_7)];
+	random_bytes(image, sizeof(image), 2);
+
+	epd_ghosting state;
+	EPD_Policy policy(state, HEIGHT, budget);
+	policy.reset();
+
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	bus.setRecording(false);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	epd.setFullRefreshInterval(0);
+	epd.setPolicy(&policy);
+	epd.updateRegion(image);
+	CHECK(state.known);
+
+	// nothing changed, nothing sent
+	bus.reset();
+	epd.updateRegion(image);
+	CHECK_EQUAL(0, bus.getCounters().bytes);
+
+	// the same lines change until their band is over budget
+	uint8_t partials = 0;
+	for (uint8_t i = 0; i < 20 && 0 == state.full_count; ++i)
+	{
+		image[10 * BYTES_PER_LINE] ^= 0xff;
+		epd.updateRegion(image);
+		const epd_telemetry &telemetry = epd.getTelemetry();
+		if (0 == state.full_count)
+		{
+			++partials;
+			CHECK(telemetry.lines < (uint32_t)HEIGHT * 4);
+		}
+		else
+		{
+			CHECK(telemetry.lines >= (uint32_t)HEIGHT * 4);
+		}
+	}
+	CHECK_EQUAL(1, state.full_count);
+	CHECK(partials >= 1 && partials <= budget.full_debt / 10);
+	for (uint8_t b = 0; b < EPD_POLICY_BANDS; ++b)
+	{
+		CHECK_EQUAL(0, state.debt[b]);
+	}
+
+	// every few full updates, a clear cycle
+	state.full_count = budget.full_count;
+	image[10 * BYTES_PER_LINE] ^= 0xff;
+	epd.updateRegion(image);
+	CHECK_EQUAL(0, state.full_count);
+}
+
+TEST(policy, panel_shows_each_image)
+{
+	static uint8_t image[EPD_IMAGE_BYTES(EPD_2_7)];
+	random_bytes(image, sizeof(image), 3);
+
+	epd_ghosting state;
+	EPD_Policy policy(state, HEIGHT, budget);
+	policy.reset();
+
+	EPD_Emulator cog(WIDTH, HEIGHT, CS_PIN, BUSY_PIN, PANEL_ON_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, cog);
+	epd.begin();
+	epd.setPolicy(&policy);
+
+	// clear cycle then the image
+	epd.updateRegion(image);
+	CHECK(0 == memcmp(cog.getImage(), image, sizeof(image)));
+
+	// partial update of a few lines
+	random_bytes(&image[50 * BYTES_PER_LINE], 20 * BYTES_PER_LINE, 4);
+	epd.updateRegion(image);
+	CHECK(0 == memcmp(cog.getImage(), image, sizeof(image)));
+}
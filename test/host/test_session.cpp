@@ -0,0 +1,142 @@
+//
+// Refresh sessions: one COG power cycle for several refreshes
+//
+
+#include <Arduino.h>
+#include <EPD.h>
+#include <EPD_emulator.h>
+
+#include "EPD_mock_bus.h"
+#include "test.h"
+
+#define PANEL_ON_PIN 1
+#define BORDER_PIN 2
+#define DISCHARGE_PIN 3
+#define RESET_PIN 4
+#define BUSY_PIN 5
+#define CS_PIN 6
+
+#define WIDTH EPD_WIDTH(EPD_2_7)
+#define HEIGHT EPD_HEIGHT(EPD_2_7)
+
+static uint8_t first_image[EPD_IMAGE_BYTES(EPD_2_7)];
+static uint8_t second_image[EPD_IMAGE_BYTES(EPD_2_7)];
+
+static void make_images()
+{
+	for (uint32_t i = 0; i < sizeof(first_image); ++i)
+	{
+		first_image[i] = i * 7;
+		second_image[i] = i * 13;
+	}
+}
+
+// COG power ons and offs (discharge pulses) on the recording bus
+static uint32_t pin_writes(EPD_MockBus &bus, uint8_t pin, uint8_t level)
+{
+	uint32_t writes = 0;
+	for (uint32_t i = 0; i < bus.getEventCount(); ++i)
+	{
+		const mock_event &event = bus.getEvent(i);
+		writes += MOCK_PIN == event.type && pin == event.pin && level == event.value;
+	}
+	return writes;
+}
+
+static uint32_t power_ons(EPD_MockBus &bus)
+{
+	return pin_writes(bus, PANEL_ON_PIN, HIGH);
+}
+
+static uint32_t power_offs(EPD_MockBus &bus)
+{
+	return pin_writes(bus, DISCHARGE_PIN, HIGH);
+}
+
+TEST(session, refreshes_share_one_power_cycle)
+{
+	make_images();
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+
+	// each refresh powers the COG on and off
+	bus.reset();
+	epd.clear();
+	epd.update(first_image);
+	CHECK_EQUAL(2, power_ons(bus));
+
+	// one within a session
+	bus.reset();
+	epd.beginRefresh();
+	epd.clear();
+	epd.update(first_image);
+	epd.update(second_image);
+	CHECK_EQUAL(1, power_ons(bus));
+	CHECK_EQUAL(0, power_offs(bus));
+	epd.endRefresh();
+	CHECK_EQUAL(1, power_offs(bus));
+
+	// the next refresh powers on again
+	bus.reset();
+	epd.update(first_image);
+	CHECK_EQUAL(1, power_ons(bus));
+	CHECK_EQUAL(1, power_offs(bus));
+}
+
+TEST(session, expired_session_powers_off)
+{
+	make_images();
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+
+	// an update takes about 3 s, longer than the session
+	bus.reset();
+	epd.beginRefresh(1000);
+	epd.update(first_image);
+	CHECK_EQUAL(1, power_offs(bus));
+	epd.update(second_image);
+	CHECK_EQUAL(2, power_ons(bus));
+	epd.endRefresh();
+	CHECK_EQUAL(2, power_offs(bus));
+}
+
+TEST(session, queued_frames_share_one_power_cycle)
+{
+	make_images();
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	CHECK(epd.beginAsync());
+
+	bus.reset();
+	epd.beginRefresh();
+	CHECK(epd.updateAsync(first_image));
+	CHECK(epd.updateAsync(second_image));
+
+	// the refresh task powers off after the last queued frame
+	epd.endRefresh();
+	while (epd.isBusy())
+	{
+		delay(1);
+	}
+	CHECK_EQUAL(1, power_ons(bus));
+	CHECK_EQUAL(1, power_offs(bus));
+	CHECK(0 == memcmp(epd.getImage(), second_image, sizeof(second_image)));
+}
+
+TEST(session, clear_then_draw_on_the_panel)
+{
+	make_images();
+	EPD_Emulator cog(WIDTH, HEIGHT, CS_PIN, BUSY_PIN, PANEL_ON_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, cog);
+	epd.begin();
+	epd.update(first_image);
+
+	epd.beginRefresh();
+	epd.clear();
+	epd.update(second_image);
+	epd.endRefresh();
+	CHECK(0 == memcmp(cog.getImage(), second_image, sizeof(second_image)));
+}
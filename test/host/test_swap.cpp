@@ -0,0 +1,113 @@
+//
+// Frames handed to EPD by pointer swap, with their damaged lines
+//
+
+#include <Arduino.h>
+#include <EPD.h>
+
+#include "EPD_mock_bus.h"
+#include "test.h"
+
+#define PANEL_ON_PIN 1
+#define BORDER_PIN 2
+#define DISCHARGE_PIN 3
+#define RESET_PIN 4
+#define BUSY_PIN 5
+#define CS_PIN 6
+
+#define HEIGHT EPD_HEIGHT(EPD_2_7)
+#define BYTES_PER_LINE (EPD_WIDTH(EPD_2_7) / 8)
+#define BYTES_PER_SCAN (HEIGHT / 4)
+
+#define IMAGE_BYTES EPD_IMAGE_BYTES(EPD_2_7)
+
+// a line block selecting the line was sent, other than the dummy frame
+static bool driven(EPD_MockBus &bus, uint16_t line)
+{
+	uint16_t scan = 1 + BYTES_PER_LINE + line / 4;
+	uint8_t bits = 0xc0 >> (2 * (line & 0x03));
+	for (uint32_t i = 0; i < bus.getEventCount(); ++i)
+	{
+		const mock_event &event = bus.getEvent(i);
+		const uint8_t *bytes = bus.getBytes(event);
+		if (MOCK_TRANSFER == event.type && event.length > scan && 0x72 == bytes[0] && 0x55 != bytes[1] &&
+			bits == bytes[scan])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// the swapped buffers belong to EPD, from malloc() like its own
+TEST(swap, damaged_lines_only)
+{
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	epd.setFullRefreshInterval(0);
+	uint8_t *frame = (uint8_t *)malloc(IMAGE_BYTES);
+	memset(frame, 0, IMAGE_BYTES);
+	epd.restore(frame);
+
+	// lines 40 to 59 drawn
+	memset(&frame[40 * BYTES_PER_LINE], 0x5a, 20 * BYTES_PER_LINE);
+	bus.reset();
+	uint8_t *next = epd.updateSwap(frame, 40, 59);
+	CHECK(next != frame);
+	CHECK(epd.getImage() == frame);
+	CHECK_EQUAL(EPD_partial, epd.getLastRefresh());
+	CHECK(driven(bus, 40) && driven(bus, 59));
+	CHECK(!driven(bus, 39) && !driven(bus, 60));
+
+	// the same frame again, nothing to drive
+	memcpy(next, frame, IMAGE_BYTES);
+	bus.reset();
+	next = epd.updateSwap(next, 40, 59);
+	CHECK_EQUAL(EPD_skip, epd.getLastRefresh());
+	CHECK_EQUAL(0, bus.getCounters().bytes);
+
+	// a change outside the range is not looked for
+	memcpy(next, epd.getImage(), IMAGE_BYTES);
+	next[100 * BYTES_PER_LINE] ^= 0xff;
+	next = epd.updateSwap(next, 0, 99);
+	CHECK_EQUAL(EPD_skip, epd.getLastRefresh());
+	free(next);
+}
+
+TEST(swap, queued_frames_merge_their_lines)
+{
+	EPD_MockBus bus(CS_PIN, BUSY_PIN, RESET_PIN);
+	EPD epd(EPD_2_7, PANEL_ON_PIN, BORDER_PIN, DISCHARGE_PIN, RESET_PIN, BUSY_PIN, CS_PIN, bus);
+	epd.begin();
+	epd.setFullRefreshInterval(0);
+	uint8_t *frame = (uint8_t *)malloc(IMAGE_BYTES);
+	memset(frame, 0, IMAGE_BYTES);
+	epd.restore(frame);
+	CHECK(epd.beginAsync());
+
+	// frames queued faster than they are displayed
+	bus.reset();
+	for (uint16_t line = 10; line < HEIGHT; line += 40)
+	{
+		memset(&frame[line * BYTES_PER_LINE], 0xa5, BYTES_PER_LINE);
+		uint8_t *next = epd.swapAsync(frame, line, line);
+		CHECK(next != 0);
+		memcpy(next, frame, IMAGE_BYTES);
+		frame = next;
+	}
+	while (epd.isBusy())
+	{
+		delay(1);
+	}
+
+	// every line drawn was driven, whichever frames were dropped
+	for (uint16_t line = 10; line < HEIGHT; line += 40)
+	{
+		CHECK(driven(bus, line));
+		CHECK_EQUAL(0xa5, epd.getImage()[line * BYTES_PER_LINE]);
+	}
+	CHECK(!driven(bus, 9));
+	CHECK(!driven(bus, 171));
+	free(frame);
+}
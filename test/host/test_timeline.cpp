@@ -0,0 +1,177 @@
+//
+// TAF change groups replayed into the hour by hour timeline
+//
+
+#include <Arduino.h>
+#include <METAR.h>
+#include <WXCache.h>
+#include <WXTimeline.h>
+
+#include <string>
+
+#include "test.h"
+
+#define HOUR 3600UL
+
+// 2026-10-17 11:30Z, and 12Z the start of validity
+#define NOW 1792236600UL
+#define START 1792238400UL
+
+static const char forecast[] =
+	"TAF LFLY 171100Z 1712/1818 24010KT 9999 SCT030 "
+	"BECMG 1714/1716 5000 BKN008 "
+	"TEMPO 1720/1724 1200 BR "
+	"FM180600 VRB03KT CAVOK";
+
+static void build(wx_timeline &timeline, const char *text)
+{
+	static taf report;
+	CHECK(taf_decode(text, strlen(text), report));
+	wx_timeline_build(timeline, report, NOW);
+}
+
+TEST(timeline, one_entry_per_hour_of_validity)
+{
+	wx_timeline timeline;
+	build(timeline, forecast);
+	CHECK_EQUAL(START, timeline.start);
+	CHECK_EQUAL(30, timeline.hours);
+
+	CHECK(0 == wx_timeline_at(timeline, START - 1));
+	CHECK(0 != wx_timeline_at(timeline, START));
+	CHECK(0 != wx_timeline_at(timeline, START + 30 * HOUR - 1));
+	CHECK(0 == wx_timeline_at(timeline, START + 30 * HOUR));
+}
+
+TEST(timeline, base_forecast)
+{
+	wx_timeline timeline;
+	build(timeline, forecast);
+	const wx_hour *hour = wx_timeline_at(timeline, START + HOUR / 2);
+	CHECK(0 != hour);
+	CHECK_EQUAL(WX_VFR, hour->category);
+	CHECK_EQUAL(WX_VFR, hour->worst);
+	CHECK_EQUAL(WX_SCT, hour->cover);
+	CHECK_EQUAL(240, hour->wind_direction);
+	CHECK_EQUAL(10, hour->wind_speed);
+	CHECK_EQUAL(WX_UNKNOWN, hour->ceiling);
+	CHECK_EQUAL(9999, hour->visibility);
+}
+
+TEST(timeline, becoming_is_worst_during_then_prevails)
+{
+	wx_timeline timeline;
+	build(timeline, forecast);
+
+	// 14Z to 16Z, either conditions
+	const wx_hour *hour = wx_timeline_at(timeline, START + 2 * HOUR);
+	CHECK_EQUAL(WX_VFR, hour->category);
+	CHECK_EQUAL(WX_IFR, hour->worst);
+
+	// from 16Z, the wind of the base forecast and the new ceiling
+	hour = wx_timeline_at(timeline, START + 4 * HOUR);
+	CHECK_EQUAL(WX_IFR, hour->category);
+	CHECK_EQUAL(WX_BKN, hour->cover);
+	CHECK_EQUAL(800, hour->ceiling);
+	CHECK_EQUAL(5000, hour->visibility);
+	CHECK_EQUAL(240, hour->wind_direction);
+}
+
+TEST(timeline, temporary_changes_only_the_worst)
+{
+	wx_timeline timeline;
+	build(timeline, forecast);
+
+	// 20Z to 24Z
+	for (uint8_t h = 8; h < 12; ++h)
+	{
+		const wx_hour *hour = wx_timeline_at(timeline, START + h * HOUR);
+		CHECK_EQUAL(WX_IFR, hour->category);
+		CHECK_EQUAL(WX_LIFR, hour->worst);
+		CHECK_EQUAL(5000, hour->visibility);
+	}
+	CHECK_EQUAL(WX_IFR, wx_timeline_at(timeline, START + 12 * HOUR)->worst);
+}
+
+TEST(timeline, from_group_replaces_everything)
+{
+	wx_timeline timeline;
+	build(timeline, forecast);
+
+	// not before 06Z on the 18th
+	const wx_hour *hour = wx_timeline_at(timeline, START + 17 * HOUR);
+	CHECK_EQUAL(WX_IFR, hour->category);
+	CHECK_EQUAL(WX_IFR, hour->worst);
+
+	hour = wx_timeline_at(timeline, START + 18 * HOUR);
+	CHECK_EQUAL(WX_VFR, hour->category);
+	CHECK_EQUAL(WX_VFR, hour->worst);
+	CHECK_EQUAL(WX_NSC, hour->cover);
+	CHECK_EQUAL(WX_VRB, hour->wind_direction);
+	CHECK_EQUAL(3, hour->wind_speed);
+	CHECK_EQUAL(WX_UNKNOWN, hour->ceiling);
+	CHECK_EQUAL(9999, hour->visibility);
+}
+
+TEST(timeline, no_forecast)
+{
+	wx_timeline timeline;
+	build(timeline, "TAF LFLY 171100Z NIL");
+	CHECK_EQUAL(0, timeline.hours);
+	CHECK(0 == wx_timeline_at(timeline, START));
+}
+
+TEST(timeline, validity_across_the_month_end)
+{
+	// 2026-11-01 03Z, a TAF of the 31st to the 1st
+	wx_timeline timeline;
+	static taf report;
+	const char *text = "TAF LFLY 312300Z 3100/0106 24010KT 9999 SCT030";
+	CHECK(taf_decode(text, strlen(text), report));
+	wx_timeline_build(timeline, report, 1793502000UL);
+	CHECK_EQUAL(1793404800UL, timeline.start);
+	CHECK_EQUAL(30, timeline.hours);
+}
+
+TEST(timeline, stored_taf_is_resolved)
+{
+	wx_station station;
+	wx_station_init(station, "LFLY");
+	CHECK(wx_store_taf(station, forecast, strlen(forecast), NOW));
+	CHECK(station.changed);
+	CHECK_EQUAL(START, station.timeline.start);
+	CHECK_EQUAL(30, station.timeline.hours);
+
+	// the same report again is not a change
+	station.changed = false;
+	CHECK(!wx_store_taf(station, forecast, strlen(forecast), NOW + HOUR));
+	CHECK(!station.changed);
+	CHECK_EQUAL(30, station.timeline.hours);
+
+	// without a clock, kept but not placed in time
+	static const char amended[] = "TAF AMD LFLY 171130Z 1712/1818 24010KT 9999 SCT030";
+	CHECK(wx_store_taf(station, amended, strlen(amended), 1000));
+	CHECK_EQUAL(0, station.timeline.hours);
+}
+
+TEST(timeline, long_reports_are_cut)
+{
+	wx_station station;
+	wx_station_init(station, "LFLY");
+
+	// at the last group that fits
+	std::string text = "LFLY 171130Z";
+	while (text.size() < WX_METAR_SIZE + 20)
+	{
+		text += " 9999";
+	}
+	CHECK(wx_store_metar(station, text.c_str(), text.size(), NOW));
+	CHECK_EQUAL(WX_METAR_SIZE - 4, strlen(station.metar));
+	CHECK(0 == text.compare(0, strlen(station.metar), station.metar));
+
+	// without a space to cut at, as much as fits
+	text.assign(WX_METAR_SIZE + 20, 'X');
+	CHECK(wx_store_metar(station, text.c_str(), text.size(), NOW));
+	CHECK_EQUAL(WX_METAR_SIZE - 1, strlen(station.metar));
+	CHECK(0 == text.compare(0, WX_METAR_SIZE - 1, station.metar));
+}
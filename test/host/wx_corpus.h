@@ -0,0 +1,50 @@
+//
+// Reports as published by the data server, for the decoder tests and
+// benchmark: European and US formats, trends, RVR, missing groups
+//
+#ifndef WX_CORPUS_H_
+#define WX_CORPUS_H_
+
+static const char *const wx_metars[] = {
+	"LFLY 171130Z 33007KT 290V360 CAVOK 16/06 Q1021 NOSIG",
+	"LFLL 171130Z AUTO 34008KT 300V010 9999 FEW041 17/05 Q1021 NOSIG",
+	"LFLS 171130Z 01005KT 330V050 9999 SCT035 BKN120 12/04 Q1022",
+	"LFPG 171130Z 24012G25KT 200V280 6000 1500N R27L/0800V1200U -SHRA BR FEW012 SCT030CB BKN080 11/09 Q1008 TEMPO 3000 SHRA",
+	"EGLL 171120Z AUTO 22015KT 9999 -RA BKN008 OVC015 13/12 Q1004 TEMPO 4000 RA BKN006",
+	"EDDF 171120Z 25011KT 9999 FEW025 SCT040 14/07 Q1015 NOSIG",
+	"EHAM 171125Z 23018G28KT 7000 -DZ BKN006 OVC009 12/11 Q1006 BECMG 24020G32KT 9999 NSW SCT012",
+	"LSZH 171120Z VRB02KT 0300 R14/0450N R16/0500U R28/0375D FG VV002 06/06 Q1027 NOSIG",
+	"UUEE 171130Z 18005MPS CAVOK M03/M09 Q1020 R06L/190050 NOSIG",
+	"ENGM 171120Z 01008KT 9999 -SN FEW015 BKN030 M02/M05 Q0998 RESN TEMPO 1500 SN",
+	"KJFK 171151Z 31008KT 1 1/2SM R04R/2000V4000FT/D -RA BR OVC007 12/11 A2992 RMK AO2 SLP132 P0002 T01220111",
+	"KORD 171151Z 27016G24KT 10SM FEW050 SCT250 18/03 A3001 RMK AO2 PK WND 28030/1120 SLP168",
+	"KDEN 171153Z 00000KT P6SM SKC 08/M04 A3021 RMK AO2 SLP227 T00781044",
+	"KSFO 171156Z 28012KT M1/4SM FG VV001 13/13 A2999 RMK AO2",
+	"CYYZ 171100Z 26010KT 15SM BKN045 OVC090 10/04 A2998 RMK SC5AC3 SLP158",
+	"SPECI KATL 171114Z 21009KT 3SM +TSRA BR SCT015 BKN030CB OVC060 22/21 A2985 RMK AO2",
+	"RJTT 171130Z 02009KT 9999 FEW020 BKN/// 22/16 Q1014 NOSIG",
+	"YSSY 171130Z 16012KT CAVOK 18/08 Q1026",
+	"FAOR 171130Z 33011KT 9999 SCT040 24/M02 Q1024 NOSIG",
+	"LFBO 171130Z AUTO 29010KT 9999 // NCD 19/09 Q1018",
+};
+
+static const char *const wx_tafs[] = {
+	"TAF LFLY 171100Z 1712/1812 34008KT CAVOK TX17/1714Z TN05/1806Z BECMG 1718/1720 VRB03KT",
+	"TAF LFLL 171100Z 1712/1818 35010KT 9999 FEW040 PROB30 TEMPO 1800/1806 4000 BR BKN008",
+	"TAF AMD LFPG 171122Z 1712/1818 24012G25KT 6000 -SHRA SCT015 BKN030 TEMPO 1712/1716 3000 SHRA BKN012 "
+	"PROB40 TEMPO 1712/1716 TSRA SCT020CB BECMG 1718/1720 28010KT 9999 NSW FEW025",
+	"TAF EGLL 171058Z 1712/1818 22015KT 9999 BKN008 TEMPO 1712/1716 4000 RA BKN006 BECMG 1716/1719 BKN015 "
+	"PROB30 1800/1806 BKN004",
+	"TAF KJFK 171120Z 1712/1818 31008KT 3SM -RA BR OVC007 FM171500 32012KT 6SM BR OVC012 "
+	"FM172200 33010KT P6SM BKN025 FM181400 34008KT P6SM SCT040",
+	"TAF KORD 171120Z 1712/1818 27016G24KT P6SM FEW050 SCT250 FM180000 27008KT P6SM SKC",
+	"TAF LSZH 171100Z 1712/1818 VRB02KT 0300 FG VV002 BECMG 1712/1714 4000 BR BKN004 BECMG 1714/1716 9999 NSW SCT020",
+	"TAF UUEE 171100Z 1712/1812 18005MPS CAVOK TXM01/1712Z TNM08/1803Z TEMPO 1800/1806 0800 -SN FG OVC003",
+	"TAF LFBO 171100Z NIL",
+	"TAF RJTT 171105Z 1712/1818 02009KT 9999 FEW020 BKN040 BECMG 1800/1803 36012KT",
+};
+
+#define WX_METAR_COUNT (sizeof(wx_metars) / sizeof(wx_metars[0]))
+#define WX_TAF_COUNT (sizeof(wx_tafs) / sizeof(wx_tafs[0]))
+
+#endif
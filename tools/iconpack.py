@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+#
+# Pack the icon art of tools/icons.txt into lib/ICONS
+#
+# Each icon is stored the smaller of two ways:
+#   raw   rows of pixels, leftmost in the most significant bit, each row
+#         padded to a byte (the canvas layout)
+#   runs  lengths of alternating white and black runs, row after row,
+#         starting white, one per 4-bit nibble (high nibble first); a run
+#         of 15 is continued by the next nibble in the same color
+#
+# Run it by hand after editing the art, or from PlatformIO:
+#   extra_scripts = pre:tools/iconpack.py
+# The outputs are only written when they change, so they do not trigger a
+# rebuild.
+#
+import os
+import sys
+
+RAW = 0
+RUNS = 1
+
+
+def read_art(path):
+    icons = []
+    with open(path) as art:
+        for number, line in enumerate(art, 1):
+            line = line.strip()
+            if not line or line.startswith(";"):
+                continue
+            if line.startswith("icon "):
+                icons.append((line[5:].strip(), []))
+                continue
+            if not icons or set(line) - set("#."):
+                sys.exit("%s:%d: unexpected line" % (path, number))
+            rows = icons[-1][1]
+            if rows and len(line) != len(rows[0]):
+                sys.exit("%s:%d: rows of %s differ in length" % (path, number, icons[-1][0]))
+            rows.append([c == "#" for c in line])
+    for name, rows in icons:
+        if not rows or len(rows[0]) > 255 or len(rows) > 255:
+            sys.exit("%s: bad size for %s" % (path, name))
+    return icons
+
+
+def pack_raw(rows):
+    data = []
+    for row in rows:
+        for i in range(0, len(row), 8):
+            byte = 0
+            for j, black in enumerate(row[i:i + 8]):
+                if black:
+                    byte |= 0x80 >> j
+            data.append(byte)
+    return data
+
+
+def pack_runs(rows):
+    nibbles = []
+    color = False
+    length = 0
+    for black in [black for row in rows for black in row] + [None]:
+        if black == color:
+            length += 1
+            continue
+        while length >= 15:
+            nibbles.append(15)
+            length -= 15
+        nibbles.append(length)
+        color = black
+        length = 1
+    if len(nibbles) & 1:
+        nibbles.append(0)
+    return [nibbles[i] << 4 | nibbles[i + 1] for i in range(0, len(nibbles), 2)]
+
+
+def generate(root):
+    icons = read_art(os.path.join(root, "tools", "icons.txt"))
+
+    names = []
+    index = []
+    data = []
+    size = 0
+    for name, rows in icons:
+        raw = pack_raw(rows)
+        runs = pack_runs(rows)
+        format, packed = (RUNS, runs) if len(runs) < len(raw) else (RAW, raw)
+        names.append("ICON_" + name)
+        index.append("\t{%d, %d, %s, %d}, // %s, %d bytes raw" %
+                     (len(rows[0]), len(rows), ("ICON_RAW", "ICON_RUNS")[format], size, name, len(raw)))
+        data.append("\t// " + name)
+        for i in range(0, len(packed), 16):
+            data.append("\t" + " ".join("0x%02x," % b for b in packed[i:i + 16]))
+        data.append("")
+        size += len(packed)
+
+    header = "//\n// Generated by tools/iconpack.py from tools/icons.txt, do not edit\n//\n"
+    ids = (header +
+           "#ifndef ICON_LIST_H_\n#define ICON_LIST_H_\n\n"
+           "typedef enum\n{\n" + "".join("\t%s,\n" % n for n in names) +
+           "\tICON_COUNT\n} icon;\n\n"
+           "#define ICON_MAX_WIDTH %d\n\n#endif\n" % max(len(rows[0]) for _, rows in icons))
+    pack = (header +
+            "// included by Icons.cpp only\n\n"
+            "static const icon_entry icon_index[ICON_COUNT] = {\n" + "\n".join(index) + "\n};\n\n"
+            "// %d bytes\n" % size +
+            "static const uint8_t icon_data[] = {\n" + "\n".join(data).rstrip() + "\n};\n")
+
+    for name, text in (("icon_list.h", ids), ("icon_data.h", pack)):
+        path = os.path.join(root, "lib", "ICONS", name)
+        if os.path.exists(path):
+            with open(path) as current:
+                if current.read() == text:
+                    continue
+        with open(path, "w") as output:
+            output.write(text)
+        print("iconpack: wrote %s" % path)
+
+
+try:
+    Import("env")
+    generate(env.subst("$PROJECT_DIR"))
+except NameError:
+    generate(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))